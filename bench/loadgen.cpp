@@ -0,0 +1,990 @@
+// ********** LOADGEN **********
+// Generatore di carico HTTP su epoll, un solo thread.
+// Closed loop: ogni connessione tiene -P richieste in volo.
+// Open loop (-r): le richieste partono a ritmo costante e la latenza si
+// misura dall'istante previsto, quindi le code contano (niente coordinated
+// omission). In closed loop si riporta anche la latenza corretta come
+// HdrHistogram::copyCorrectedForCoordinatedOmission.
+// Replay (-R): le richieste di un file di capture partono con i tempi
+// originali (o -x volte più veloci); con -B la stessa sequenza viene
+// rigiocata su una seconda istanza e si confrontano i risultati.
+// Memoria (-I/-L): tiene aperte connessioni inattive o lente e riporta
+// l'RSS del server per connessione, letto da stub_status.
+// Uso: make loadgen && ./loadgen -h
+
+#include "Histogram.hpp"
+#include "Capture.hpp"
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <cerrno>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+// Tentativi per posizione di pipeline quando il server chiude la
+// connessione prima di rispondere a tutte le richieste
+#define LOADGEN_MAX_RETRIES 3
+
+// Connessioni fallite prima della prima risposta: il server non c'è
+#define LOADGEN_MAX_CONNECT_ERRORS 1000
+
+// Attesa massima per le risposte in volo dopo la fine del test
+#define LOADGEN_DRAIN_USEC 5000000L
+
+// Connessioni lente: byte di header inviati ogni secondo
+#define LOADGEN_SLOW_CHUNK 16
+
+// Attesa massima per stabilire le connessioni inattive
+#define LOADGEN_CONNECT_USEC 10000000L
+
+enum RequestType { REQ_GET_SMALL, REQ_GET_LARGE, REQ_HEAD, REQ_POST, REQ_DELETE, REQ_TYPES };
+
+static const char* g_typeNames[REQ_TYPES] = { "get_small", "get_large", "head", "post", "delete" };
+
+struct Options {
+    std::string host;
+    int port;
+    int connections;
+    double duration;        // secondi (0 = solo -n)
+    long requests;          // richieste totali (0 = solo -d)
+    double rate;            // richieste/s in open loop (0 = closed loop)
+    bool keepAlive;
+    int pipeline;
+    unsigned weights[REQ_TYPES];
+    std::string paths[REQ_TYPES];
+    size_t postSize;
+    unsigned long seed;
+    double intervalMs;      // intervallo atteso per la correzione (0 = latenza media)
+    std::string replay;     // file di capture (vuoto = richieste generate)
+    double speed;           // replay: fattore sui tempi originali (0 = closed loop)
+    int comparePort;        // replay: seconda istanza da confrontare (0 = nessuna)
+    long idle;              // memoria: connessioni che non inviano nulla
+    long slow;              // memoria: connessioni che inviano l'header piano
+    std::string statusPath; // memoria: location stub_status
+};
+
+struct Pending {
+    RequestType type;       // in replay conta solo REQ_HEAD (risposta senza body)
+    long record;            // indice in g_capture, -1 se generata
+    long intended;          // µs monotonici: quando la richiesta doveva partire
+    int retries;
+};
+
+struct Conn {
+    int fd;
+    bool connected;
+    long assigned;          // richieste affidate alla connessione
+    std::string out;
+    size_t outOffset;
+    std::string in;
+    std::deque<Pending> inflight;
+};
+
+struct Results {
+    Histogram latency;      // µs dall'istante previsto
+    unsigned long byType[REQ_TYPES];
+    std::map<int, unsigned long> statuses;
+    std::map<std::string, unsigned long> byMethod;     // replay
+    unsigned long completed;
+    unsigned long errors;
+    unsigned long retried;
+    unsigned long connects;
+    unsigned long bytesIn;
+};
+
+static Options g_opt;
+static Results g_res;
+static std::string g_requests[REQ_TYPES];
+static std::deque<Pending> g_backlog;
+static int g_epoll = -1;
+static struct sockaddr_in g_addr;
+static unsigned long g_rng;
+static std::vector<CaptureRecord> g_capture;
+
+static long nowUsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// xorshift64: stessa sequenza di tipi a parità di seed
+static unsigned long nextRandom() {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static RequestType pickType() {
+    unsigned total = 0;
+    for (int t = 0; t < REQ_TYPES; ++t)
+        total += g_opt.weights[t];
+    unsigned roll = static_cast<unsigned>(nextRandom() % total);
+    for (int t = 0; t < REQ_TYPES; ++t) {
+        if (roll < g_opt.weights[t])
+            return static_cast<RequestType>(t);
+        roll -= g_opt.weights[t];
+    }
+    return REQ_GET_SMALL;
+}
+
+// In replay il calendario viene dalla capture, altrimenti da -r
+static bool paced() {
+    return g_capture.empty() ? g_opt.rate > 0 : g_opt.speed > 0;
+}
+
+// Istante previsto della richiesta i-esima (µs monotonici)
+static long scheduled(long start, long i) {
+    if (!g_capture.empty())
+        return start + static_cast<long>((g_capture[i].usec - g_capture[0].usec) / g_opt.speed);
+    return start + static_cast<long>(i * (1e6 / g_opt.rate));
+}
+
+static std::string methodOf(const std::string& request) {
+    size_t space = request.find(' ');
+    return request.substr(0, space == std::string::npos ? 0 : space);
+}
+
+static Pending nextPending(long issued, long intended) {
+    Pending p;
+    p.record = g_capture.empty() ? -1 : issued;
+    if (p.record < 0)
+        p.type = pickType();
+    else
+        p.type = methodOf(g_capture[issued].data) == "HEAD" ? REQ_HEAD : REQ_GET_SMALL;
+    p.intended = intended;
+    p.retries = 0;
+    return p;
+}
+
+// ********** RICHIESTE **********
+
+// Richieste serializzate una volta: a runtime si copiano e basta
+static void buildRequests() {
+    std::string connection = g_opt.keepAlive ? "keep-alive" : "close";
+    std::string common = "Host: " + g_opt.host + "\r\nUser-Agent: webserv-loadgen\r\nConnection: "
+        + connection + "\r\n";
+    g_requests[REQ_GET_SMALL] = "GET " + g_opt.paths[REQ_GET_SMALL] + " HTTP/1.1\r\n" + common + "\r\n";
+    g_requests[REQ_GET_LARGE] = "GET " + g_opt.paths[REQ_GET_LARGE] + " HTTP/1.1\r\n" + common + "\r\n";
+    g_requests[REQ_HEAD] = "HEAD " + g_opt.paths[REQ_HEAD] + " HTTP/1.1\r\n" + common + "\r\n";
+    g_requests[REQ_DELETE] = "DELETE " + g_opt.paths[REQ_DELETE] + " HTTP/1.1\r\n" + common + "\r\n";
+
+    std::string body = "--loadgenboundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"loadgen.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n"
+        + std::string(g_opt.postSize, 'x') + "\r\n--loadgenboundary--\r\n";
+    std::ostringstream post;
+    post << "POST " << g_opt.paths[REQ_POST] << " HTTP/1.1\r\n" << common
+         << "Content-Type: multipart/form-data; boundary=loadgenboundary\r\n"
+         << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+    g_requests[REQ_POST] = post.str();
+}
+
+// ********** CONNESSIONI **********
+
+static void watch(Conn& conn, size_t slot, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    if (!conn.connected || conn.outOffset < conn.out.size())
+        ev.events |= EPOLLOUT;
+    ev.data.u32 = static_cast<uint32_t>(slot);
+    epoll_ctl(g_epoll, op, conn.fd, &ev);
+}
+
+static bool openConn(Conn& conn, size_t slot) {
+    conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    conn.connected = false;
+    conn.assigned = 0;
+    conn.out.clear();
+    conn.outOffset = 0;
+    conn.in.clear();
+    if (conn.fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(conn.fd, reinterpret_cast<struct sockaddr*>(&g_addr), sizeof(g_addr)) < 0
+        && errno != EINPROGRESS) {
+        close(conn.fd);
+        conn.fd = -1;
+        return false;
+    }
+    ++g_res.connects;
+    watch(conn, slot, EPOLL_CTL_ADD);
+    return true;
+}
+
+// Le richieste senza risposta tornano in testa al backlog con il loro
+// istante previsto: il tempo perso resta nella latenza
+static void closeConn(Conn& conn) {
+    for (size_t i = conn.inflight.size(); i-- > 0; ) {
+        Pending p = conn.inflight[i];
+        if (++p.retries > LOADGEN_MAX_RETRIES * g_opt.pipeline) {
+            ++g_res.errors;
+            continue;
+        }
+        ++g_res.retried;
+        g_backlog.push_front(p);
+    }
+    conn.inflight.clear();
+    if (conn.fd >= 0) {
+        epoll_ctl(g_epoll, EPOLL_CTL_DEL, conn.fd, NULL);
+        close(conn.fd);
+    }
+    conn.fd = -1;
+}
+
+static bool hasRoom(const Conn& conn) {
+    if (conn.fd < 0 || static_cast<int>(conn.inflight.size()) >= g_opt.pipeline)
+        return false;
+    // Senza keep-alive una connessione porta una sola richiesta
+    return g_opt.keepAlive || conn.assigned == 0;
+}
+
+static void assign(Conn& conn, const Pending& p) {
+    conn.out += p.record >= 0 ? g_capture[p.record].data : g_requests[p.type];
+    conn.inflight.push_back(p);
+    ++conn.assigned;
+}
+
+static void flushOut(Conn& conn, size_t slot) {
+    while (conn.outOffset < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + conn.outOffset,
+            conn.out.size() - conn.outOffset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            closeConn(conn);
+            return;
+        }
+        conn.outOffset += static_cast<size_t>(n);
+    }
+    if (conn.outOffset == conn.out.size()) {
+        conn.out.clear();
+        conn.outOffset = 0;
+    }
+    watch(conn, slot, EPOLL_CTL_MOD);
+}
+
+// ********** RISPOSTE **********
+
+// Valore dell'header name (minuscolo, con ':') nella sezione header
+static std::string headerValue(const std::string& head, const char* name) {
+    std::string lower(head);
+    for (size_t i = 0; i < lower.size(); ++i)
+        lower[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(lower[i])));
+    size_t pos = lower.find(name);
+    if (pos == std::string::npos)
+        return "";
+    pos += std::strlen(name);
+    size_t end = lower.find("\r\n", pos);
+    while (pos < end && (lower[pos] == ' ' || lower[pos] == '\t'))
+        ++pos;
+    return lower.substr(pos, end - pos);
+}
+
+// Consuma una risposta completa da conn.in; senza Content-Length il body
+// finisce con la connessione (eof)
+static bool takeResponse(Conn& conn, bool eof, int& status, bool& mustClose) {
+    size_t headEnd = conn.in.find("\r\n\r\n");
+    if (headEnd == std::string::npos)
+        return false;
+    std::string head = conn.in.substr(0, headEnd + 2);
+
+    size_t total = headEnd + 4;
+    std::string length = headerValue(head, "\r\ncontent-length:");
+    if (conn.inflight.front().type != REQ_HEAD) {
+        if (!length.empty())
+            total += std::strtoul(length.c_str(), NULL, 10);
+        else if (!eof)
+            return false;
+        else
+            total = conn.in.size();
+    }
+    // Connection: close vale solo a risposta completa, il body può
+    // arrivare in più letture
+    if (conn.in.size() < total)
+        return false;
+    status = (head.size() > 12) ? std::atoi(head.c_str() + 9) : 0;
+    mustClose = headerValue(head, "\r\nconnection:") == "close";
+    g_res.bytesIn += total;
+    conn.in.erase(0, total);
+    return true;
+}
+
+static void complete(Conn& conn, int status) {
+    const Pending& p = conn.inflight.front();
+    long latency = nowUsec() - p.intended;
+    g_res.latency.record(latency > 0 ? static_cast<unsigned long>(latency) : 0);
+    if (p.record >= 0)
+        ++g_res.byMethod[methodOf(g_capture[p.record].data)];
+    else
+        ++g_res.byType[p.type];
+    ++g_res.statuses[status];
+    ++g_res.completed;
+    conn.inflight.pop_front();
+}
+
+static void readConn(Conn& conn) {
+    char buffer[65536];
+    bool eof = false;
+    for (;;) {
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            conn.in.append(buffer, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        eof = true;     // chiusura o reset: quello che è arrivato vale
+        break;
+    }
+
+    int status;
+    bool mustClose = false;
+    while (!conn.inflight.empty() && takeResponse(conn, eof, status, mustClose)) {
+        complete(conn, status);
+        if (mustClose)
+            break;
+    }
+    if (eof || mustClose || (!g_opt.keepAlive && conn.inflight.empty()))
+        closeConn(conn);
+}
+
+// ********** REPORT **********
+
+// Come HdrHistogram: per ogni campione oltre l'intervallo atteso si
+// aggiungono i campioni che una richiesta a ritmo costante avrebbe visto
+static void correctedCopy(const Histogram& raw, unsigned long interval, Histogram& out) {
+    std::memset(&out, 0, sizeof(out));
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        unsigned long count = raw.counts[i];
+        if (count == 0)
+            continue;
+        unsigned long value = Histogram::bucketHigh(i) < raw.max ? Histogram::bucketHigh(i) : raw.max;
+        for (unsigned long v = value; ; v -= interval) {
+            size_t bucket = Histogram::bucketOf(v);
+            out.counts[bucket] += count;
+            out.total += count;
+            out.sum += v * count;
+            if (v > out.max)
+                out.max = v;
+            if (interval == 0 || v < 2 * interval)
+                break;
+        }
+    }
+}
+
+static void printLatency(const char* label, const Histogram& h) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    std::cout << "  " << std::left << std::setw(14) << label << std::right;
+    for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q)
+        std::cout << std::setw(10) << h.percentile(quantiles[q]) / 1000.0;
+    std::cout << std::setw(10) << h.max / 1000.0
+              << std::setw(10) << (h.total ? h.sum / 1000.0 / h.total : 0.0) << std::endl;
+}
+
+static void report(const Results& res, double seconds) {
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "requests    " << res.completed << " completed, " << res.errors << " errors, "
+              << res.retried << " retried, " << res.connects << " connections" << std::endl;
+    std::cout << "throughput  " << std::setprecision(1) << res.completed / seconds << " req/s, "
+              << res.bytesIn / seconds / (1024 * 1024) << " MiB/s in "
+              << std::setprecision(3) << seconds << " s" << std::endl;
+
+    if (g_capture.empty()) {
+        std::cout << "by type    ";
+        for (int t = 0; t < REQ_TYPES; ++t)
+            if (g_opt.weights[t])
+                std::cout << " " << g_typeNames[t] << " " << res.byType[t];
+    } else {
+        std::cout << "by method  ";
+        for (std::map<std::string, unsigned long>::const_iterator it = res.byMethod.begin();
+            it != res.byMethod.end(); ++it)
+            std::cout << " " << it->first << " " << it->second;
+    }
+    std::cout << std::endl << "status     ";
+    for (std::map<int, unsigned long>::const_iterator it = res.statuses.begin();
+        it != res.statuses.end(); ++it)
+        std::cout << " " << it->first << " " << it->second;
+    std::cout << std::endl;
+
+    Histogram snap;
+    res.latency.snapshot(snap);
+    std::cout << "latency (ms)          p50       p90       p99     p99.9       max      mean" << std::endl;
+    if (paced()) {
+        printLatency("from intended", snap);
+        return;
+    }
+    printLatency("measured", snap);
+    unsigned long interval = g_opt.intervalMs > 0
+        ? static_cast<unsigned long>(g_opt.intervalMs * 1000)
+        : (snap.total ? snap.sum / snap.total : 0);
+    Histogram corrected;
+    correctedCopy(snap, interval, corrected);
+    printLatency("corrected", corrected);
+    std::cout << "  (coordinated omission correction, expected interval "
+              << interval / 1000.0 << " ms)" << std::endl;
+}
+
+static void printDelta(const char* label, double a, double b) {
+    std::cout << "  " << std::left << std::setw(14) << label << std::right
+              << std::setw(12) << a << std::setw(12) << b;
+    if (a != 0)
+        std::cout << std::setw(10) << std::showpos << (b - a) / a * 100 << std::noshowpos << "%";
+    std::cout << std::endl;
+}
+
+// Stessa sequenza su due istanze: B rispetto ad A, in percentuale
+static void compare(const Results& a, double secondsA, const Results& b, double secondsB) {
+    Histogram ha, hb;
+    a.latency.snapshot(ha);
+    b.latency.snapshot(hb);
+    std::cout << "--- compare (B vs A) ---" << std::endl << std::fixed << std::setprecision(3)
+              << "  " << std::left << std::setw(14) << "" << std::right
+              << std::setw(12) << g_opt.port << std::setw(12) << g_opt.comparePort << std::endl;
+    printDelta("req/s", a.completed / secondsA, b.completed / secondsB);
+    printDelta("errors", a.errors, b.errors);
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    static const char* labels[] = { "p50 (ms)", "p90 (ms)", "p99 (ms)", "p99.9 (ms)" };
+    for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q)
+        printDelta(labels[q], ha.percentile(quantiles[q]) / 1000.0, hb.percentile(quantiles[q]) / 1000.0);
+    printDelta("max (ms)", ha.max / 1000.0, hb.max / 1000.0);
+    printDelta("mean (ms)", ha.total ? ha.sum / 1000.0 / ha.total : 0.0,
+        hb.total ? hb.sum / 1000.0 / hb.total : 0.0);
+}
+
+// ********** OPZIONI **********
+
+static void usage(const char* name) {
+    std::cerr << "Uso: " << name << " [opzioni]\n"
+        "  -H host        indirizzo IPv4 del server (127.0.0.1)\n"
+        "  -p port        porta (8080)\n"
+        "  -c n           connessioni (16)\n"
+        "  -d secondi     durata (10; 0 = fino a -n)\n"
+        "  -n n           richieste totali (0 = fino a -d)\n"
+        "  -r req/s       open loop a ritmo costante (0 = closed loop)\n"
+        "  -k             keep-alive\n"
+        "  -P n           richieste in pipeline per connessione (1, richiede -k)\n"
+        "  -m mix         pesi, es. get_small=60,get_large=10,head=15,post=10,delete=5\n"
+        "  -u tipo=path   path di un tipo di richiesta\n"
+        "  -b byte        dimensione del file nel POST multipart (1024)\n"
+        "  -s seed        seed della sequenza di richieste (1)\n"
+        "  -i ms          intervallo atteso per la correzione in closed loop (media)\n"
+        "  -R file        replay di una capture (direttiva capture) invece del mix\n"
+        "  -x fattore     replay: velocità rispetto ai tempi originali (1; 0 = closed loop)\n"
+        "  -B port        replay: rigioca anche su una seconda porta e confronta\n"
+        "  -I n           memoria: n connessioni inattive tenute aperte per -d secondi\n"
+        "  -L n           memoria: n connessioni lente (16 byte di header al secondo)\n"
+        "  -M path        memoria: location stub_status da cui leggere l'RSS (/status)\n";
+}
+
+static int typeIndex(const std::string& name) {
+    for (int t = 0; t < REQ_TYPES; ++t)
+        if (name == g_typeNames[t])
+            return t;
+    return -1;
+}
+
+// "nome=valore,nome=valore" su weights o paths
+static bool parsePairs(const std::string& spec, bool paths) {
+    std::istringstream iss(spec);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        size_t eq = item.find('=');
+        int t = (eq == std::string::npos) ? -1 : typeIndex(item.substr(0, eq));
+        if (t < 0)
+            return false;
+        if (paths)
+            g_opt.paths[t] = item.substr(eq + 1);
+        else
+            g_opt.weights[t] = static_cast<unsigned>(std::strtoul(item.c_str() + eq + 1, NULL, 10));
+    }
+    return true;
+}
+
+static bool parseOptions(int argc, char** argv) {
+    g_opt.host = "127.0.0.1";
+    g_opt.port = 8080;
+    g_opt.connections = 16;
+    g_opt.duration = 10;
+    g_opt.requests = 0;
+    g_opt.rate = 0;
+    g_opt.keepAlive = false;
+    g_opt.pipeline = 1;
+    g_opt.postSize = 1024;
+    g_opt.seed = 1;
+    g_opt.intervalMs = 0;
+    g_opt.speed = 1;
+    g_opt.comparePort = 0;
+    g_opt.idle = 0;
+    g_opt.slow = 0;
+    g_opt.statusPath = "/status";
+    const unsigned weights[REQ_TYPES] = { 60, 10, 15, 10, 5 };
+    const char* paths[REQ_TYPES] = { "/", "/large.bin", "/", "/upload", "/delete/loadgen-missing.txt" };
+    for (int t = 0; t < REQ_TYPES; ++t) {
+        g_opt.weights[t] = weights[t];
+        g_opt.paths[t] = paths[t];
+    }
+
+    int c;
+    while ((c = getopt(argc, argv, "H:p:c:d:n:r:kP:m:u:b:s:i:R:x:B:I:L:M:h")) != -1) {
+        switch (c) {
+            case 'H': g_opt.host = optarg; break;
+            case 'p': g_opt.port = std::atoi(optarg); break;
+            case 'c': g_opt.connections = std::atoi(optarg); break;
+            case 'd': g_opt.duration = std::atof(optarg); break;
+            case 'n': g_opt.requests = std::atol(optarg); break;
+            case 'r': g_opt.rate = std::atof(optarg); break;
+            case 'k': g_opt.keepAlive = true; break;
+            case 'P': g_opt.pipeline = std::atoi(optarg); break;
+            case 'm':
+                // Il mix sostituisce quello di default: i tipi assenti valgono 0
+                for (int t = 0; t < REQ_TYPES; ++t)
+                    g_opt.weights[t] = 0;
+                if (!parsePairs(optarg, false))
+                    return false;
+                break;
+            case 'u': if (!parsePairs(optarg, true)) return false; break;
+            case 'b': g_opt.postSize = std::strtoul(optarg, NULL, 10); break;
+            case 's': g_opt.seed = std::strtoul(optarg, NULL, 10); break;
+            case 'i': g_opt.intervalMs = std::atof(optarg); break;
+            case 'R': g_opt.replay = optarg; break;
+            case 'x': g_opt.speed = std::atof(optarg); break;
+            case 'B': g_opt.comparePort = std::atoi(optarg); break;
+            case 'I': g_opt.idle = std::atol(optarg); break;
+            case 'L': g_opt.slow = std::atol(optarg); break;
+            case 'M': g_opt.statusPath = optarg; break;
+            default: return false;
+        }
+    }
+    unsigned total = 0;
+    for (int t = 0; t < REQ_TYPES; ++t)
+        total += g_opt.weights[t];
+    bool replay = !g_opt.replay.empty();
+    if (g_opt.connections < 1 || g_opt.pipeline < 1 || g_opt.port < 1 || g_opt.port > 65535)
+        return false;
+    if (g_opt.idle < 0 || g_opt.slow < 0)
+        return false;
+    if (g_opt.idle + g_opt.slow > 0) {
+        std::memset(&g_addr, 0, sizeof(g_addr));
+        g_addr.sin_family = AF_INET;
+        return !replay && g_opt.duration > 0 && !g_opt.statusPath.empty()
+            && inet_pton(AF_INET, g_opt.host.c_str(), &g_addr.sin_addr) == 1;
+    }
+    if (!replay && (total == 0 || (g_opt.duration <= 0 && g_opt.requests <= 0)))
+        return false;
+    if (replay && (g_opt.speed < 0 || g_opt.comparePort < 0 || g_opt.comparePort > 65535))
+        return false;
+    if (!replay && (g_opt.rate < 0 || g_opt.comparePort != 0))
+        return false;
+    if (!g_opt.keepAlive)
+        g_opt.pipeline = 1;
+    std::memset(&g_addr, 0, sizeof(g_addr));
+    g_addr.sin_family = AF_INET;
+    return inet_pton(AF_INET, g_opt.host.c_str(), &g_addr.sin_addr) == 1;
+}
+
+// Capture ordinata per primo byte: i record sono scritti alla chiusura
+static bool earlier(const CaptureRecord& a, const CaptureRecord& b) {
+    return a.usec < b.usec;
+}
+
+static bool loadReplay() {
+    std::string error;
+    if (!Capture::load(g_opt.replay, g_capture, error)) {
+        std::cerr << error << std::endl;
+        return false;
+    }
+    if (g_capture.empty()) {
+        std::cerr << g_opt.replay << ": capture vuota" << std::endl;
+        return false;
+    }
+    std::stable_sort(g_capture.begin(), g_capture.end(), earlier);
+    // Una passata della capture: -n la accorcia, -d non conta
+    if (g_opt.requests <= 0 || g_opt.requests > static_cast<long>(g_capture.size()))
+        g_opt.requests = static_cast<long>(g_capture.size());
+    g_opt.duration = 0;
+    return true;
+}
+
+// ********** CONNESSIONI INATTIVE **********
+
+struct IdleConn {
+    int fd;
+    bool connected;
+    bool slow;
+};
+
+// Decine di migliaia di socket: il limite soft di solito è 1024
+static void raiseFileLimit() {
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+}
+
+// GET bloccante della pagina di stub_status in formato testo
+static bool fetchStatus(std::string& body) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&g_addr), sizeof(g_addr)) < 0) {
+        close(fd);
+        return false;
+    }
+    std::string request = "GET " + g_opt.statusPath + "?format=text HTTP/1.1\r\nHost: " + g_opt.host
+        + "\r\nUser-Agent: webserv-loadgen\r\nConnection: close\r\n\r\n";
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+        close(fd);
+        return false;
+    }
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        response.append(buffer, static_cast<size_t>(n));
+    close(fd);
+
+    size_t headEnd = response.find("\r\n\r\n");
+    if (headEnd == std::string::npos || response.size() < 12 || std::atoi(response.c_str() + 9) != 200)
+        return false;
+    body = response.substr(headEnd + 4);
+    return true;
+}
+
+// Numero dopo key nella pagina di stato, 0 se manca
+static unsigned long statusValue(const std::string& body, const char* key) {
+    size_t pos = body.find(key);
+    if (pos == std::string::npos)
+        return 0;
+    return std::strtoul(body.c_str() + pos + std::strlen(key), NULL, 10);
+}
+
+// Riga della pagina di stato che inizia con prefix, senza prefisso
+static std::string statusLine(const std::string& body, const char* prefix) {
+    size_t pos = body.find(prefix);
+    if (pos == std::string::npos)
+        return "n/a";
+    pos += std::strlen(prefix);
+    return body.substr(pos, body.find('\n', pos) - pos);
+}
+
+static void dropIdle(IdleConn& conn) {
+    epoll_ctl(g_epoll, EPOLL_CTL_DEL, conn.fd, NULL);
+    close(conn.fd);
+    conn.fd = -1;
+}
+
+// Apre -I + -L connessioni, le tiene per -d secondi (le lente mandano un
+// pezzo di header al secondo) e confronta lo stato del server prima e dopo
+static int runIdle() {
+    raiseFileLimit();
+    g_addr.sin_port = htons(static_cast<uint16_t>(g_opt.port));
+    std::string before;
+    if (!fetchStatus(before)) {
+        std::cerr << "stub_status unreachable at " << g_opt.host << ":" << g_opt.port
+                  << g_opt.statusPath << std::endl;
+        return 1;
+    }
+
+    g_epoll = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<IdleConn> conns(static_cast<size_t>(g_opt.idle + g_opt.slow));
+    unsigned long failed = 0, closedByServer = 0;
+    size_t pending = 0;
+    for (size_t i = 0; i < conns.size(); ++i) {
+        IdleConn& conn = conns[i];
+        conn.connected = false;
+        conn.slow = static_cast<long>(i) >= g_opt.idle;
+        conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (conn.fd < 0 || (connect(conn.fd, reinterpret_cast<struct sockaddr*>(&g_addr), sizeof(g_addr)) < 0
+            && errno != EINPROGRESS)) {
+            if (conn.fd >= 0)
+                close(conn.fd);
+            conn.fd = -1;
+            ++failed;
+            continue;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLOUT | EPOLLIN;
+        ev.data.u32 = static_cast<uint32_t>(i);
+        epoll_ctl(g_epoll, EPOLL_CTL_ADD, conn.fd, &ev);
+        ++pending;
+    }
+
+    // Le connessioni lente iniziano un header che non finisce mai
+    const std::string slowHead = "GET / HTTP/1.1\r\nHost: " + g_opt.host + "\r\nX-Slow: ";
+    const std::string slowChunk(LOADGEN_SLOW_CHUNK, 'a');
+    std::vector<struct epoll_event> events(1024);
+    long connectDeadline = nowUsec() + LOADGEN_CONNECT_USEC;
+    long end = 0;
+    long nextTick = 0;
+    for (;;) {
+        long now = nowUsec();
+        if (!end && (pending == 0 || now > connectDeadline)) {
+            end = now + static_cast<long>(g_opt.duration * 1e6);
+            nextTick = now;
+        }
+        if (end && now >= end)
+            break;
+        if (end && now >= nextTick) {
+            for (size_t i = 0; i < conns.size(); ++i)
+                if (conns[i].fd >= 0 && conns[i].connected && conns[i].slow)
+                    send(conns[i].fd, slowChunk.data(), slowChunk.size(), MSG_NOSIGNAL);
+            nextTick = now + 1000000L;
+        }
+
+        int timeout = end ? static_cast<int>((std::min(end, nextTick) - now) / 1000) : 100;
+        int ready = epoll_wait(g_epoll, &events[0], static_cast<int>(events.size()), timeout > 0 ? timeout : 0);
+        for (int e = 0; e < ready; ++e) {
+            IdleConn& conn = conns[events[e].data.u32];
+            if (conn.fd < 0)
+                continue;
+            if (!conn.connected) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                --pending;
+                if (err != 0) {
+                    dropIdle(conn);
+                    ++failed;
+                    continue;
+                }
+                conn.connected = true;
+                struct epoll_event ev;
+                ev.events = EPOLLIN;
+                ev.data.u32 = events[e].data.u32;
+                epoll_ctl(g_epoll, EPOLL_CTL_MOD, conn.fd, &ev);
+                if (conn.slow)
+                    send(conn.fd, slowHead.data(), slowHead.size(), MSG_NOSIGNAL);
+                continue;
+            }
+            // Una risposta o una chiusura: il server ha lasciato la connessione
+            dropIdle(conn);
+            ++closedByServer;
+        }
+    }
+    for (size_t i = 0; i < conns.size(); ++i) {
+        if (conns[i].fd >= 0 && !conns[i].connected) {
+            dropIdle(conns[i]);
+            ++failed;
+        }
+    }
+    unsigned long open = conns.size() - failed - closedByServer;
+
+    // Lo stato dopo va letto con le connessioni ancora aperte
+    std::string after;
+    bool haveAfter = fetchStatus(after);
+    for (size_t i = 0; i < conns.size(); ++i)
+        if (conns[i].fd >= 0)
+            dropIdle(conns[i]);
+    close(g_epoll);
+    if (!haveAfter) {
+        std::cerr << "stub_status unreachable after opening connections" << std::endl;
+        return 1;
+    }
+
+    unsigned long rssBefore = statusValue(before, "Memory: rss ");
+    unsigned long rssAfter = statusValue(after, "Memory: rss ");
+    long delta = static_cast<long>(rssAfter) - static_cast<long>(rssBefore);
+    std::cout << std::fixed << std::setprecision(1)
+              << "connections " << conns.size() << " opened (" << g_opt.idle << " idle, " << g_opt.slow
+              << " slow), " << failed << " failed, " << closedByServer << " closed by server, "
+              << open << " held for " << g_opt.duration << " s" << std::endl
+              << "server      active " << statusValue(before, "Active connections: ") << " -> "
+              << statusValue(after, "Active connections: ") << std::endl
+              << "server rss  " << rssBefore / 1048576.0 << " MiB -> " << rssAfter / 1048576.0
+              << " MiB (" << std::showpos << delta / 1024.0 << std::noshowpos << " KiB)" << std::endl
+              << "rss/conn    " << (open ? delta / static_cast<double>(open) : 0.0) << " bytes" << std::endl
+              << "accounted   " << statusLine(after, "Memory per connection: ") << " (bytes per connection)"
+              << std::endl;
+    return failed || closedByServer ? 2 : 0;
+}
+
+// ********** MAIN **********
+
+// Un test completo contro port: risultati in g_res, ritorna i secondi
+static double runLoad(int port) {
+    g_res = Results();
+    g_backlog.clear();
+    g_rng = g_opt.seed ? g_opt.seed : 1;
+    g_addr.sin_port = htons(static_cast<uint16_t>(port));
+
+    g_epoll = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Conn> conns(g_opt.connections);
+    for (size_t i = 0; i < conns.size(); ++i) {
+        if (!openConn(conns[i], i)) {
+            std::cerr << "connect: " << strerror(errno) << std::endl;
+            close(g_epoll);
+            return 0;
+        }
+    }
+
+    long start = nowUsec();
+    long end = g_opt.duration > 0 ? start + static_cast<long>(g_opt.duration * 1e6) : 0;
+    long issued = 0;
+    long drainUntil = 0;
+    std::vector<struct epoll_event> events(conns.size());
+
+    for (;;) {
+        long now = nowUsec();
+        bool issuing = (!end || now < end) && (!g_opt.requests || issued < g_opt.requests);
+
+        // Open loop: le richieste nascono dal calendario, non dalle risposte
+        if (issuing && paced()) {
+            while ((!g_opt.requests || issued < g_opt.requests) && scheduled(start, issued) <= now) {
+                g_backlog.push_back(nextPending(issued, scheduled(start, issued)));
+                ++issued;
+            }
+        }
+
+        // Connessioni chiuse riaperte, posti liberi riempiti
+        size_t inflight = 0;
+        for (size_t i = 0; i < conns.size(); ++i) {
+            Conn& conn = conns[i];
+            if (conn.fd < 0 && (issuing || !g_backlog.empty()) && !openConn(conn, i)) {
+                ++g_res.errors;
+                continue;
+            }
+            bool added = false;
+            while (conn.connected && hasRoom(conn)) {
+                if (!g_backlog.empty()) {
+                    assign(conn, g_backlog.front());
+                    g_backlog.pop_front();
+                } else if (issuing && !paced() && (!g_opt.requests || issued < g_opt.requests)) {
+                    assign(conn, nextPending(issued, now));
+                    ++issued;
+                } else
+                    break;
+                added = true;
+            }
+            if (added)
+                flushOut(conn, i);
+            inflight += conn.inflight.size();
+        }
+
+        if (g_res.completed == 0 && g_res.errors > LOADGEN_MAX_CONNECT_ERRORS) {
+            std::cerr << "server unreachable at " << g_opt.host << ":" << port << std::endl;
+            break;
+        }
+        if (!issuing && inflight == 0 && g_backlog.empty())
+            break;
+        if (!issuing && !drainUntil)
+            drainUntil = now + LOADGEN_DRAIN_USEC;
+        if (drainUntil && now > drainUntil) {
+            g_res.errors += inflight + g_backlog.size();
+            break;
+        }
+
+        int timeout = 10;
+        if (paced() && issuing) {
+            long next = scheduled(start, issued) - now;
+            timeout = next > 0 ? static_cast<int>(next / 1000) : 0;
+        }
+        int ready = epoll_wait(g_epoll, &events[0], static_cast<int>(events.size()), timeout);
+        for (int e = 0; e < ready; ++e) {
+            size_t slot = events[e].data.u32;
+            Conn& conn = conns[slot];
+            if (conn.fd < 0)
+                continue;
+            if (!conn.connected && (events[e].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0) {
+                    ++g_res.errors;
+                    closeConn(conn);
+                    continue;
+                }
+                conn.connected = true;
+            }
+            if (events[e].events & EPOLLOUT)
+                flushOut(conn, slot);
+            if (conn.fd >= 0 && (events[e].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                readConn(conn);
+        }
+    }
+
+    double seconds = (nowUsec() - start) / 1e6;
+    for (size_t i = 0; i < conns.size(); ++i)
+        if (conns[i].fd >= 0)
+            close(conns[i].fd);
+    close(g_epoll);
+    return seconds;
+}
+
+int main(int argc, char** argv) {
+    if (!parseOptions(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (g_opt.idle + g_opt.slow > 0) {
+        std::cout << "webserv loadgen: " << g_opt.host << ":" << g_opt.port << ", " << g_opt.idle
+                  << " idle + " << g_opt.slow << " slow connections for " << g_opt.duration << " s" << std::endl;
+        return runIdle();
+    }
+    if (!g_opt.replay.empty() && !loadReplay())
+        return 1;
+    buildRequests();
+
+    std::cout << "webserv loadgen: " << g_opt.host << ":" << g_opt.port << ", "
+              << g_opt.connections << " connections, ";
+    if (!g_capture.empty()) {
+        std::cout << "replay " << g_opt.replay << " (" << g_opt.requests << " requests, "
+                  << (g_capture.back().usec - g_capture.front().usec) / 1e6 << " s captured) ";
+        if (paced())
+            std::cout << "at " << g_opt.speed << "x";
+        else
+            std::cout << "closed loop";
+    } else {
+        std::cout << (paced() ? "open loop " : "closed loop");
+        if (paced())
+            std::cout << g_opt.rate << " req/s";
+    }
+    std::cout << ", keep-alive " << (g_opt.keepAlive ? "on" : "off")
+              << ", pipeline " << g_opt.pipeline;
+    if (g_capture.empty()) {
+        std::cout << ", seed " << g_opt.seed << std::endl << "mix        ";
+        for (int t = 0; t < REQ_TYPES; ++t)
+            if (g_opt.weights[t])
+                std::cout << " " << g_typeNames[t] << "=" << g_opt.weights[t] << " " << g_opt.paths[t];
+    }
+    std::cout << std::endl;
+
+    double seconds = runLoad(g_opt.port);
+    if (seconds <= 0)
+        return 1;
+    if (!g_opt.comparePort) {
+        report(g_res, seconds);
+        return g_res.errors ? 2 : 0;
+    }
+
+    // Confronto: A e B in sequenza, mai in parallelo sulla stessa macchina
+    Results first = g_res;
+    std::cout << "--- A: port " << g_opt.port << " ---" << std::endl;
+    report(first, seconds);
+    double secondsB = runLoad(g_opt.comparePort);
+    if (secondsB <= 0)
+        return 1;
+    std::cout << "--- B: port " << g_opt.comparePort << " ---" << std::endl;
+    report(g_res, secondsB);
+    compare(first, seconds, g_res, secondsB);
+    return (first.errors || g_res.errors) ? 2 : 0;
+}
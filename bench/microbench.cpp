@@ -0,0 +1,530 @@
+// ********** MICROBENCH **********
+// Micro-benchmark dei percorsi caldi: parser, routing, path e risposta.
+// Riporta ns e allocazioni per operazione (operator new contato qui sotto)
+// Uso: make microbench && ./microbench [iterazioni]
+
+#include "Regex.hpp"
+#include "LocationTrie.hpp"
+#include "utils.hpp"
+#include "MimeTable.hpp"
+#include "ConfigParser.hpp"
+#include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
+#include "Server.hpp"
+#include "BufferPool.hpp"
+#include <iostream>
+#include <fstream>
+#include <new>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Impedisce al compilatore di eliminare il lavoro misurato
+static volatile long g_sink = 0;
+
+static double nowNs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+// ********** ALLOCAZIONI **********
+// Ogni new (anche quelle di std::string e dei container) passa da qui.
+// Il benchmark è a thread singolo: basta un contatore semplice
+
+static long g_allocs = 0;
+static long g_allocsStart = 0;
+static long g_allocsEnd = 0;
+
+void* operator new(std::size_t size) throw(std::bad_alloc) {
+    ++g_allocs;
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+// noinline: inlinato nei container, GCC segnalerebbe free() su memoria di new
+__attribute__((noinline)) void operator delete(void* p) throw() {
+    std::free(p);
+}
+
+static double startTimer() {
+    g_allocsStart = g_allocs;
+    return nowNs();
+}
+
+static double stopTimer(double start) {
+    double elapsed = nowNs() - start;
+    g_allocsEnd = g_allocs;
+    return elapsed;
+}
+
+static void report(const std::string& name, double totalNs, long iterations, size_t bytes) {
+    double perOp = totalNs / iterations;
+    double allocs = static_cast<double>(g_allocsEnd - g_allocsStart) / iterations;
+    std::cout << std::left << std::setw(44) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1) << perOp << " ns/op"
+              << std::setw(8) << std::setprecision(2) << allocs << " alloc/op";
+    if (bytes)
+        std::cout << std::setw(10) << std::setprecision(2) << perOp / bytes << " ns/byte";
+    std::cout << std::endl;
+}
+
+// URI di lunghezza data che termina con l'estensione indicata
+static std::string makeUri(size_t len, const std::string& ext) {
+    std::string uri = "/static";
+    while (uri.size() + ext.size() + 8 < len)
+        uri += "/segment";
+    uri += "/file";
+    uri += ext;
+    return uri;
+}
+
+// ********** REGEX **********
+
+static void benchRegex(const std::string& label, const std::string& pattern, bool icase,
+    const std::string& uri, long iterations)
+{
+    Regex re;
+    std::string error;
+    if (!re.compile(pattern, icase, error)) {
+        std::cerr << "pattern non valido " << pattern << ": " << error << std::endl;
+        return;
+    }
+    re.search(uri);    // riscalda la cache del DFA
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += re.search(uri.data(), uri.size());
+    report(label + (re.usesDfa() ? " [dfa]" : " [backtrack]"), stopTimer(start), iterations, uri.size());
+}
+
+// ********** LOCATION_TRIE **********
+
+static void benchTrie(const std::string& uri, long iterations) {
+    LocationTrie trie;
+    const char* paths[] = { "/", "/static", "/static/img/", "/api", "/api/v1", "/uploads", NULL };
+    for (size_t i = 0; paths[i]; ++i)
+        trie.insert(paths[i], i);
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += trie.match(uri.data(), uri.size());
+    report("trie prefix match", stopTimer(start), iterations, uri.size());
+}
+
+// ********** CANONICALIZE_PATH **********
+
+// Riferimento lento ma ovvio: decodifica, split sui '/', stack di segmenti
+static PathStatus referenceCanonicalize(const std::string& path, std::string& out) {
+    if (path.empty() || path[0] != '/')
+        return PATH_INVALID;
+    std::string decoded;
+    for (size_t i = 0; i < path.size(); ++i) {
+        char c = path[i];
+        if (c == '%') {
+            if (i + 2 >= path.size() || !std::isxdigit(static_cast<unsigned char>(path[i + 1]))
+                || !std::isxdigit(static_cast<unsigned char>(path[i + 2])))
+                return PATH_INVALID;
+            c = static_cast<char>(std::strtol(path.substr(i + 1, 2).c_str(), NULL, 16));
+            i += 2;
+        }
+        if (c == '\0')
+            return PATH_INVALID;
+        decoded += c;
+    }
+
+    std::vector<std::string> segments;
+    size_t start = 1;
+    while (true) {
+        size_t slash = decoded.find('/', start);
+        segments.push_back(decoded.substr(start, slash == std::string::npos ? std::string::npos : slash - start));
+        if (slash == std::string::npos)
+            break;
+        start = slash + 1;
+    }
+
+    PathStatus status = PATH_OK;
+    std::vector<std::string> stack;
+    bool trailing = false;
+    for (size_t k = 0; k < segments.size(); ++k) {
+        bool last = (k + 1 == segments.size());
+        trailing = last;
+        if (segments[k].empty()) {
+            if (!last)
+                status = PATH_REWRITTEN;
+        } else if (segments[k] == ".") {
+            status = PATH_REWRITTEN;
+        } else if (segments[k] == "..") {
+            if (stack.empty())
+                return PATH_ESCAPES_ROOT;
+            stack.pop_back();
+            status = PATH_REWRITTEN;
+        } else {
+            stack.push_back(segments[k]);
+            trailing = false;
+        }
+    }
+    out = "/";
+    for (size_t k = 0; k < stack.size(); ++k)
+        out += stack[k] + (k + 1 < stack.size() || trailing ? "/" : "");
+    return status;
+}
+
+static std::string randomPath() {
+    const char* pieces[] = { "/", "/", "a", "bc", ".", "..", "%2e", "%2E%2e", "%2f", "%41",
+        "%00", "%", "%4", "%zz", "x.y", "...", "/./", "/../", "//" };
+    std::string path = "/";
+    int n = std::rand() % 12;
+    for (int i = 0; i < n; ++i)
+        path += pieces[std::rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+    return path;
+}
+
+// Confronto con il riferimento su input casuali: il benchmark non parte se divergono
+static bool fuzzCanonicalize(long rounds) {
+    char buf[CANONICAL_PATH_MAX];
+    for (long i = 0; i < rounds; ++i) {
+        std::string path = randomPath();
+        std::string expected;
+        size_t len = 0;
+        PathStatus want = referenceCanonicalize(path, expected);
+        PathStatus got = canonicalizePath(path.data(), path.size(), buf, sizeof(buf), len);
+        // Con più errori nello stesso path il passaggio unico riporta il
+        // primo incontrato: basta che entrambi rifiutino
+        bool rejected = (want == PATH_INVALID || want == PATH_ESCAPES_ROOT)
+            && (got == PATH_INVALID || got == PATH_ESCAPES_ROOT);
+        if (!rejected && (want != got || expected != std::string(buf, len))) {
+            std::cerr << "canonicalizePath diverge su \"" << path << "\": atteso " << want << " \""
+                      << expected << "\", ottenuto " << got << " \"" << std::string(buf, len) << "\"" << std::endl;
+            return false;
+        }
+    }
+    std::cout << "canonicalizePath: " << rounds << " path casuali identici al riferimento" << std::endl;
+    return true;
+}
+
+static void benchCanonicalize(const std::string& label, const std::string& path, long iterations) {
+    char buf[CANONICAL_PATH_MAX];
+    size_t len = 0;
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += canonicalizePath(path.data(), path.size(), buf, sizeof(buf), len) + len;
+    report("canonicalizePath " + label, stopTimer(start), iterations, path.size());
+
+    // Il vecchio percorso: normalizePath con split e ricostruzione
+    start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += normalizePath(path).size();
+    report("normalizePath " + label, stopTimer(start), iterations, path.size());
+}
+
+// ********** MIME_TABLE **********
+
+static void benchMime(long iterations) {
+    MimeTable table;
+    const char* paths[] = { "/static/site.css", "/img/photo.JPEG", "/download/archive.tar.gz",
+        "/docs/README", "/app/main.js" };
+    const size_t count = sizeof(paths) / sizeof(paths[0]);
+    size_t lengths[count];
+    for (size_t i = 0; i < count; ++i)
+        lengths[i] = std::strlen(paths[i]);
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += table.lookup(paths[i % count], lengths[i % count]).size();
+    report("mime lookup (perfect hash)", stopTimer(start), iterations, 0);
+}
+
+// ********** ACCESSO AI PRIVATI **********
+// Friend di HttpRequest e Server: i metodi privati misurati da soli
+
+struct MicrobenchAccess {
+    static void parseMultipart(HttpRequest& request, const std::string& body) {
+        request._bodyData = body.data();
+        request._bodyLen = body.size();
+        request._postData.clear();
+        request._parseMultipartFormData();
+    }
+
+    static std::string urlDecode(HttpRequest& request, const std::string& str) {
+        return request._urlDecode(str);
+    }
+
+    static const LocationConfig* findLocation(const Server& server, const std::string& uri,
+        const ServerConfig& config)
+    {
+        return server._findLocationMatch(uri, config);
+    }
+};
+
+// ********** HTTP_REQUEST **********
+
+// Richiesta tipica di un browser
+static const char* const BROWSER_GET =
+    "GET /static/img/logo.png?v=3 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: image/avif,image/webp,image/png,image/svg+xml,image/*;q=0.8,*/*;q=0.5\r\n"
+    "Accept-Language: it-IT,it;q=0.8,en-US;q=0.5,en;q=0.3\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Referer: https://www.example.com/index.html\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=4f2a9c7e1b3d5f60; theme=dark\r\n"
+    "Sec-Fetch-Dest: image\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "\r\n";
+
+// Form urlencoded con body
+static const char* const FORM_POST =
+    "POST /upload HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 67\r\n"
+    "\r\n"
+    "name=Mario+Rossi&email=mario%40example.com&city=Citt%C3%A0+di+Torino";
+
+#define MULTIPART_BOUNDARY "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+
+static void benchParse(const std::string& label, const std::string& raw, long iterations) {
+    std::string error;
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i) {
+        HttpRequest request;
+        g_sink += HttpRequest::parse(raw, request, error);
+    }
+    report("HttpRequest::parse " + label, stopTimer(start), iterations, raw.size());
+}
+
+// Solo campi di form: le parti con filename scriverebbero su disco
+static void benchMultipart(long iterations) {
+    const char* fields[][2] = {
+        { "username", "mrossi" },
+        { "email", "mario.rossi@example.com" },
+        { "comment", "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod "
+                     "tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, "
+                     "quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo." },
+        { "csrf_token", "b1946ac92492d2347c6235b4d2611184" }
+    };
+    std::string body;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        body += "--" MULTIPART_BOUNDARY "\r\nContent-Disposition: form-data; name=\"";
+        body += fields[i][0];
+        body += "\"\r\n\r\n";
+        body += fields[i][1];
+        body += "\r\n";
+    }
+    body += "--" MULTIPART_BOUNDARY "--\r\n";
+
+    std::string raw = "POST /upload HTTP/1.1\r\nHost: www.example.com\r\n"
+        "Content-Type: multipart/form-data; boundary=" MULTIPART_BOUNDARY "\r\n\r\n";
+    HttpRequest request;
+    std::string error;
+    if (!HttpRequest::parse(raw, request, error)) {
+        std::cerr << "richiesta multipart non valida: " << error << std::endl;
+        return;
+    }
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i) {
+        MicrobenchAccess::parseMultipart(request, body);
+        g_sink += request.getPostData().size();
+    }
+    report("_parseMultipartFormData 4 campi", stopTimer(start), iterations, body.size());
+}
+
+static void benchUrlDecode(long iterations) {
+    HttpRequest request;
+    const std::string plain = "/static/img/icons/file.png";
+    const std::string encoded = "caf%C3%A9+cr%C3%A8me&redirect=%2Fshop%2Fcart%3Fid%3D42";
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += MicrobenchAccess::urlDecode(request, plain).size();
+    report("_urlDecode senza escape", stopTimer(start), iterations, plain.size());
+
+    start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += MicrobenchAccess::urlDecode(request, encoded).size();
+    report("_urlDecode con escape", stopTimer(start), iterations, encoded.size());
+}
+
+// ********** PATH **********
+
+static void benchJoinPaths(long iterations) {
+    const std::string root = "/var/www/html";
+    const std::string uri = "/static/img/icons/file.png";
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += joinPaths(root, uri).size();
+    report("joinPaths root + URI", stopTimer(start), iterations, root.size() + uri.size());
+}
+
+// ********** ROUTING **********
+
+// Location di un sito realistico: esatte, prefissi, ^~ e regex
+static const char* const ROUTING_CONF =
+    "server {\n"
+    "    listen 127.0.0.1:8080;\n"
+    "    server_name www.example.com;\n"
+    "    location / {\n        root /var/www/html;\n    }\n"
+    "    location = /favicon.ico {\n        root /var/www/html;\n    }\n"
+    "    location /static/ {\n        root /var/www/html;\n    }\n"
+    "    location ^~ /static/vendor/ {\n        root /var/www/html;\n    }\n"
+    "    location /api {\n        root /var/www/api;\n    }\n"
+    "    location /api/v1 {\n        root /var/www/api;\n    }\n"
+    "    location /uploads {\n        root /var/www/data;\n    }\n"
+    "    location ~* \\.(png|jpe?g|gif|css|js)$ {\n        root /var/www/html;\n    }\n"
+    "    location ~ ^/users/[0-9]+/avatar$ {\n        root /var/www/data;\n    }\n"
+    "}\n";
+
+static bool loadRoutingConfig(std::vector<ServerConfig>& servers) {
+    char path[] = "/tmp/microbench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::cerr << "mkstemp fallita" << std::endl;
+        return false;
+    }
+    close(fd);
+    std::ofstream file(path);
+    file << ROUTING_CONF;
+    file.close();
+    try {
+        ConfigParser parser(path);
+        parser.parse();
+        servers = parser.getServers();
+    } catch (const std::exception& e) {
+        std::cerr << "configurazione di routing non valida: " << e.what() << std::endl;
+    }
+    unlink(path);
+    return !servers.empty();
+}
+
+static void benchFindLocation(long iterations) {
+    std::vector<ServerConfig> servers;
+    if (!loadRoutingConfig(servers))
+        return;
+    const ServerConfig& config = servers[0];
+    Server server;
+
+    const char* uris[][2] = {
+        { "exact", "/favicon.ico" },
+        { "^~ prefix", "/static/vendor/jquery.min.js" },
+        { "regex", "/img/gallery/photo.jpeg" },
+        { "second regex", "/users/1234/avatar" },
+        { "prefix after regex miss", "/api/v1/users/42" },
+        { "root fallback", "/about/team" }
+    };
+    for (size_t u = 0; u < sizeof(uris) / sizeof(uris[0]); ++u) {
+        const std::string uri = uris[u][1];
+        double start = startTimer();
+        for (long i = 0; i < iterations; ++i)
+            g_sink += reinterpret_cast<long>(MicrobenchAccess::findLocation(server, uri, config));
+        report(std::string("_findLocationMatch ") + uris[u][0], stopTimer(start), iterations, uri.size());
+    }
+}
+
+// ********** HTTP_RESPONSE **********
+
+static void benchContentType(long iterations) {
+    const std::string paths[] = { "/static/site.css", "/img/photo.JPEG", "/download/archive.tar.gz",
+        "/docs/README", "/app/main.js" };
+    const size_t count = sizeof(paths) / sizeof(paths[0]);
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += HttpResponse::getContentType(paths[i % count]).size();
+    report("HttpResponse::getContentType", stopTimer(start), iterations, 0);
+}
+
+static void makeResponse(HttpResponse& response, int status, size_t bodySize) {
+    response.setStatusCode(status);
+    response.setHeader("Content-Type", "text/html");
+    response.setHeader("Content-Length", to_string98(bodySize));
+    response.setHeader("Server", "webserv/1.0");
+    response.setHeader("Connection", "close");
+    response.addHeaderLines("Cache-Control: max-age=3600\r\n");
+}
+
+static void benchToString(const std::string& label, int status, size_t bodySize, long iterations) {
+    HttpResponse response;
+    makeResponse(response, status, bodySize);
+    response.setBody(std::string(bodySize, 'x'));
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i)
+        g_sink += response.toString().size();
+    report("HttpResponse::toString " + label, stopTimer(start), iterations, 0);
+}
+
+// Come _sendFile: header e body nello stesso buffer del pool, già caldo
+static void benchPooledResponse(const std::string& label, int status, size_t bodySize, long iterations) {
+    HttpResponse response;
+    makeResponse(response, status, bodySize);
+    std::string body(bodySize, 'x');
+    BufferPool pool;
+    IoBuffer warm;
+    pool.acquire(warm, bodySize + RESPONSE_HEADER_RESERVE);
+    pool.release(warm);
+
+    double start = startTimer();
+    for (long i = 0; i < iterations; ++i) {
+        IoBuffer out;
+        pool.acquire(out, bodySize + RESPONSE_HEADER_RESERVE);
+        size_t head = response.writeHeaders(out.data, out.capacity);
+        std::memcpy(out.data + head, body.data(), bodySize);
+        g_sink += head + bodySize;
+        pool.release(out);
+    }
+    report("writeHeaders + pool " + label, stopTimer(start), iterations, 0);
+}
+
+int main(int argc, char** argv) {
+    long iterations = (argc > 1) ? std::atol(argv[1]) : 200000;
+    if (iterations <= 0)
+        iterations = 200000;
+
+    std::srand(42);
+    if (!fuzzCanonicalize(200000))
+        return 1;
+    benchCanonicalize("clean", "/static/img/icons/file.png", iterations);
+    benchCanonicalize("dot segments", "/static/./img/../img//icons/%66ile.png", iterations);
+    benchMime(iterations);
+    benchJoinPaths(iterations);
+
+    benchParse("GET browser", BROWSER_GET, iterations);
+    benchParse("POST form", FORM_POST, iterations);
+    benchMultipart(iterations);
+    benchUrlDecode(iterations);
+    benchFindLocation(iterations);
+    benchContentType(iterations);
+    benchToString("404 senza body", 404, 0, iterations);
+    benchToString("200 body 4 KiB", 200, 4096, iterations);
+    benchPooledResponse("404 senza body", 404, 0, iterations);
+    benchPooledResponse("200 body 4 KiB", 200, 4096, iterations);
+
+    size_t lengths[] = { 16, 256, 4096 };
+    for (size_t i = 0; i < 3; ++i) {
+        std::string hit = makeUri(lengths[i], ".png");
+        std::string miss = makeUri(lengths[i], ".txt");
+        std::cout << "--- URI " << hit.size() << " byte ---" << std::endl;
+        long n = iterations / static_cast<long>(1 + lengths[i] / 64);
+
+        benchRegex("~ \\.(png|jpg|gif)$ hit", "\\.(png|jpg|gif)$", false, hit, n);
+        benchRegex("~ \\.(png|jpg|gif)$ miss", "\\.(png|jpg|gif)$", false, miss, n);
+        benchRegex("~* ^/static/.*\\.(PNG|CSS)$", "^/static/.*\\.(PNG|CSS)$", true, hit, n);
+        benchRegex("~ ^/(\\w+)/\\1 miss", "^/(\\w+)/\\1", false, miss, n);
+        benchTrie(hit, n);
+    }
+    return g_sink == -1;
+}
@@ -0,0 +1,54 @@
+#!/bin/bash
+# Benchmark riproducibile: fixture in /tmp/webserv-bench, webserv con
+# conf/bench.conf, closed e open loop di loadgen con seed fisso, memoria per
+# connessione e stub_status finale. Nessuno scenario keep-alive: il server
+# chiude dopo ogni risposta. Esce con errore se loadgen riporta errori
+# Variabili: BENCH_DURATION (secondi per scenario, 5), BENCH_CONNECTIONS (16),
+# BENCH_RATE (req/s dell'open loop, 1000), BENCH_IDLE (connessioni tenute
+# aperte per la memoria, 2000, un quinto lente)
+
+cd "$(dirname "$0")/.." || exit 1
+
+DIR=/tmp/webserv-bench
+PORT=8090
+DURATION=${BENCH_DURATION:-5}
+CONNECTIONS=${BENCH_CONNECTIONS:-16}
+RATE=${BENCH_RATE:-1000}
+IDLE=${BENCH_IDLE:-2000}
+MIX=get_small=60,get_large=10,head=15,post=10,delete=5
+
+rm -rf "$DIR"
+mkdir -p "$DIR/www/delete" "$DIR/www/upload" "$DIR/uploads"
+cp www/index.html "$DIR/www/index.html"
+head -c 1048576 /dev/zero | tr '\0' 'x' > "$DIR/www/large.bin"
+
+./webserv conf/bench.conf &
+PID=$!
+trap 'kill $PID 2>/dev/null; wait $PID 2>/dev/null' EXIT
+for i in $(seq 1 50); do
+    (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null && break
+    sleep 0.1
+done
+
+echo "=== $(uname -sr), $(nproc) cpu, webserv $(git rev-parse --short HEAD 2>/dev/null)"
+echo
+STATUS=0
+echo "=== closed loop, $CONNECTIONS connections"
+./loadgen -p $PORT -c "$CONNECTIONS" -d "$DURATION" -m $MIX -s 1 || STATUS=1
+echo
+echo "=== open loop, $RATE req/s"
+./loadgen -p $PORT -c "$CONNECTIONS" -d "$DURATION" -m $MIX -s 3 -r "$RATE" || STATUS=1
+echo
+echo "=== memory, $IDLE idle connections"
+./loadgen -p $PORT -d 2 -I $((IDLE - IDLE / 5)) -L $((IDLE / 5)) || STATUS=1
+echo
+echo "=== stub_status"
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+printf 'GET /status HTTP/1.1\r\nHost: bench\r\nConnection: close\r\n\r\n' >&3
+sed '1,/^\r$/d' <&3
+exec 3<&-
+
+if [ $STATUS -ne 0 ]; then
+    echo "loadgen reported errors" >&2
+fi
+exit $STATUS
@@ -0,0 +1,84 @@
+// ********** ACCESS_LOG_HPP **********
+// Access log con formato compilato al caricamento: le righe si accumulano in
+// un buffer scritto quando è pieno o dopo un intervallo
+
+#ifndef ACCESS_LOG_HPP
+#define ACCESS_LOG_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <sys/time.h>
+#include "Client.hpp"
+
+// Byte accumulati prima di una write
+#define ACCESS_LOG_BUFFER (64 * 1024)
+
+// Ritardo massimo di una riga nel buffer
+#define ACCESS_LOG_FLUSH_MS 1000
+
+// Formato di default: indirizzo, vhost, richiesta, status, byte e tempi
+#define ACCESS_LOG_FORMAT_MAIN \
+    "$remote_addr $host [$time_local] \"$request\" $status $bytes_sent $request_time $file_time"
+
+// Formato combined di nginx/Apache
+#define ACCESS_LOG_FORMAT_COMBINED \
+    "$remote_addr - - [$time_local] \"$request\" $status $bytes_sent \"$http_referer\" \"$http_user_agent\""
+
+class AccessLog {
+    public:
+        AccessLog();
+        ~AccessLog();
+
+        // Compila il formato ($variabile o ${variabile}); false con
+        // messaggio in error per una variabile sconosciuta
+        bool compile(const std::string& format, std::string& error);
+
+        // Apre il file in append; il formato deve essere già compilato
+        bool open(const std::string& path, std::string& error);
+        bool enabled() const;
+
+        // Formatta la richiesta conclusa in coda al buffer
+        void write(const Client& client);
+
+        // Scrive il buffer se è passato l'intervallo
+        void flushIfDue(const struct timeval& now);
+        void flush();
+
+        // Millisecondi prima del prossimo flush, -1 se il buffer è vuoto
+        long msUntilFlush(const struct timeval& now) const;
+
+        // Riapre lo stesso path (rotazione con SIGUSR1)
+        bool reopen(std::string& error);
+
+    private:
+        enum PartType {
+            PART_TEXT, PART_REMOTE_ADDR, PART_HOST, PART_SERVER_NAME,
+            PART_REQUEST, PART_REQUEST_METHOD, PART_REQUEST_URI, PART_URI,
+            PART_STATUS, PART_BYTES_SENT, PART_REQUEST_TIME, PART_FILE_TIME,
+            PART_TIME_LOCAL, PART_HTTP_REFERER, PART_HTTP_USER_AGENT
+        };
+
+        struct Part {
+            PartType type;
+            std::string text;       // PART_TEXT
+        };
+
+        std::vector<Part> _parts;
+        std::string _path;
+        int _fd;
+        std::string _buffer;
+        struct timeval _firstPending;   // prima riga non ancora scritta
+        time_t _timeSecond;             // $time_local rifatto una volta al secondo
+        std::string _timeLocal;
+
+        void _appendEscaped(const std::string& value);
+        void _appendMsec(long usec);
+        void _appendNumber(unsigned long n);
+
+        // Non copiabile
+        AccessLog(const AccessLog&);
+        AccessLog& operator=(const AccessLog&);
+};
+
+#endif
@@ -0,0 +1,66 @@
+// ********** BUFFER_POOL_HPP **********
+// Buffer di I/O a dimensione fissa (4, 16 e 64 KiB) ritagliati da slab e
+// riusati tra connessioni. Una connessione prende un buffer solo quando ha
+// dati in transito e lo restituisce alla chiusura: a regime recv e invio
+// dei file non chiamano malloc. Gli slab restano al pool fino alla
+// distruzione, la memoria segue il picco di connessioni attive
+
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+#define BUFFER_POOL_CLASSES 3
+#define BUFFER_POOL_MIN (4 * 1024)
+#define BUFFER_POOL_MAX (64 * 1024)
+
+// Ogni slab è diviso in buffer di una sola classe: 64, 16 o 4 buffer
+#define BUFFER_POOL_SLAB_SIZE (256 * 1024)
+
+// Buffer prestato dal pool; data NULL = nessun buffer
+struct IoBuffer {
+    char* data;
+    size_t capacity;
+    size_t length;      // byte validi dall'inizio
+
+    IoBuffer() : data(NULL), capacity(0), length(0) {}
+};
+
+class BufferPool {
+    public:
+        BufferPool();
+        ~BufferPool();
+
+        // Buffer vuoto della classe più piccola che contiene size (la più
+        // grande se size supera BUFFER_POOL_MAX); false se lo slab non si
+        // può allocare
+        bool acquire(IoBuffer& buffer, size_t size);
+
+        // Passa alla classe che contiene size conservando i dati; false se
+        // size supera BUFFER_POOL_MAX o manca memoria (buffer invariato)
+        bool grow(IoBuffer& buffer, size_t size);
+
+        // Restituisce il buffer (nulla se vuoto) e lo azzera
+        void release(IoBuffer& buffer);
+
+        // Byte degli slab allocati e byte prestati in questo momento
+        size_t slabBytes() const;
+        size_t inUse() const;
+
+    private:
+        // Lista dei buffer liberi per classe: il puntatore al successivo è
+        // scritto nei primi byte del buffer stesso
+        char* _free[BUFFER_POOL_CLASSES];
+        std::vector<char*> _slabs;
+        size_t _inUse;
+
+        static int _classFor(size_t size);
+        bool _refill(int sizeClass);
+
+        // Non copiabile
+        BufferPool(const BufferPool&);
+        BufferPool& operator=(const BufferPool&);
+};
+
+#endif
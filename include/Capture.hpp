@@ -0,0 +1,77 @@
+// ********** CAPTURE_HPP **********
+// Cattura dei byte grezzi delle richieste per riprodurle con loadgen -R.
+// Formato del file (interi little-endian, come li scrive x86/arm):
+//
+//   "WSCAP001"                                   8 byte, una volta
+//   usec u64 | length u32 | port u16 | flags u16  16 byte per record
+//   <length byte della richiesta>
+//
+// usec è il primo byte ricevuto (epoch), port quella del listener
+
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/time.h>
+
+#define CAPTURE_MAGIC "WSCAP001"
+#define CAPTURE_MAGIC_SIZE 8
+
+// Richieste più grandi non vengono catturate (upload)
+#define CAPTURE_RECORD_MAX (1024 * 1024)
+
+// Default di capture: tutte le richieste, file fino a 64 MiB
+#define CAPTURE_DEFAULT_SAMPLE 1
+#define CAPTURE_DEFAULT_MAX_SIZE (64 * 1024 * 1024)
+
+struct CaptureHeader {
+    uint64_t usec;
+    uint32_t length;
+    uint16_t port;
+    uint16_t flags;     // riservato, 0
+};
+
+// Record letto da un file di cattura
+struct CaptureRecord {
+    long usec;
+    int port;
+    std::string data;
+};
+
+class Capture {
+    public:
+        Capture();
+        ~Capture();
+
+        // Crea (o tronca) il file; sample: una connessione ogni N
+        bool open(const std::string& path, size_t sample, size_t maxSize, std::string& error);
+        bool enabled() const;
+
+        // Da chiamare all'accept: true se la connessione va catturata
+        bool sample();
+
+        // Scrive un record con una sola writev: le richieste catturate sono
+        // poche, un buffer come quello dell'access log non servirebbe.
+        // false quando la cattura si ferma (limite raggiunto o write
+        // fallita): il file viene chiuso e le chiamate dopo non fanno nulla
+        bool record(int port, const struct timeval& start, const std::string& data);
+
+        // Legge un file intero; false con messaggio in error se non è una
+        // cattura valida o è troncato a metà record
+        static bool load(const std::string& path, std::vector<CaptureRecord>& records, std::string& error);
+
+    private:
+        int _fd;
+        size_t _sample;
+        size_t _maxSize;
+        size_t _written;
+        unsigned long _seen;
+
+        // Non copiabile
+        Capture(const Capture&);
+        Capture& operator=(const Capture&);
+};
+
+#endif
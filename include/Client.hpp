@@ -0,0 +1,62 @@
+// ********** CLIENT_HPP **********
+// Stato di una connessione client tra una recv() e la successiva
+
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+#include <string>
+#include <netinet/in.h>
+#include <sys/time.h>
+#include "HttpRequest.hpp"
+#include "ConfigParser.hpp"
+#include "RouteCache.hpp"
+#include "BufferPool.hpp"
+
+// Limite per la sezione header, \r\n\r\n compreso: oltre la richiesta è rifiutata.
+// È anche la classe più grande del pool usata per riceverla
+#define CLIENT_MAX_HEADER_SIZE 16384
+
+// Limite per una singola riga (request line o header), come i buffer da 8k
+// di nginx: una riga enorme è rifiutata anche se il totale sta nel limite
+#define CLIENT_MAX_HEADER_LINE 8192
+
+// client_body_buffer_size di default: body più grandi vanno su disco
+#define CLIENT_BODY_BUFFER_SIZE 16384
+
+struct Client {
+    // Fasi della lettura: prima gli header, poi (se ammesso) il body
+    enum State { READING_HEADERS, READING_BODY };
+
+    Client();
+
+    State state;
+    int listenFd;                    // socket di ascolto che ha accettato
+    IoBuffer input;                  // recv e header, dal pool solo con dati in arrivo
+    std::string buffer;              // body in memoria (sotto client_body_buffer_size)
+    HttpRequest request;             // request line e header già parsati
+    bool pathRewritten;              // il path aveva '.', '..' o '//'
+    const ServerConfig* server;      // vhost risolto dopo gli header
+    const LocationConfig* location;  // location risolta dopo gli header
+    Route route;                     // GET/HEAD trovata in cache (location NULL se no)
+    size_t bodyExpected;             // Content-Length dichiarato
+    size_t bodyReceived;             // byte di body ricevuti finora
+    size_t bodyInMemory;             // byte di body contati nel budget globale
+    int bodyFd;                      // file temporaneo (già unlinkato) o -1
+
+    // Dati per l'access log
+    struct sockaddr_in address;      // peer, preso all'accept
+    struct timeval acceptTime;       // accept della connessione
+    struct timeval startTime;        // primo byte della richiesta
+    int status;                      // status inviato, 0 se nessuna risposta
+    size_t bytesReceived;            // byte ricevuti sulla connessione
+    size_t bytesSent;                // byte di risposta inviati
+    long fileUsec;                   // lettura del file servito, -1 se nessuna
+    ConnPhase phase;                 // gauge di stub_status in cui è contata
+    long fsUsec;                     // stat, index e lettura, -1 se nessun accesso
+
+    // Cattura (capture): byte grezzi ricevuti, se la connessione è campionata
+    bool capturing;
+    std::string captured;
+};
+
+#endif
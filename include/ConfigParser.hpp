@@ -8,30 +8,119 @@
 #include <vector>
 #include <map>
 #include <stdexcept>
+#include "LocationTrie.hpp"
+#include "Regex.hpp"
+#include "MimeTable.hpp"
+#include "ErrorPages.hpp"
+#include "Redirect.hpp"
+#include "Logger.hpp"
+#include "Stats.hpp"
+
+// Modificatore della location, nell'ordine di precedenza di nginx
+enum LocationModifier {
+    LOCATION_PREFIX,            // location /path
+    LOCATION_EXACT,             // location = /path
+    LOCATION_PREFIX_NOREGEX,    // location ^~ /path: se è il prefisso più lungo, niente regex
+    LOCATION_REGEX,             // location ~ pattern
+    LOCATION_REGEX_ICASE        // location ~* pattern
+};
+
+// Metodi HTTP come bit, per limit_except
+enum HttpMethod {
+    METHOD_GET = 1 << 0,
+    METHOD_HEAD = 1 << 1,
+    METHOD_POST = 1 << 2,
+    METHOD_DELETE = 1 << 3,
+    METHOD_ALL = METHOD_GET | METHOD_HEAD | METHOD_POST | METHOD_DELETE
+};
+
+// Bit del metodo, 0 se non supportato
+unsigned int methodBit(const std::string& method);
+
+// Direttiva expires, come in nginx
+enum ExpiresMode {
+    EXPIRES_UNSET,              // non presente: si eredita dal server
+    EXPIRES_OFF,                // expires off
+    EXPIRES_EPOCH,              // expires epoch: già scaduto, no-cache
+    EXPIRES_MAX,                // expires max: 31 dicembre 2037, max-age di 10 anni
+    EXPIRES_AFTER               // expires <tempo>: ora + tempo
+};
+
+// ********** RESPONSE_HEADERS **********
+// expires e add_header di un blocco server o location, come scritti nella config
+struct ResponseHeaders {
+    ExpiresMode expires;
+    long expires_time;          // secondi per EXPIRES_AFTER (negativo = no-cache)
+    bool immutable;             // expires ... immutable: aggiunto a Cache-Control
+    std::vector< std::pair<std::string, std::string> > add;    // vuoto = ereditati
+
+    ResponseHeaders();
+};
 
 // ********** LOCATION_CONFIG **********
-// Rappresenta un blocco location
+// Rappresenta un blocco location. Dopo il parsing i valori sono quelli
+// effettivi (ereditati dal server, root normalizzata): a runtime si leggono e basta
 struct LocationConfig {
-    std::string path;
-    std::string root;
-    std::string index;
+    std::string path;                       // prefisso o pattern della regex
+    LocationModifier modifier;
+    Regex regex;                            // compilata al caricamento (~ e ~*)
+    std::string root;                       // normalizzata, ereditata dal server
+    std::string alias;                      // sostituisce il prefisso della location (vuoto = root)
+    std::string index;                      // default index.html
     bool autoindex;
-    std::vector<std::string> methods;
-    std::string upload_dir;
+    unsigned int methods;                   // bitmask di HttpMethod (limit_except)
+    std::string upload_dir;                 // primo upload_store
+    std::vector<std::string> upload_dirs;   // tutte le radici, usate a turno
+    size_t upload_shard;                    // livelli di sottodirectory hash (0-2)
     std::map<std::string, std::string> cgi;
-    std::string redirect;
-    size_t max_body_size;
+    Redirect redirect;                      // return, serializzata al caricamento
+    std::map<int, std::string> error_pages; // della location, poi del server
+    ErrorPages errors;                      // error_pages già serializzate
+    size_t max_body_size;                   // ereditato da client_max_body_size (0 = nessun limite)
+    size_t body_buffer_size;                // ereditato dal server (0 = default)
+    ResponseHeaders headers;                // expires e add_header della location
+    std::string cache_headers;              // Cache-Control, Expires fisso e add_header già serializzati
+    long expires_after;                     // Expires = ora + expires_after; -1 se fisso o assente
+    StatusFormat stub_status;               // la location risponde con i contatori
 };
 
 // ********** SERVER_CONFIG **********
 // Rappresenta un blocco server
 struct ServerConfig {
     std::vector< std::pair<std::string,int> > listen;
-    std::string server_name;
+    std::vector<bool> listen_default;           // default_server per ogni listen
+    std::string server_name;                    // primo di server_names
+    std::vector<std::string> server_names;
     std::string root;
     std::map<int, std::string> error_pages;
     size_t client_max_body_size;
+    size_t client_body_buffer_size;         // oltre questa soglia il body va su disco
+    ResponseHeaders headers;                    // expires e add_header ereditati dalle location
     std::vector<LocationConfig> locations;
+    LocationTrie locationTrie;                  // indici in locations (prefissi ed esatte)
+    std::vector<size_t> regexLocations;         // location ~ e ~*, in ordine di config
+    LocationConfig fallback;                    // valori del server quando nessuna location fa match
+};
+
+// ********** GLOBAL_CONFIG **********
+// Direttive globali, fuori dai blocchi server
+struct GlobalConfig {
+    size_t upload_threads;      // thread del writer degli upload (0 = sincrono)
+    int upload_durability;      // vedi UploadWriter::Durability
+    size_t upload_sync_batch;   // file per ogni fdatasync in modalità batch
+    size_t body_memory_limit;   // byte di body in memoria per tutto il processo
+    std::string body_temp_path; // directory dei file temporanei dei body
+    size_t route_cache_size;    // route GET/HEAD in cache LRU (0 = disattivata)
+    MimeTable mime_types;       // types { } e include, altrimenti i predefiniti
+    std::string error_log;      // file di error_log o "stderr"
+    LogLevel error_log_level;   // righe sotto questo livello non vengono formattate
+    std::string access_log;     // file di access_log, vuoto se off
+    std::string access_log_format;  // formato risolto da log_format
+    std::string capture;        // file di cattura delle richieste, vuoto se off
+    size_t capture_sample;      // una connessione catturata ogni N
+    size_t capture_max_size;    // byte massimi del file di cattura
+
+    GlobalConfig();
 };
 
 // ********** CONFIG_EXCEPTION **********
@@ -53,6 +142,9 @@ class ConfigParser {
         // Ritorna la lista dei server
         const std::vector<ServerConfig>& getServers() const;
 
+        // Ritorna le direttive globali
+        const GlobalConfig& getGlobal() const;
+
         // Lista di host:port per il bind
         std::vector< std::pair<std::string,int> > getListenList() const;
 
@@ -60,6 +152,9 @@ class ConfigParser {
         std::string _path;
         std::vector<std::string> _rawLines;
         std::vector<ServerConfig> _servers;
+        GlobalConfig _global;
+        bool _typesSeen;        // il primo blocco types sostituisce i predefiniti
+        std::map<std::string, std::string> _logFormats;    // log_format per nome
 
         // Legge le righe del file
         void _readFile();
@@ -71,6 +166,12 @@ class ConfigParser {
         void _parseBlocks();
 
         // Parsers interni
+        void _parseGlobalLine(const std::string& line, size_t lineNum);
+        size_t _parseTypesBlock(const std::vector<std::string>& lines, size_t start);
+        void _parseInclude(const std::string& file, size_t lineNum);
+        void _parseLogFormatLine(const std::string& line, size_t lineNum);
+        void _parseAccessLogLine(const std::string& line, size_t lineNum);
+        void _parseCaptureLine(const std::string& line, size_t lineNum);
         ServerConfig _parseServerBlock(
             const std::vector<std::string>& block, size_t blockStartLine);
         LocationConfig _parseLocationBlock(
@@ -78,13 +179,24 @@ class ConfigParser {
         void _parseListenLine(const std::string& line,
             ServerConfig &srv, size_t lineNum);
         void _parseErrorPageLine(const std::string& line,
-            ServerConfig &srv, size_t lineNum);
+            std::map<int, std::string> &pages, size_t lineNum);
+        void _parseExpiresLine(const std::string& line,
+            ResponseHeaders &headers, size_t lineNum);
+        void _parseAddHeaderLine(const std::string& line,
+            ResponseHeaders &headers, size_t lineNum);
+        bool _parseTime(const std::string& value, long &seconds);
+        void _renderHeaders(LocationConfig &loc);
+        void _inheritServer(LocationConfig &loc, const ServerConfig &srv);
+        void _buildErrorPages();
 
         // Helpers stringa
         void _trim(std::string &s);
         void _stripSemicolon(std::string &s);
         bool _startsWith(const std::string &s,
             const std::string &pref);
+        int _braceDelta(const std::string &line);
+        void _parseLocationHeader(const std::string &line,
+            LocationConfig &loc, size_t lineNum);
 };
 
 #endif
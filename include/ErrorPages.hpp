@@ -0,0 +1,38 @@
+// ********** ERROR_PAGES_HPP **********
+// Risposte di errore serializzate (header + body) al caricamento della
+// config: a runtime un errore è una sola send di un buffer già pronto
+
+#ifndef ERROR_PAGES_HPP
+#define ERROR_PAGES_HPP
+
+#include <string>
+#include <map>
+
+class MimeTable;
+
+class ErrorPages {
+    public:
+        struct Response {
+            std::string data;       // status line, header e body
+            size_t headerLength;    // HEAD invia solo i primi headerLength byte
+        };
+
+        ErrorPages();
+
+        // Legge i file di error_page (root + URI) e li serializza;
+        // false con messaggio in error se un file non è leggibile
+        bool build(const std::map<int, std::string>& pages, const std::string& root,
+            const MimeTable& types, std::string& error);
+
+        // Risposta per il codice: la pagina configurata o quella predefinita
+        const Response& find(int code) const;
+
+    private:
+        std::map<int, Response> _pages;     // solo i codici con error_page
+
+        static Response _render(int code, const std::string& contentType, const std::string& body);
+        static Response _renderDefault(int code);
+        static const Response& _builtin(int code);
+};
+
+#endif
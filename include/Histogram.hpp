@@ -0,0 +1,39 @@
+// ********** HISTOGRAM_HPP **********
+// Istogramma log-lineare stile HDR a memoria fissa: 16 sotto-bucket per
+// potenza di due (errore massimo ~6%), registrazione con sole atomiche
+
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <string>
+
+// Bit dei sotto-bucket: 2^4 = 16 bucket lineari per ogni ottava
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+
+// Ottave coperte oltre la prima: valori fino a 2^41 µs (~25 giorni)
+#define HISTOGRAM_OCTAVES 38
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_COUNT * HISTOGRAM_OCTAVES)
+
+// Nessun costruttore: vive anche in memoria condivisa già azzerata
+struct Histogram {
+    unsigned long counts[HISTOGRAM_BUCKETS];
+    unsigned long total;
+    unsigned long sum;
+    unsigned long max;
+
+    // Lock-free: un incremento per bucket, totale e somma
+    void record(unsigned long value);
+
+    // Copia coerente per bucket, da cui si calcolano i percentili
+    void snapshot(Histogram& out) const;
+
+    // Valore più alto del bucket che contiene il quantile q (0..1)
+    unsigned long percentile(double q) const;
+
+    static size_t bucketOf(unsigned long value);
+    static unsigned long bucketLow(size_t index);
+    static unsigned long bucketHigh(size_t index);
+};
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <map>
+#include "ConfigParser.hpp"
+
+class UploadStore;
 
 class HttpRequest {
 public:
@@ -10,16 +13,19 @@ public:
     
     // Getters esistenti
     const std::string& getMethod() const;
-    const std::string& getUri() const;
+    const std::string& getUri() const;          // URI come ricevuto, mai riscritto
     const std::string& getVersion() const;
     const std::map<std::string, std::string>& getHeaders() const;
     std::string getHeader(const std::string& key) const;
     bool hasHeader(const std::string& key) const;
-    const std::string& getBody() const;
+    const std::string& getBody() const;     // vuoto se il body è su disco
     bool isComplete() const;
     
     // Path e query parsing esistenti
-    std::string getPath() const;
+    // Path prima di '?'; dopo setPath quello canonico e decodificato. Un
+    // %3F decodificato resta nel path, la query si legge sempre da _uri
+    const std::string& getPath() const;
+    void setPath(const char* path, size_t len);
     std::string getQueryString() const;
     std::map<std::string, std::string> getQueryParams() const;
 
@@ -30,20 +36,42 @@ public:
     size_t getContentLength() const;
     std::string getContentType() const;
 
-    // Parser principale esistente
+    // Parser principale esistente (header + body, senza consumare il body)
     static bool parse(const std::string& rawRequest, HttpRequest& request, std::string& errorMsg);
 
+    // Parsing a fasi: prima request line e header, poi il body solo se la
+    // richiesta ha superato i controlli di routing (limit_except, body size)
+    static bool parseHeaders(const std::string& rawHeaders, HttpRequest& request, std::string& errorMsg);
+    void setBody(const std::string& body);
+    void setBodyFile(int fd, size_t size);
+    bool isBodyOnDisk() const;
+    size_t getBodySize() const;
+    void parseBody(UploadStore* store = NULL, const LocationConfig* location = NULL);
+
+    // Byte sullo heap (stringhe, header, body in memoria, dati POST), senza
+    // sizeof(HttpRequest): per la memoria per connessione di stub_status
+    size_t heapUsage() const;
+
 private:
+    friend struct MicrobenchAccess;     // bench/microbench.cpp misura i metodi privati
+
     std::string _method;
     std::string _uri;
+    std::string _path;          // path canonico, separato da _uri
     std::string _version;
     std::map<std::string, std::string> _headers;
     std::string _body;
     bool _isComplete;
+    int _bodyFd;            // body su file temporaneo (-1 se in memoria)
+    size_t _bodySize;
+    const char* _bodyData;  // vista sul body durante parseBody
+    size_t _bodyLen;
     
     // NUOVI MEMBRI PER POST
     std::map<std::string, std::string> _postData;
     std::map<std::string, std::string> _uploadedFiles;
+    UploadStore* _uploadStore;
+    const LocationConfig* _uploadLocation;
 
     // Utility esistenti
     static std::string _toLower(const std::string& s);
@@ -55,9 +83,9 @@ private:
     void _parseUrlEncodedData();
     void _parseMultipartFormData();
     bool _isMultipartFormData() const;
-    void _parseMultipartPart(const std::string& part);
-    std::string _saveUploadedFile(const std::string& filename, const std::string& content);
-    std::string _generateUniqueFilename(const std::string& filename);
+    void _parseMultipartPart(size_t partStart, size_t partLength);
+    size_t _findInBody(const std::string& needle, size_t from) const;
+    std::string _saveUploadedFile(const std::string& filename, size_t offset, size_t length);
     std::string _urlDecode(const std::string& str);
 };
 
@@ -6,6 +6,10 @@
 #include "ConfigParser.hpp"
 #include "HttpRequest.hpp"
 
+// Spazio per status line e header davanti al body quando si sceglie il
+// buffer di un file: una risposta con validatori ne usa circa 300 byte
+#define RESPONSE_HEADER_RESERVE 1024
+
 class HttpResponse {
 public:
     HttpResponse();
@@ -13,7 +17,12 @@ public:
     void setStatusCode(int code);
     void setHeader(const std::string& key, const std::string& value);
     void setBody(const std::string& body);
+    void addHeaderLines(const std::string& lines);  // "Nome: valore\r\n" già serializzati
     std::string toString() const;
+
+    // Status line e header (senza body) scritti in out; 0 se non ci stanno.
+    // Per i file il body segue nello stesso buffer, senza copie in stringhe
+    size_t writeHeaders(char* out, size_t capacity) const;
     
     static std::string getStatusMessage(int code);
     static std::string getContentType(const std::string& path);
@@ -23,6 +32,7 @@ public:
 private:
     int _statusCode;
     std::map<std::string, std::string> _headers;
+    std::string _headerLines;
     std::string _body;
 };
 
@@ -0,0 +1,40 @@
+// ********** LOCATION_TRIE_HPP **********
+// Radix trie dei path delle location, compilato al caricamento della config
+
+#ifndef LOCATION_TRIE_HPP
+#define LOCATION_TRIE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class LocationTrie {
+    public:
+        LocationTrie();
+
+        // Inserisce il path di una location (a parità di path vince la prima);
+        // exact = location "=", che vale solo per l'URI identico
+        void insert(const std::string& path, size_t locationIndex, bool exact = false);
+
+        // Indice della location per l'URI in una sola discesa, -1 se nessuna:
+        // la location "=" identica all'URI (e *exact = true), altrimenti il
+        // prefisso più lungo che termina su un confine di segmento ('/'
+        // finale nella location, fine URI o '/' nell'URI)
+        long match(const char* uri, size_t len, bool* exact = NULL) const;
+        long match(const std::string& uri, bool* exact = NULL) const;
+
+    private:
+        struct Node {
+            std::string label;              // segmento compresso dell'arco entrante
+            std::vector<size_t> children;   // indici in _nodes
+            long location;                  // -1 se non termina una location
+            long exact;                     // location "=" con questo path, -1 se nessuna
+            bool slashTerminated;           // il path della location finisce con '/'
+        };
+
+        std::vector<Node> _nodes;           // _nodes[0] è la radice (label vuota)
+
+        size_t _newNode(const std::string& label, long location, bool slash);
+};
+
+#endif
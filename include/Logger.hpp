@@ -0,0 +1,138 @@
+// ********** LOGGER_HPP **********
+// Log a livelli: ogni thread formatta in un proprio ring buffer senza lock,
+// un thread flusher scrive i ring a blocchi sulla destinazione di error_log
+
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <pthread.h>
+
+// Riga più lunga (timestamp e livello compresi): oltre viene troncata
+#define LOG_LINE_MAX 4096
+
+// Byte di ring per thread: se il flusher resta indietro le righe si perdono
+#define LOG_RING_SIZE (256 * 1024)
+
+// Attesa massima del flusher tra due scritture
+#define LOG_FLUSH_INTERVAL_MS 50
+
+// Livelli di error_log, dal più verboso
+enum LogLevel {
+    LEVEL_DEBUG,
+    LEVEL_INFO,
+    LEVEL_NOTICE,
+    LEVEL_WARN,
+    LEVEL_ERROR,
+    LEVEL_CRIT
+};
+
+// Il messaggio non viene nemmeno valutato sotto il livello di error_log
+#define LOG(level, msg) \
+    do { \
+        if (Logger::enabled(level)) { \
+            LogLine logLine_(level); \
+            logLine_ << msg; \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(msg)  LOG(LEVEL_DEBUG, msg)
+#define LOG_INFO(msg)   LOG(LEVEL_INFO, msg)
+#define LOG_NOTICE(msg) LOG(LEVEL_NOTICE, msg)
+#define LOG_WARN(msg)   LOG(LEVEL_WARN, msg)
+#define LOG_ERROR(msg)  LOG(LEVEL_ERROR, msg)
+#define LOG_CRIT(msg)   LOG(LEVEL_CRIT, msg)
+
+class Logger {
+    public:
+        // Apre la destinazione ("stderr" o un file in append) e avvia il
+        // flusher; false con messaggio in error se il file non si apre
+        static bool open(const std::string& path, LogLevel level, std::string& error);
+
+        // Scrive tutto quello che resta nei ring e ferma il flusher
+        static void close();
+
+        // Riapre il file di error_log (rotazione con SIGUSR1): con il flusher
+        // attivo la riapertura la fa il flusher, dopo aver scritto i ring
+        static void reopen();
+
+        // Controllo del livello: una lettura e un confronto
+        static bool enabled(LogLevel level) { return level >= _level; }
+
+        // "debug", "info", "notice", "warn", "error", "crit"
+        static bool parseLevel(const std::string& name, LogLevel& level);
+        static const char* levelName(LogLevel level);
+
+        // Accoda una riga completa nel ring del thread chiamante; senza
+        // flusher (prima di open o dopo close) la scrive subito
+        static void commit(const char* line, size_t len);
+
+        // Righe perse perché un ring era pieno
+        static unsigned long dropped();
+
+        // Prefisso "AAAA/MM/GG hh:mm:ss ", rifatto una volta al secondo per thread
+        static size_t timestamp(char* out, size_t size);
+
+    private:
+        // Ring single-producer single-consumer: head avanza solo nel thread
+        // proprietario, tail solo nel flusher
+        struct Ring {
+            char* data;
+            size_t head;
+            size_t tail;
+            unsigned long dropped;
+            time_t stampSecond;
+            char stamp[32];
+            size_t stampLength;
+        };
+
+        static LogLevel _level;
+        static int _fd;
+        static std::string _path;
+        static bool _reopenRequested;
+        static bool _running;
+        static bool _stopping;
+        static pthread_t _thread;
+        static pthread_mutex_t _mutex;          // registro dei ring e attesa del flusher
+        static pthread_cond_t _cond;
+        static pthread_key_t _key;
+        static pthread_once_t _once;
+        static std::vector<Ring*> _rings;
+
+        static void _initKey();
+        static Ring* _ring();
+        static void* _flusherMain(void* arg);
+        static bool _drain();
+        static void _reopenFile();
+        static void _writeAll(const char* data, size_t len);
+};
+
+// Riga in costruzione su un buffer dello stack: niente allocazioni,
+// il distruttore la consegna al ring
+class LogLine {
+    public:
+        explicit LogLine(LogLevel level);
+        ~LogLine();
+
+        LogLine& operator<<(const char* s);
+        LogLine& operator<<(const std::string& s);
+        LogLine& operator<<(char c);
+        LogLine& operator<<(int n);
+        LogLine& operator<<(long n);
+        LogLine& operator<<(unsigned int n);
+        LogLine& operator<<(unsigned long n);
+
+    private:
+        char _buffer[LOG_LINE_MAX];
+        size_t _length;
+
+        void _append(const char* s, size_t len);
+
+        // Non copiabile
+        LogLine(const LogLine&);
+        LogLine& operator=(const LogLine&);
+};
+
+#endif
@@ -0,0 +1,51 @@
+// ********** MIME_TABLE_HPP **********
+// Tabella estensione -> Content-Type con hash perfetto costruito al caricamento
+
+#ifndef MIME_TABLE_HPP
+#define MIME_TABLE_HPP
+
+#include <string>
+#include <vector>
+
+// Estensione più lunga considerata: oltre, il tipo è quello di default
+#define MIME_MAX_EXTENSION 16
+
+class MimeTable {
+    public:
+        // Tabella con i tipi predefiniti (usata se la config non ha "types")
+        MimeTable();
+
+        // Svuota la tabella: un blocco types sostituisce i predefiniti
+        void clear();
+
+        // Associa un'estensione (senza punto, maiuscole ignorate) a un tipo;
+        // a parità di estensione vince l'ultima
+        void add(const std::string& extension, const std::string& type);
+
+        // Tipo per le estensioni sconosciute (default_type)
+        void setDefault(const std::string& type);
+
+        // Costruisce l'hash perfetto; da chiamare dopo l'ultima add()
+        void build();
+
+        // Content-Type del file in O(1): un hash e un confronto
+        const std::string& lookup(const char* path, size_t len) const;
+        const std::string& lookup(const std::string& path) const;
+
+        size_t size() const;
+
+    private:
+        struct Entry {
+            std::string extension;
+            std::string type;
+        };
+
+        std::vector<Entry> _entries;        // in ordine di inserimento
+        std::vector<long> _slots;           // indice in _entries, -1 = vuoto
+        std::vector<unsigned int> _seeds;   // seed per bucket (hash and displace)
+        std::string _default;
+
+        static unsigned int _hash(const char* key, size_t len, unsigned int seed);
+};
+
+#endif
@@ -0,0 +1,47 @@
+// ********** REDIRECT_HPP **********
+// Direttiva return: status line e header serializzati al caricamento,
+// a runtime si copiano i pezzi fissi e le variabili ($request_uri, $host)
+
+#ifndef REDIRECT_HPP
+#define REDIRECT_HPP
+
+#include <string>
+#include <vector>
+
+class Redirect {
+    public:
+        Redirect();
+
+        // return <code> <url>, return <url> (302) o return <code> (4xx/5xx,
+        // servito con le error_page); false con messaggio in error se non valida
+        bool compile(int code, const std::string& target, std::string& error);
+
+        // 0 se la location non ha return
+        int code() const;
+
+        // true se la risposta ha un Location (3xx), altrimenti è un errore
+        bool isRedirect() const;
+
+        // Risposta completa: senza variabili è il buffer già pronto,
+        // altrimenti viene composta in out
+        const std::string& render(const std::string& requestUri, const std::string& host,
+            std::string& out) const;
+
+        static bool isRedirectCode(int code);
+
+    private:
+        enum PartType { PART_TEXT, PART_REQUEST_URI, PART_HOST };
+
+        struct Part {
+            PartType type;
+            std::string text;       // PART_TEXT
+        };
+
+        int _code;
+        std::string _head;          // status line e header fino a "Location: "
+        std::string _tail;          // fine dell'header Location e resto della risposta
+        std::vector<Part> _parts;   // valore di Location
+        size_t _fixedLength;        // byte costanti, per la reserve
+};
+
+#endif
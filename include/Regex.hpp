@@ -0,0 +1,106 @@
+// ********** REGEX_HPP **********
+// Motore regex per le location ~ e ~*: DFA lazy, backtracking solo
+// per i pattern con backreference
+
+#ifndef REGEX_HPP
+#define REGEX_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <bitset>
+
+class Regex {
+    public:
+        Regex();
+
+        // Compila il pattern; false con messaggio in error se non valido
+        bool compile(const std::string& pattern, bool caseInsensitive, std::string& error);
+
+        // true se il pattern trova un match in qualsiasi punto del testo
+        bool search(const char* text, size_t len) const;
+        bool search(const std::string& text) const;
+
+        const std::string& pattern() const;
+        bool empty() const;
+
+        // false se il pattern usa backreference (matching con backtracking)
+        bool usesDfa() const;
+
+    private:
+        enum Op { OP_CLASS, OP_SPLIT, OP_JMP, OP_SAVE, OP_BOL, OP_EOL, OP_BACKREF, OP_MATCH };
+
+        struct Inst {
+            Op op;
+            int x;      // OP_CLASS: classe, OP_SPLIT/JMP: target, OP_SAVE: slot, OP_BACKREF: gruppo
+            int y;      // OP_SPLIT: secondo target
+        };
+
+        enum NodeType { N_EMPTY, N_CLASS, N_CONCAT, N_ALT, N_REPEAT, N_GROUP, N_BOL, N_EOL, N_BACKREF };
+
+        struct Node {
+            NodeType type;
+            int value;              // classe, gruppo o backreference
+            int min;                // N_REPEAT
+            int max;                // N_REPEAT, -1 = infinito
+            std::vector<int> kids;
+        };
+
+        struct DfaState {
+            std::vector<int> pcs;   // istruzioni NFA (solo CLASS, EOL, MATCH)
+            bool accept;            // contiene MATCH
+            bool acceptAtEnd;       // MATCH raggiungibile seguendo $ a fine testo
+            int next[256];          // -1 = transizione non ancora calcolata
+        };
+
+        struct BacktrackFrame {
+            int pc;                 // >= 0 ramo da provare, -1 ripristino cattura
+            size_t pos;
+            int slot;
+            long old;
+        };
+
+        std::string _pattern;
+        bool _icase;
+        bool _hasBackrefs;
+        int _groups;
+        std::vector< std::bitset<256> > _classes;
+        std::vector<Inst> _prog;
+
+        // Stato del parser (solo durante compile)
+        std::vector<Node> _nodes;
+        size_t _pos;
+        std::string _error;
+
+        // Cache del DFA, riempita durante i match
+        mutable std::vector<DfaState> _states;
+        mutable std::map<std::vector<int>, int> _stateIndex;
+        mutable int _startState;
+
+        // Parser -> AST
+        int _parseAlt();
+        int _parseSeq();
+        int _parseAtom();
+        int _parseClass();
+        bool _parseBraces(int& min, int& max);
+        int _escapeClass(char c, bool& isClass);
+        int _newNode(NodeType type, int value);
+        int _addClass(const std::bitset<256>& set);
+
+        // AST -> programma
+        void _emit(int node);
+        int _push(Op op, int x, int y);
+
+        // DFA lazy
+        void _closure(const std::vector<int>& seeds, bool atStart, bool followEol,
+            std::vector<int>& out) const;
+        int _intern(const std::vector<int>& pcs) const;
+        int _step(int state, unsigned char c) const;
+        bool _dfaSearch(const char* text, size_t len) const;
+
+        // Backtracking (pattern con backreference); budget condiviso tra
+        // le posizioni di partenza, a zero la ricerca si ferma
+        bool _backtrackAt(const char* text, size_t len, size_t start, size_t& budget) const;
+};
+
+#endif
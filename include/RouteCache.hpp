@@ -0,0 +1,75 @@
+// ********** ROUTE_CACHE_HPP **********
+// Cache LRU limitata: (listener, host, URI) -> target risolto su disco
+
+#ifndef ROUTE_CACHE_HPP
+#define ROUTE_CACHE_HPP
+
+#include <string>
+#include <list>
+#include <map>
+#include <stdint.h>
+#include <sys/types.h>
+#include "ConfigParser.hpp"
+
+// Risultato del routing di una GET/HEAD: vhost, location e file finale
+struct Route {
+    enum Kind { FILE, AUTOINDEX, FORBIDDEN };
+
+    Route();
+
+    const ServerConfig* server;
+    const LocationConfig* location;     // NULL = non risolta
+    Kind kind;
+    std::string filePath;               // file (index già risolto) o directory
+    std::string contentType;
+
+    // Validatore: la entry vale finché lo stat del target non cambia
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    time_t ctime;
+};
+
+class RouteCache {
+    public:
+        RouteCache();
+
+        // 0 disattiva la cache
+        void setCapacity(size_t capacity);
+
+        // Invalida tutto (config ricaricata: i puntatori non valgono più)
+        void clear();
+
+        // Copia la route in out se presente e ancora valida su disco
+        bool lookup(int listenFd, const std::string& host, const std::string& uri, Route& out);
+
+        // Registra una route risolta (stat del target incluso)
+        void store(int listenFd, const std::string& host, const std::string& uri, const Route& route);
+
+        // Riempie il validatore con lo stat del target, false se non esiste
+        static bool stamp(Route& route);
+
+    private:
+        // La chiave è salvata per esteso: l'hash sceglie la entry, i campi
+        // la confermano. Host già in minuscolo
+        struct Entry {
+            int listenFd;
+            std::string host;
+            std::string uri;
+            Route route;
+        };
+        typedef std::list<Entry> LruList;
+
+        LruList _lru;                                       // più recente in testa
+        std::map<uint64_t, LruList::iterator> _index;       // hash -> entry
+        size_t _capacity;
+
+        // FNV-1a di (listener, host in minuscolo, URI): nessuna stringa
+        // temporanea, il lookup non alloca. Due chiavi con lo stesso hash
+        // si sostituiscono a vicenda, come una entry evicted
+        static uint64_t _hash(int listenFd, const std::string& host, const std::string& uri);
+        static bool _matches(const Entry& entry, int listenFd, const std::string& host, const std::string& uri);
+};
+
+#endif
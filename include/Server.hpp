@@ -2,48 +2,116 @@
 #define SERVER_HPP
 
 #include <vector>
+#include <map>
 #include "ServerInstance.hpp"
-#include <sys/select.h>
+#include <poll.h>
+#include <csignal>
 #include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
 #include "ConfigParser.hpp"
+#include "Client.hpp"
+#include "UploadWriter.hpp"
+#include "UploadStore.hpp"
+#include "VhostTable.hpp"
+#include "RouteCache.hpp"
+#include "AccessLog.hpp"
+#include "Capture.hpp"
+#include "BufferPool.hpp"
+#include "Stats.hpp"
 
 class Server {
 public:
     Server();
     ~Server();
 
-    void addInstance(ServerInstance* instance, const ServerConfig& config);
+    void addInstance(ServerInstance* instance, size_t serverIndex, bool isDefault);
     void setServers(const std::vector<ServerConfig>& servers);
+    void setGlobalConfig(const GlobalConfig& global);
     void run();
 
+    // Compila il formato e apre access_log (nulla se è off)
+    bool openAccessLog(std::string& error);
+
+    // Apre il file di capture (nulla se è off)
+    bool openCapture(std::string& error);
+
+    // SIGINT/SIGTERM: il loop termina dopo la poll e i log vengono svuotati
+    static void handleStopSignal(int signum);
+
+    // SIGUSR1: riapre access_log ed error_log dopo una rotazione
+    static void handleReopenSignal(int signum);
+
+    // SIGUSR2: istogrammi di latenza per fase nell'error_log
+    static void handleDumpSignal(int signum);
+
 private:
+    friend struct MicrobenchAccess;     // bench/microbench.cpp misura i metodi privati
+
+    static volatile sig_atomic_t _stopRequested;
+    static volatile sig_atomic_t _reopenRequested;
+    static volatile sig_atomic_t _dumpRequested;
+
     std::vector<ServerInstance*> _instances;
     std::vector<ServerConfig> _servers;
-    fd_set _master_set;
-    fd_set _working_set;
-    int _max_fd;
+    std::map<int, Client> _clients;
+    VhostTable _vhosts;
+    RouteCache _routes;     // GET/HEAD già risolte, revalidate con stat
+    GlobalConfig _global;
+    UploadWriter _uploadWriter;
+    UploadStore _uploadStore;
+    std::vector<struct pollfd> _pollfds;    // listener e client; fd -1 = chiuso in questo giro
+    std::vector<size_t> _pollSlot;          // fd -> indice in _pollfds
+    size_t _bodyMemory;     // byte di body in memoria, tutte le connessioni
+    AccessLog _accessLog;
+    Capture _capture;
+    BufferPool _buffers;    // recv e invio dei file, prestati per connessione
 
-    void _initializeSets();
+    void _initializePoll();
+    void _watch(int fd);
+    void _unwatch(int fd);
+    void _compactPoll();
     void _handleNewConnection(int listen_fd);
     void _handleClientData(int client_fd);
+    bool _processHeaders(int client_fd, Client& client);
+    bool _canonicalizePath(int client_fd, Client& client);
+    bool _handleExpect(int client_fd, const Client& client);
+    void _dispatchRequest(int client_fd, Client& client);
+    void _closeClient(int client_fd);
+    void _recordCapture(int client_fd, const Client& client);
+    void _reopenLogs();
+    bool _send(int client_fd, const char* data, size_t length, int status, size_t total = 0);
+    bool _sendMore(int client_fd, const char* data, size_t length);
+
+    // Buffering del body: in memoria fino a client_body_buffer_size, poi su
+    // file temporaneo; oltre il budget globale si smette di leggere
+    bool _storeBody(Client& client, const char* data, size_t len);
+    bool _spillBody(Client& client);
+    void _pauseBodyReaders();
+    void _spillLargestBody();
+    size_t _getBodyBufferSize(const LocationConfig* location) const;
     
+    // Routing: vhost e limiti sul body risolti prima di leggere il body
+    const ServerConfig* _findServer(const Client& client) const;
+    bool _checkBodyAllowed(int client_fd, const Client& client);
+
     // Nuovi metodi per rispondere
     const LocationConfig* _findLocationMatch(const std::string& uri, const ServerConfig& server) const;
     std::string _getFilePath(const std::string& uri, const LocationConfig* location);
-    void _handleGetRequest(int client_fd, const HttpRequest& request);
-    void _handleHeadRequest(int client_fd, const HttpRequest& request);
-    void _sendFile(int client_fd, const std::string& path);
-    void _sendAutoindex(int client_fd, const std::string& path, const std::string& uri);
-    void _sendNotFound(int client_fd, const std::string& uri);
-    void _sendForbidden(int client_fd, const std::string& uri);
-    void _sendError(int client_fd, int statusCode, const std::string& statusText, const std::string& message);
-    void _handlePostRequest(int client_fd, const HttpRequest& request);
+    int _resolveRoute(const Client& client, Route& route);
+    void _handleGetRequest(int client_fd, Client& client);
+    void _handleHeadRequest(int client_fd, Client& client);
+    void _sendFile(int client_fd, Client& client, const std::string& path, const std::string& contentType);
+    void _sendAutoindex(int client_fd, const Client& client, const std::string& path);
+    void _sendError(int client_fd, const Client& client, int statusCode, const std::string& reason);
+    void _sendReturn(int client_fd, const Client& client);
+    void _sendStatus(int client_fd, Client& client);
+    void _connectionMemory(ConnMemory& memory) const;
+    void _addCacheHeaders(HttpResponse& response, const Client& client) const;
+    void _handlePostRequest(int client_fd, Client& client);
     void _sendPostResponse(int client_fd, const HttpRequest& request);
-    void _handleDeleteRequest(int client_fd, const HttpRequest& request);
+    void _handleDeleteRequest(int client_fd, const Client& client);
     void _sendDeleteResponse(int client_fd, const HttpRequest& request, bool success, const std::string& message);
-    void _sendHeadResponse(int client_fd, int statusCode, const std::string& contentType, size_t contentLength);
-    void _sendHeadError(int client_fd, int statusCode, const std::string& statusText);
-    void _sendErrorResponse(int client_fd, int statusCode, const std::string& message);
+    void _sendHeadResponse(int client_fd, const Client& client, int statusCode, const std::string& contentType, size_t contentLength);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+// ********** STATS_HPP **********
+// Contatori del server in memoria condivisa: aggiornati con atomiche
+// relaxed senza lock, letti dalla location stub_status
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <string>
+#include "Histogram.hpp"
+
+// Status HTTP contati singolarmente: 100-599
+#define STATS_STATUS_MIN 100
+#define STATS_STATUS_MAX 599
+
+// Formato di stub_status
+enum StatusFormat {
+    STATUS_OFF,
+    STATUS_TEXT,
+    STATUS_PROMETHEUS
+};
+
+// Stato di una connessione per i contatori reading/writing/waiting
+enum ConnPhase {
+    CONN_WAITING,       // accettata, nessun byte ricevuto
+    CONN_READING,       // header o body in arrivo
+    CONN_WRITING        // risposta in invio
+};
+
+// Fasi di una richiesta con istogramma di latenza (µs)
+enum StatsPhase {
+    PHASE_WAIT,         // accept -> primo byte ricevuto
+    PHASE_PARSE,        // request line, header e path canonico
+    PHASE_ROUTE,        // vhost e location (o route in cache)
+    PHASE_FS,           // stat, index e lettura del file
+    PHASE_FIRST_BYTE,   // primo byte ricevuto -> primo byte inviato
+    PHASE_TOTAL,        // primo byte ricevuto -> chiusura
+    PHASE_COUNT
+};
+
+// Tutti i campi sono solo incrementati o decrementati con __atomic_*: la
+// pagina è MAP_SHARED, quindi processi creati con fork la condividono
+struct StatsCounters {
+    unsigned long accepted;
+    unsigned long handled;
+    unsigned long requests;
+    long active;
+    long reading;
+    long writing;
+    long waiting;
+    unsigned long bytesIn;
+    unsigned long bytesOut;
+    unsigned long routeHits;        // RouteCache: route trovata e valida
+    unsigned long routeMisses;      // RouteCache: assente (stale compresi)
+    unsigned long metaFresh;        // stat di revalidate: file invariato
+    unsigned long metaStale;        // stat di revalidate: file cambiato o sparito
+    unsigned long status[STATS_STATUS_MAX - STATS_STATUS_MIN + 1];
+    Histogram phases[PHASE_COUNT];
+};
+
+// Memoria delle connessioni aperte in questo processo, stimata a ogni
+// richiesta di stub_status percorrendo i client (non è nella pagina condivisa)
+struct ConnMemory {
+    unsigned long connections;
+    unsigned long client;       // Client, nodo di _clients e entry della poll
+    unsigned long buffers;      // buffer di ricezione prestati, body in memoria e capture
+    unsigned long request;      // request line, header, dati POST, route
+    unsigned long poolSlabs;    // slab del pool di buffer, prestati o liberi
+    unsigned long poolInUse;
+
+    ConnMemory() : connections(0), client(0), buffers(0), request(0), poolSlabs(0), poolInUse(0) {}
+};
+
+class Stats {
+    public:
+        // Mappa i contatori condivisi; da chiamare prima di creare worker.
+        // Se mmap fallisce restano i contatori locali al processo
+        static void init();
+
+        static void add(unsigned long& counter, unsigned long n) {
+            __atomic_fetch_add(&counter, n, __ATOMIC_RELAXED);
+        }
+
+        static StatsCounters& counters() { return *_counters; }
+
+        // Sposta la connessione da un gauge all'altro
+        static void transition(ConnPhase& phase, ConnPhase next);
+
+        // Nuova connessione (waiting) e chiusura (dal gauge corrente)
+        static void opened(ConnPhase& phase);
+        static void closed(ConnPhase phase);
+
+        // Risposta conclusa: richieste, status e byte inviati
+        static void response(int status, unsigned long bytesSent);
+
+        // Latenza di una fase in µs
+        static void record(StatsPhase phase, long usec) {
+            _counters->phases[phase].record(usec > 0 ? static_cast<unsigned long>(usec) : 0);
+        }
+
+        // SIGUSR2: percentili e bucket non vuoti di ogni fase nell'error_log
+        static void dumpHistograms();
+
+        // RSS del processo da /proc/self/statm, 0 se non disponibile
+        static unsigned long residentBytes();
+
+        // Corpo della risposta di stub_status
+        static void renderText(std::string& out, const ConnMemory& memory);
+        static void renderPrometheus(std::string& out, const ConnMemory& memory);
+
+    private:
+        static StatsCounters _local;
+        static StatsCounters* _counters;
+
+        static long* _gauge(ConnPhase phase);
+        static unsigned long _load(const unsigned long& counter);
+        static long _load(const long& gauge);
+        static const char* _phaseName(int phase);
+};
+
+#endif
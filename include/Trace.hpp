@@ -0,0 +1,50 @@
+// ********** TRACE_HPP **********
+// Tracepoint statiche USDT (provider "webserv") sul ciclo di vita di
+// connessioni e richieste. Il Makefile le attiva da solo se trova
+// sys/sdt.h: ogni punto è una nop con una nota ELF letta da perf/bpftrace.
+// Con make USDT=0 (o senza sys/sdt.h) le macro spariscono
+//
+//   bpftrace -e 'usdt:./webserv:webserv:response__complete { @[arg1] = count(); }'
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#ifdef WEBSERV_USDT
+# include <sys/sdt.h>
+
+// fd del client, fd del listener
+# define TRACE_ACCEPT(fd, listenFd) \
+    DTRACE_PROBE2(webserv, accept, fd, listenFd)
+// fd, metodo, URI ricevuta (char*)
+# define TRACE_REQUEST_PARSED(fd, method, uri) \
+    DTRACE_PROBE3(webserv, request__parsed, fd, method, uri)
+// fd, path canonico, path della location ("" se nessuna)
+# define TRACE_ROUTE_RESOLVED(fd, path, location) \
+    DTRACE_PROBE3(webserv, route__resolved, fd, path, location)
+// fd, file su disco, byte letti
+# define TRACE_FILE_OPENED(fd, path, size) \
+    DTRACE_PROBE3(webserv, file__opened, fd, path, size)
+// fd, status, byte dell'intera risposta (header + body)
+# define TRACE_RESPONSE_START(fd, status, length) \
+    DTRACE_PROBE3(webserv, response__start, fd, status, length)
+// fd, status, byte inviati in totale, dopo l'ultimo blocco (meno di
+// length se la risposta è stata troncata)
+# define TRACE_RESPONSE_COMPLETE(fd, status, sent) \
+    DTRACE_PROBE3(webserv, response__complete, fd, status, sent)
+// fd, byte ricevuti, byte inviati
+# define TRACE_CONNECTION_CLOSE(fd, received, sent) \
+    DTRACE_PROBE3(webserv, connection__close, fd, received, sent)
+
+#else
+
+# define TRACE_ACCEPT(fd, listenFd) ((void)0)
+# define TRACE_REQUEST_PARSED(fd, method, uri) ((void)0)
+# define TRACE_ROUTE_RESOLVED(fd, path, location) ((void)0)
+# define TRACE_FILE_OPENED(fd, path, size) ((void)0)
+# define TRACE_RESPONSE_START(fd, status, length) ((void)0)
+# define TRACE_RESPONSE_COMPLETE(fd, status, sent) ((void)0)
+# define TRACE_CONNECTION_CLOSE(fd, received, sent) ((void)0)
+
+#endif
+
+#endif
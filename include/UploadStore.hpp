@@ -0,0 +1,43 @@
+// ********** UPLOAD_STORE_HPP **********
+// Sceglie dove salvare ogni upload: radice, sottodirectory e nome file
+
+#ifndef UPLOAD_STORE_HPP
+#define UPLOAD_STORE_HPP
+
+#include <string>
+#include "ConfigParser.hpp"
+
+class UploadWriter;
+
+// Radice usata dalle location senza upload_store
+#define UPLOAD_DEFAULT_DIR "./uploads/"
+
+class UploadStore {
+    public:
+        UploadStore();
+
+        // Writer in background (NULL = scrittura sincrona)
+        void setWriter(UploadWriter* writer);
+
+        // Salva il contenuto (preso con swap) e ritorna il path, "" in caso di errore
+        std::string save(const LocationConfig* location,
+            const std::string& filename, std::string& content);
+
+        // Come save, ma copia length byte da srcFd (body spillato su disco)
+        std::string saveRange(const LocationConfig* location,
+            const std::string& filename, int srcFd, size_t offset, size_t length);
+
+        // Tiene solo il nome base, senza separatori né componenti speciali
+        static std::string sanitizeFilename(const std::string& filename);
+
+    private:
+        UploadWriter* _writer;
+        unsigned long _counter;
+        std::string _instanceId;
+
+        std::string _nextId();
+        std::string _destination(const LocationConfig* location, const std::string& filename);
+        static std::string _shardPath(const std::string& id, size_t levels);
+};
+
+#endif
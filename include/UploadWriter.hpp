@@ -0,0 +1,70 @@
+// ********** UPLOAD_WRITER_HPP **********
+// Scrittura degli upload su disco fuori dall'event loop
+
+#ifndef UPLOAD_WRITER_HPP
+#define UPLOAD_WRITER_HPP
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+class UploadWriter {
+    public:
+        // Garanzia di persistenza dei file scritti
+        enum Durability {
+            DURABILITY_NONE = 0,   // nessuna fdatasync, decide il kernel
+            DURABILITY_BATCH = 1,  // fdatasync raggruppate ogni N file
+            DURABILITY_SYNC = 2    // fdatasync dopo ogni file
+        };
+
+        UploadWriter();
+        ~UploadWriter();
+
+        // Avvia il pool di thread (0 thread = scrittura sincrona)
+        void start(size_t threads, Durability durability, size_t syncBatch);
+
+        // Svuota la coda e termina i thread
+        void stop();
+
+        // Accoda la scrittura: il contenuto viene preso con swap, senza copie
+        void submit(const std::string& path, std::string& content);
+
+        // Accoda la copia di length byte da srcFd (duplicato, resta valido
+        // anche dopo la chiusura dell'originale)
+        void submitRange(const std::string& path, int srcFd, size_t offset, size_t length);
+
+        // Copia sincrona di un intervallo di srcFd in un nuovo file
+        static bool copyRange(const std::string& path, int srcFd, size_t offset, size_t length);
+
+    private:
+        struct Job {
+            std::string path;
+            std::string content;
+            int srcFd;          // sorgente su file (-1 = usa content)
+            size_t srcOffset;
+            size_t srcLength;
+        };
+
+        std::deque<Job*> _queue;
+        std::vector<pthread_t> _threads;
+        pthread_mutex_t _mutex;
+        pthread_cond_t _cond;
+        bool _stopping;
+        Durability _durability;
+        size_t _syncBatch;
+
+        static void* _workerMain(void* arg);
+        void _run();
+        static int _writeJob(const Job& job);
+        void _syncPending(std::vector<int>& pending);
+        void _enqueue(Job* job);
+        static int _openTarget(const std::string& path);
+        static bool _writeAll(int fd, const char* data, size_t len);
+
+        // Non copiabile
+        UploadWriter(const UploadWriter&);
+        UploadWriter& operator=(const UploadWriter&);
+};
+
+#endif
@@ -0,0 +1,48 @@
+// ********** VHOST_TABLE_HPP **********
+// Indice dei virtual host per (socket di ascolto, host)
+
+#ifndef VHOST_TABLE_HPP
+#define VHOST_TABLE_HPP
+
+#include <string>
+#include <vector>
+
+class VhostTable {
+    public:
+        VhostTable();
+
+        void clear();
+
+        // Registra un server_name sul listener; a parità di nome vince il primo
+        void addName(int listenFd, const std::string& name, size_t serverIndex);
+
+        // Server di default del listener: il primo registrato, salvo force
+        void setDefault(int listenFd, size_t serverIndex, bool force);
+
+        // Indice del server per l'header Host (porta e maiuscole ignorate),
+        // il default del listener se il nome è sconosciuto, -1 se non c'è
+        long find(int listenFd, const std::string& hostHeader) const;
+
+        // Lunghezza della parte host dell'header: senza porta e punto finale
+        static size_t hostLength(const std::string& hostHeader);
+
+    private:
+        struct Entry {
+            std::string host;   // minuscolo, senza porta
+            size_t hash;
+            int listenFd;
+            long server;        // -1 = slot libero
+        };
+
+        std::vector<Entry> _slots;      // open addressing, potenza di 2
+        size_t _count;
+        std::vector<long> _defaults;    // indicizzato per fd di ascolto
+
+        long _lookup(int listenFd, const char* host, size_t len) const;
+        static size_t _hash(int listenFd, const char* host, size_t len);
+        static bool _equals(const std::string& stored, const char* host, size_t len);
+        void _insert(const Entry& entry);
+        void _grow();
+};
+
+#endif
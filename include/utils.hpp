@@ -4,6 +4,9 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <ctime>
+#include <sys/time.h>
+#include <sys/types.h>
 
 // Funzioni esistenti
 template <typename T>
@@ -18,8 +21,35 @@ bool fileExists(const std::string& path);
 bool isDirectory(const std::string& path);
 bool isReadable(const std::string& path);
 std::string readFile(const std::string& path);
+ssize_t readFull(int fd, char* data, size_t length);   // meno di length solo a fine file
+size_t longestLine(const char* data, size_t len);      // \n escluso, ultima riga anche se incompleta
 std::string joinPaths(const std::string& base, const std::string& rel);
 std::string normalizePath(const std::string& path);
 std::vector<std::string> listDirectory(const std::string& path);
+bool ensureDirectory(const std::string& path);
+std::string httpDate(time_t t);     // "Sun, 06 Nov 1994 08:49:37 GMT"
+long elapsedUsec(const struct timeval& from, const struct timeval& to);
+long usecSince(const struct timeval& from);     // fino ad adesso
+
+// Stima della memoria per connessione: byte sullo heap di una stringa (0
+// se sta nel buffer interno) e di un nodo di std::map oltre al valore
+size_t stringHeapBytes(const std::string& s);
+#define MAP_NODE_OVERHEAD (4 * sizeof(void*))
+
+// Lunghezza massima di un path canonico (buffer sullo stack)
+#define CANONICAL_PATH_MAX 4096
+
+// Esito di canonicalizePath
+enum PathStatus {
+    PATH_OK,            // già canonico
+    PATH_REWRITTEN,     // conteneva '.', '..' o '//', ora risolti
+    PATH_INVALID,       // non inizia con '/', %XX non valido, NUL o troppo lungo
+    PATH_ESCAPES_ROOT   // '..' oltre la radice
+};
+
+// Canonicalizza un path assoluto in un solo passaggio lineare, senza
+// allocazioni: decodifica %XX e risolve '.', '..' e '//'. out deve avere
+// almeno outSize byte; outLen riceve la lunghezza (senza terminatore)
+PathStatus canonicalizePath(const char* path, size_t len, char* out, size_t outSize, size_t& outLen);
 
 #endif
\ No newline at end of file
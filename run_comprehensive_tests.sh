@@ -296,6 +296,21 @@ run_test "Upload location with autoindex" \
     "<h1>Index of /uploads/</h1>" \
     "content"
 
+run_test "Alias location serves its index (/upload -> www/)" \
+    "curl -s http://localhost:8080/upload" \
+    "<title>🚀 WebServ - HTTP/1.1 Server</title>" \
+    "content"
+
+run_test "Alias location maps the rest of the path" \
+    "curl -s http://localhost:8080/upload/about.html" \
+    "<h1>About Page</h1>" \
+    "content"
+
+run_test "Alias does not match a longer segment" \
+    "http://localhost:8080/upload../index.html" \
+    "404" \
+    "status"
+
 # ==========================================
 # 11. CONTENT-TYPE DETECTION
 # ==========================================
@@ -82,6 +82,12 @@ run_test "DELETE with absolute path" "403 Forbidden" "curl -s -i -X DELETE 'http
 # Test 8: DELETE with null byte injection
 run_test "DELETE with null byte" "400 Bad Request" "curl -s -i -X DELETE 'http://localhost:8080/delete/test%00.txt' | head -1"
 
+# Test 8b: GET on the DELETE-only location (limit_except DELETE)
+echo "DELETE only" > www/delete/get_test.txt
+run_test "GET on DELETE-only location" "405 Method Not Allowed" "curl -s -i http://localhost:8080/delete/get_test.txt | head -1"
+run_test "HEAD on DELETE-only location" "405 Method Not Allowed" "curl -s -I http://localhost:8080/delete/get_test.txt | head -1"
+rm -f www/delete/get_test.txt
+
 echo -e "${BLUE}📋 3. HTTP COMPLIANCE${NC}"
 echo "----------------------------------------"
 
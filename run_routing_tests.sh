@@ -0,0 +1,163 @@
+#!/bin/bash
+
+echo "🧭 WEBSERV ROUTING TESTS"
+echo "========================"
+echo "Location precedence, regex, virtual hosts, return, limit_except, Expect, encoded paths"
+echo ""
+
+# Colors
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m'
+
+DIR=/tmp/webserv-routing
+PORT=8091
+URL=http://127.0.0.1:$PORT
+# Senza Host noto risponde il default_server: le location sono su routing.test
+HOST="-H 'Host: routing.test'"
+
+PASS_COUNT=0
+TOTAL_COUNT=0
+
+# Function to run test
+run_test() {
+    local test_name="$1"
+    local expected="$2"
+    local command="$3"
+
+    echo -e "${BLUE}🧪 Test: $test_name${NC}"
+    TOTAL_COUNT=$((TOTAL_COUNT + 1))
+
+    # Execute test
+    RESULT=$(eval "$command" 2>/dev/null)
+
+    if [ "$RESULT" = "$expected" ]; then
+        echo -e "${GREEN}✅ PASS${NC}"
+        PASS_COUNT=$((PASS_COUNT + 1))
+    else
+        echo -e "${RED}❌ FAIL${NC}"
+        echo "Expected: $expected"
+        echo "Got: $RESULT"
+    fi
+    echo ""
+}
+
+cd "$(dirname "$0")" || exit 1
+
+echo -e "${BLUE}📁 Preparing test files in $DIR...${NC}"
+# Ogni root ha file con il proprio nome: il body dice quale location ha risposto
+rm -rf "$DIR"
+for root in main exact static png jpg backref fallback other; do
+    mkdir -p "$DIR/$root/img" "$DIR/$root/static" "$DIR/$root/deleteonly" "$DIR/$root/getonly"
+    for file in index.html exact.png img/a.png img/b.txt static/a.png photo.jpg photo.JPG photo.PNG \
+        deleteonly/x.txt getonly/x.txt; do
+        echo "$root" > "$DIR/$root/$file"
+    done
+done
+# %3F e %23 decodificati fanno parte del nome del file, non di query o fragment
+printf 'a\n' > "$DIR/main/a"
+printf 'a?b\n' > "$DIR/main/a?b"
+printf 'a#b\n' > "$DIR/main/a#b"
+echo backref > "$DIR/backref/aba"
+echo ""
+
+./webserv conf/routing.conf &
+PID=$!
+trap 'kill $PID 2>/dev/null; wait $PID 2>/dev/null' EXIT
+for i in $(seq 1 50); do
+    (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null && break
+    sleep 0.1
+done
+if ! kill -0 $PID 2>/dev/null; then
+    echo -e "${RED}❌ Server did not start with conf/routing.conf${NC}"
+    exit 1
+fi
+
+echo -e "${BLUE}📍 1. LOCATION PRECEDENCE${NC}"
+echo "----------------------------------------"
+
+run_test "= beats ^~, prefix and regex" "exact" "curl -s $HOST $URL/exact.png"
+run_test "^~ prefix skips regex" "static" "curl -s $HOST $URL/static/a.png"
+run_test "~ regex beats plain prefix" "png" "curl -s $HOST $URL/img/a.png"
+run_test "Plain prefix when no regex matches" "main" "curl -s $HOST $URL/img/b.txt"
+run_test "~ is case-sensitive" "main" "curl -s $HOST $URL/photo.PNG"
+run_test "~* matches lowercase" "jpg" "curl -s $HOST $URL/photo.jpg"
+run_test "~* matches uppercase" "jpg" "curl -s $HOST $URL/photo.JPG"
+
+run_test "~ with backreference matches" "backref" "curl -s $HOST $URL/aba"
+# (a|a)*b\1 su 1500 'a': senza budget unico il poll loop resta bloccato per decine di secondi
+LONG=$(head -c 1500 /dev/zero | tr '\0' a)
+run_test "Pathological backreference on a long URI: no match" "404" \
+    "curl -s $HOST --max-time 2 -o /dev/null -w '%{http_code}' $URL/$LONG"
+run_test "Server still responsive during pathological regex" "main" \
+    "curl -s $HOST --max-time 5 $URL/$LONG$LONG$LONG$LONG >/dev/null & curl -s $HOST --max-time 2 $URL/index.html; wait"
+
+echo -e "${BLUE}🌐 2. VIRTUAL HOSTS${NC}"
+echo "----------------------------------------"
+
+run_test "server_name match" "main" "curl -s -H 'Host: routing.test' $URL/"
+run_test "server_name is case-insensitive" "main" "curl -s -H 'Host: ROUTING.test:$PORT' $URL/"
+run_test "Second named server" "other" "curl -s -H 'Host: other.test' $URL/"
+run_test "Unknown Host falls back to default_server" "fallback" "curl -s -H 'Host: unknown.test' $URL/"
+
+echo -e "${BLUE}↪️  3. RETURN${NC}"
+echo "----------------------------------------"
+
+run_test "return 301 status" "301" "curl -s $HOST -o /dev/null -w '%{http_code}' '$URL/old/page?x=1'"
+run_test "return expands \$request_uri" "Location: https://new.example/old/page?x=1" \
+    "curl -s $HOST -i '$URL/old/page?x=1' | grep -i '^Location:' | tr -d '\r'"
+
+echo -e "${BLUE}🚫 4. LIMIT_EXCEPT${NC}"
+echo "----------------------------------------"
+
+# Il file esiste: senza il controllo del metodo verrebbe servito
+run_test "GET on a DELETE-only location: 405" "405" \
+    "curl -s $HOST -o /dev/null -w '%{http_code}' $URL/deleteonly/x.txt"
+run_test "HEAD on a DELETE-only location: 405" "405" \
+    "curl -s $HOST -I -o /dev/null -w '%{http_code}' $URL/deleteonly/x.txt"
+run_test "GET on a DELETE-only location, repeated: 405" "405" \
+    "curl -s $HOST -o /dev/null -w '%{http_code}' $URL/deleteonly/x.txt"
+run_test "GET on a POST-only location: 405" "405" \
+    "curl -s $HOST -o /dev/null -w '%{http_code}' $URL/small"
+run_test "limit_except GET also allows HEAD" "200" \
+    "curl -s $HOST -I -o /dev/null -w '%{http_code}' $URL/getonly/x.txt"
+run_test "limit_except GET rejects POST" "405" \
+    "curl -s $HOST -o /dev/null -w '%{http_code}' -d 'a=1' $URL/getonly/x.txt"
+
+echo -e "${BLUE}📨 5. EXPECT: 100-CONTINUE${NC}"
+echo "----------------------------------------"
+
+BIG=$(head -c 64 /dev/zero | tr '\0' 'x')
+run_test "Body over the limit: 413" "413" \
+    "curl -s $HOST -o /dev/null -w '%{http_code}' -H 'Expect: 100-continue' -d 'a=$BIG' $URL/small"
+run_test "Body over the limit: no 100 Continue" "0" \
+    "curl -s $HOST -i -H 'Expect: 100-continue' -d 'a=$BIG' $URL/small | grep -c '100 Continue'"
+run_test "Body within the limit: 100 Continue first" "HTTP/1.1 100 Continue" \
+    "curl -s $HOST -i -H 'Expect: 100-continue' -d 'a=1' $URL/small | head -1 | tr -d '\r'"
+run_test "Unsupported Expect value: 417" "417" \
+    "curl -s $HOST -o /dev/null -w '%{http_code}' -H 'Expect: something' -d 'a=1' $URL/small"
+
+echo -e "${BLUE}🔣 6. ENCODED PATHS${NC}"
+echo "----------------------------------------"
+
+run_test "%3F is part of the path" "a?b" "curl -s $HOST '$URL/a%3Fb'"
+run_test "%23 is part of the path" "a#b" "curl -s $HOST '$URL/a%23b'"
+run_test "Raw ? still starts the query" "a" "curl -s $HOST '$URL/a?b'"
+run_test "%3F path with a query" "a?b" "curl -s $HOST '$URL/a%3Fb?x=1'"
+run_test "\$request_uri keeps %3F encoded" "Location: https://new.example/old/a%3Fb?x=1" \
+    "curl -s $HOST -i '$URL/old/a%3Fb?x=1' | grep -i '^Location:' | tr -d '\r'"
+
+echo "==============================="
+echo -e "${BLUE}📊 ROUTING TEST RESULTS${NC}"
+echo "==============================="
+echo -e "Passed: ${GREEN}$PASS_COUNT${NC}/$TOTAL_COUNT"
+
+if [ $PASS_COUNT -eq $TOTAL_COUNT ]; then
+    echo -e "${GREEN}🎉 All routing tests passed!${NC}"
+    exit 0
+else
+    echo -e "${RED}⚠️  Some routing tests failed${NC}"
+    exit 1
+fi
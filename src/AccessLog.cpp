@@ -0,0 +1,299 @@
+// ********** ACCESS_LOG **********
+// Il formato è diviso una volta in pezzi fissi e variabili; ogni riga viene
+// composta direttamente nel buffer, senza stringhe intermedie
+
+#include "AccessLog.hpp"
+#include "VhostTable.hpp"
+#include "Logger.hpp"
+#include "utils.hpp"
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+AccessLog::AccessLog() : _fd(-1), _timeSecond(0) {
+    _firstPending.tv_sec = 0;
+    _firstPending.tv_usec = 0;
+}
+
+AccessLog::~AccessLog() {
+    flush();
+    if (_fd >= 0)
+        close(_fd);
+}
+
+bool AccessLog::compile(const std::string& format, std::string& error) {
+    static const struct {
+        const char* name;
+        PartType type;
+    } variables[] = {
+        { "remote_addr", PART_REMOTE_ADDR },
+        { "host", PART_HOST },
+        { "server_name", PART_SERVER_NAME },
+        { "request", PART_REQUEST },
+        { "request_method", PART_REQUEST_METHOD },
+        { "request_uri", PART_REQUEST_URI },
+        { "uri", PART_URI },
+        { "status", PART_STATUS },
+        { "bytes_sent", PART_BYTES_SENT },
+        { "request_time", PART_REQUEST_TIME },
+        { "file_time", PART_FILE_TIME },
+        { "time_local", PART_TIME_LOCAL },
+        { "http_referer", PART_HTTP_REFERER },
+        { "http_user_agent", PART_HTTP_USER_AGENT }
+    };
+
+    _parts.clear();
+    std::string text;
+    size_t i = 0;
+    while (i < format.size()) {
+        if (format[i] != '$') {
+            text += format[i++];
+            continue;
+        }
+        size_t start = i + 1;
+        bool braces = (start < format.size() && format[start] == '{');
+        if (braces)
+            ++start;
+        size_t end = start;
+        while (end < format.size() && (std::isalnum(static_cast<unsigned char>(format[end])) || format[end] == '_'))
+            ++end;
+        std::string name = format.substr(start, end - start);
+        if (braces) {
+            if (end >= format.size() || format[end] != '}') {
+                error = "unterminated variable in log_format";
+                return false;
+            }
+            ++end;
+        }
+
+        Part part;
+        size_t v = 0;
+        while (v < sizeof(variables) / sizeof(variables[0]) && name != variables[v].name)
+            ++v;
+        if (v == sizeof(variables) / sizeof(variables[0])) {
+            error = "unknown variable \"$" + name + "\" in log_format";
+            return false;
+        }
+        part.type = variables[v].type;
+        if (!text.empty()) {
+            Part literal;
+            literal.type = PART_TEXT;
+            literal.text = text;
+            _parts.push_back(literal);
+            text.clear();
+        }
+        _parts.push_back(part);
+        i = end;
+    }
+    text += '\n';
+    Part literal;
+    literal.type = PART_TEXT;
+    literal.text = text;
+    _parts.push_back(literal);
+    return true;
+}
+
+bool AccessLog::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "cannot open access_log " + path + ": " + strerror(errno);
+        return false;
+    }
+    flush();
+    if (_fd >= 0)
+        close(_fd);
+    _fd = fd;
+    _path = path;
+    _buffer.reserve(ACCESS_LOG_BUFFER);
+    return true;
+}
+
+bool AccessLog::enabled() const {
+    return _fd >= 0;
+}
+
+bool AccessLog::reopen(std::string& error) {
+    if (_fd < 0)
+        return true;
+    // Le righe già in buffer vanno ancora nel file ruotato
+    flush();
+    return open(_path, error);
+}
+
+void AccessLog::write(const Client& client) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    if (_buffer.empty())
+        _firstPending = now;
+
+    const HttpRequest& request = client.request;
+    for (size_t i = 0; i < _parts.size(); ++i) {
+        const Part& part = _parts[i];
+        switch (part.type) {
+            case PART_TEXT:
+                _buffer += part.text;
+                break;
+            case PART_REMOTE_ADDR: {
+                char addr[INET_ADDRSTRLEN];
+                if (inet_ntop(AF_INET, &client.address.sin_addr, addr, sizeof(addr)))
+                    _buffer += addr;
+                else
+                    _buffer += '-';
+                break;
+            }
+            case PART_HOST: {
+                // Header Host senza porta, in minuscolo, altrimenti server_name
+                std::string host = request.getHeader("host");
+                host.resize(VhostTable::hostLength(host));
+                for (size_t c = 0; c < host.size(); ++c)
+                    host[c] = static_cast<char>(std::tolower(static_cast<unsigned char>(host[c])));
+                if (host.empty() && client.server)
+                    host = client.server->server_name;
+                if (host.empty())
+                    _buffer += '-';
+                else
+                    _appendEscaped(host);
+                break;
+            }
+            case PART_SERVER_NAME:
+                if (client.server && !client.server->server_name.empty())
+                    _appendEscaped(client.server->server_name);
+                else
+                    _buffer += '-';
+                break;
+            case PART_REQUEST:
+                // Richiesta illeggibile: request line vuota come in nginx
+                if (!request.getMethod().empty()) {
+                    _appendEscaped(request.getMethod());
+                    _buffer += ' ';
+                    _appendEscaped(request.getUri());
+                    _buffer += ' ';
+                    _appendEscaped(request.getVersion());
+                }
+                break;
+            case PART_REQUEST_METHOD:
+                if (request.getMethod().empty())
+                    _buffer += '-';
+                else
+                    _appendEscaped(request.getMethod());
+                break;
+            case PART_REQUEST_URI:
+                if (request.getUri().empty())
+                    _buffer += '-';
+                else
+                    _appendEscaped(request.getUri());
+                break;
+            case PART_URI:
+                if (request.getPath().empty())
+                    _buffer += '-';
+                else
+                    _appendEscaped(request.getPath());
+                break;
+            case PART_STATUS:
+                _appendNumber(static_cast<unsigned long>(client.status));
+                break;
+            case PART_BYTES_SENT:
+                _appendNumber(client.bytesSent);
+                break;
+            case PART_REQUEST_TIME:
+                _appendMsec(client.startTime.tv_sec ? elapsedUsec(client.startTime, now) : 0);
+                break;
+            case PART_FILE_TIME:
+                if (client.fileUsec < 0)
+                    _buffer += '-';
+                else
+                    _appendMsec(client.fileUsec);
+                break;
+            case PART_TIME_LOCAL:
+                if (now.tv_sec != _timeSecond) {
+                    char stamp[64];
+                    struct tm tm;
+                    time_t seconds = now.tv_sec;
+                    localtime_r(&seconds, &tm);
+                    _timeLocal.assign(stamp, strftime(stamp, sizeof(stamp), "%d/%b/%Y:%H:%M:%S %z", &tm));
+                    _timeSecond = now.tv_sec;
+                }
+                _buffer += _timeLocal;
+                break;
+            case PART_HTTP_REFERER:
+            case PART_HTTP_USER_AGENT: {
+                std::string value = request.getHeader(part.type == PART_HTTP_REFERER ? "referer" : "user-agent");
+                if (value.empty())
+                    _buffer += '-';
+                else
+                    _appendEscaped(value);
+                break;
+            }
+        }
+    }
+
+    if (_buffer.size() >= ACCESS_LOG_BUFFER)
+        flush();
+}
+
+void AccessLog::flushIfDue(const struct timeval& now) {
+    if (msUntilFlush(now) == 0)
+        flush();
+}
+
+long AccessLog::msUntilFlush(const struct timeval& now) const {
+    if (_buffer.empty())
+        return -1;
+    long elapsed = (now.tv_sec - _firstPending.tv_sec) * 1000L
+        + (now.tv_usec - _firstPending.tv_usec) / 1000L;
+    return elapsed >= ACCESS_LOG_FLUSH_MS ? 0 : ACCESS_LOG_FLUSH_MS - elapsed;
+}
+
+// Scrive tutto il buffer, ripetendo le write parziali o interrotte; se una
+// write fallisce le righe rimaste si perdono
+void AccessLog::flush() {
+    size_t done = 0;
+    while (_fd >= 0 && done < _buffer.size()) {
+        ssize_t n = ::write(_fd, _buffer.data() + done, _buffer.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            LOG_ERROR("access_log write failed: " << strerror(errno));
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    _buffer.clear();
+}
+
+// Valori del client tra virgolette: '"', '\' e byte non stampabili come \xHH
+void AccessLog::_appendEscaped(const std::string& value) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+            char escaped[4] = { '\\', 'x', hex[c >> 4], hex[c & 0xf] };
+            _buffer.append(escaped, 4);
+        } else
+            _buffer += static_cast<char>(c);
+    }
+}
+
+// Secondi con millisecondi, come $request_time di nginx
+void AccessLog::_appendMsec(long usec) {
+    if (usec < 0)
+        usec = 0;
+    long msec = usec / 1000;
+    _appendNumber(static_cast<unsigned long>(msec / 1000));
+    char frac[4] = { '.', static_cast<char>('0' + msec % 1000 / 100),
+        static_cast<char>('0' + msec % 100 / 10), static_cast<char>('0' + msec % 10) };
+    _buffer.append(frac, 4);
+}
+
+void AccessLog::_appendNumber(unsigned long n) {
+    char digits[24];
+    size_t i = sizeof(digits);
+    do {
+        digits[--i] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    _buffer.append(digits + i, sizeof(digits) - i);
+}
@@ -0,0 +1,90 @@
+// ********** BUFFER_POOL **********
+
+#include "BufferPool.hpp"
+#include <cstring>
+#include <new>
+
+static const size_t classSizes[BUFFER_POOL_CLASSES] = { BUFFER_POOL_MIN, 16 * 1024, BUFFER_POOL_MAX };
+
+BufferPool::BufferPool() : _inUse(0) {
+    for (int i = 0; i < BUFFER_POOL_CLASSES; ++i)
+        _free[i] = NULL;
+}
+
+BufferPool::~BufferPool() {
+    for (size_t i = 0; i < _slabs.size(); ++i)
+        delete[] _slabs[i];
+}
+
+int BufferPool::_classFor(size_t size) {
+    for (int i = 0; i < BUFFER_POOL_CLASSES; ++i) {
+        if (size <= classSizes[i])
+            return i;
+    }
+    return -1;
+}
+
+// Un nuovo slab, tutto nella lista libera della classe
+bool BufferPool::_refill(int sizeClass) {
+    char* slab = new (std::nothrow) char[BUFFER_POOL_SLAB_SIZE];
+    if (!slab)
+        return false;
+    _slabs.push_back(slab);
+    size_t size = classSizes[sizeClass];
+    for (size_t offset = 0; offset + size <= BUFFER_POOL_SLAB_SIZE; offset += size) {
+        char* buffer = slab + offset;
+        std::memcpy(buffer, &_free[sizeClass], sizeof(char*));
+        _free[sizeClass] = buffer;
+    }
+    return true;
+}
+
+bool BufferPool::acquire(IoBuffer& buffer, size_t size) {
+    int sizeClass = _classFor(size);
+    if (sizeClass < 0)
+        sizeClass = BUFFER_POOL_CLASSES - 1;
+    if (!_free[sizeClass] && !_refill(sizeClass))
+        return false;
+
+    char* data = _free[sizeClass];
+    std::memcpy(&_free[sizeClass], data, sizeof(char*));
+    buffer.data = data;
+    buffer.capacity = classSizes[sizeClass];
+    buffer.length = 0;
+    _inUse += buffer.capacity;
+    return true;
+}
+
+bool BufferPool::grow(IoBuffer& buffer, size_t size) {
+    if (size <= buffer.capacity)
+        return true;
+    if (size > BUFFER_POOL_MAX)
+        return false;
+    IoBuffer bigger;
+    if (!acquire(bigger, size))
+        return false;
+    if (buffer.length)
+        std::memcpy(bigger.data, buffer.data, buffer.length);
+    bigger.length = buffer.length;
+    release(buffer);
+    buffer = bigger;
+    return true;
+}
+
+void BufferPool::release(IoBuffer& buffer) {
+    if (!buffer.data)
+        return;
+    int sizeClass = _classFor(buffer.capacity);
+    std::memcpy(buffer.data, &_free[sizeClass], sizeof(char*));
+    _free[sizeClass] = buffer.data;
+    _inUse -= buffer.capacity;
+    buffer = IoBuffer();
+}
+
+size_t BufferPool::slabBytes() const {
+    return _slabs.size() * BUFFER_POOL_SLAB_SIZE;
+}
+
+size_t BufferPool::inUse() const {
+    return _inUse;
+}
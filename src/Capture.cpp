@@ -0,0 +1,123 @@
+// ********** CAPTURE **********
+// Nessun log qui dentro: la lettura è usata anche da loadgen, che non
+// linka il Logger. Gli errori tornano al chiamante
+
+#include "Capture.hpp"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+Capture::Capture() : _fd(-1), _sample(CAPTURE_DEFAULT_SAMPLE),
+    _maxSize(CAPTURE_DEFAULT_MAX_SIZE), _written(0), _seen(0) {}
+
+Capture::~Capture() {
+    if (_fd >= 0)
+        close(_fd);
+}
+
+bool Capture::open(const std::string& path, size_t sample, size_t maxSize, std::string& error) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = "cannot open capture " + path + ": " + strerror(errno);
+        return false;
+    }
+    if (write(fd, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != CAPTURE_MAGIC_SIZE) {
+        error = "cannot write capture " + path + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+    if (_fd >= 0)
+        close(_fd);
+    _fd = fd;
+    _sample = sample > 0 ? sample : 1;
+    _maxSize = maxSize;
+    _written = CAPTURE_MAGIC_SIZE;
+    _seen = 0;
+    return true;
+}
+
+bool Capture::enabled() const {
+    return _fd >= 0;
+}
+
+bool Capture::sample() {
+    if (_fd < 0)
+        return false;
+    return _seen++ % _sample == 0;
+}
+
+bool Capture::record(int port, const struct timeval& start, const std::string& data) {
+    if (_fd < 0)
+        return true;
+    CaptureHeader header;
+    header.usec = static_cast<uint64_t>(start.tv_sec) * 1000000 + start.tv_usec;
+    header.length = static_cast<uint32_t>(data.size());
+    header.port = static_cast<uint16_t>(port);
+    header.flags = 0;
+    size_t total = sizeof(header) + data.size();
+    if (_written + total > _maxSize) {
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(data.data());
+    iov[1].iov_len = data.size();
+    // File regolare: una writev scrive tutto o fallisce
+    if (writev(_fd, iov, 2) != static_cast<ssize_t>(total)) {
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+    _written += total;
+    return true;
+}
+
+bool Capture::load(const std::string& path, std::vector<CaptureRecord>& records, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+    std::string content;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+        content.append(buffer, static_cast<size_t>(n));
+    close(fd);
+    if (n < 0) {
+        error = "cannot read " + path + ": " + strerror(errno);
+        return false;
+    }
+    if (content.compare(0, CAPTURE_MAGIC_SIZE, CAPTURE_MAGIC) != 0) {
+        error = path + " is not a webserv capture";
+        return false;
+    }
+
+    size_t pos = CAPTURE_MAGIC_SIZE;
+    while (pos < content.size()) {
+        CaptureHeader header;
+        if (content.size() - pos < sizeof(header)) {
+            error = path + ": truncated record header";
+            return false;
+        }
+        std::memcpy(&header, content.data() + pos, sizeof(header));
+        pos += sizeof(header);
+        if (content.size() - pos < header.length) {
+            error = path + ": truncated record";
+            return false;
+        }
+        CaptureRecord record;
+        record.usec = static_cast<long>(header.usec);
+        record.port = header.port;
+        record.data.assign(content, pos, header.length);
+        records.push_back(record);
+        pos += header.length;
+    }
+    return true;
+}
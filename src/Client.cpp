@@ -0,0 +1,8 @@
+#include "Client.hpp"
+
+Client::Client()
+    : state(READING_HEADERS), listenFd(-1), input(), buffer(), request(), pathRewritten(false),
+      server(NULL), location(NULL), route(), bodyExpected(0),
+      bodyReceived(0), bodyInMemory(0), bodyFd(-1), address(), acceptTime(), startTime(),
+      status(0), bytesReceived(0), bytesSent(0), fileUsec(-1), phase(CONN_WAITING),
+      fsUsec(-1), capturing(false), captured() {}
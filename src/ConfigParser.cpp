@@ -2,22 +2,27 @@
 // Implementazione parser di configurazione
 
 #include "ConfigParser.hpp"
+#include "utils.hpp"
+#include "AccessLog.hpp"
+#include "Capture.hpp"
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
 #include <cctype>
 
-// Helper compatibile C++98 per convertire numeri in stringa
-template <typename T>
-std::string to_string98(T n) {
-    std::ostringstream oss;
-    oss << n;
-    return oss.str();
-}
+// Valori di default delle direttive globali
+GlobalConfig::GlobalConfig()
+    : upload_threads(2), upload_durability(0), upload_sync_batch(16),
+      body_memory_limit(64 * 1024 * 1024), body_temp_path("/tmp"),
+      route_cache_size(1024), error_log("stderr"), error_log_level(LEVEL_NOTICE),
+      capture_sample(CAPTURE_DEFAULT_SAMPLE), capture_max_size(CAPTURE_DEFAULT_MAX_SIZE) {}
 
 // Costruttore: salva path
-ConfigParser::ConfigParser(const std::string& path) : _path(path) {}
+ConfigParser::ConfigParser(const std::string& path) : _path(path), _typesSeen(false) {
+    _logFormats["main"] = ACCESS_LOG_FORMAT_MAIN;
+    _logFormats["combined"] = ACCESS_LOG_FORMAT_COMBINED;
+}
 
 // Avvia parsing
 void ConfigParser::parse()
@@ -25,6 +30,8 @@ void ConfigParser::parse()
     _readFile();
     _cleanLines();
     _parseBlocks();
+    _global.mime_types.build();
+    _buildErrorPages();
 }
 
 // Ritorna servers
@@ -32,6 +39,11 @@ const std::vector<ServerConfig>& ConfigParser::getServers() const {
     return _servers;
 }
 
+// Ritorna direttive globali
+const GlobalConfig& ConfigParser::getGlobal() const {
+    return _global;
+}
+
 // Ritorna lista host:port per bind
 std::vector< std::pair<std::string,int> >
 ConfigParser::getListenList() const {
@@ -94,11 +106,19 @@ void ConfigParser::_parseBlocks()
             continue;
         }
 
+        if (!inBlock && _startsWith(line, "types")
+            && line.find('{') != std::string::npos) {
+            i = _parseTypesBlock(_rawLines, i);
+            continue;
+        }
+
+        if (!inBlock) {
+            _parseGlobalLine(line, i + 1);
+            continue;
+        }
+
         if (inBlock) {
-            if (line.find('{') != std::string::npos)
-                braceCount++;
-            if (line.find('}') != std::string::npos)
-                braceCount--;
+            braceCount += _braceDelta(line);
             current.push_back(line);
 
             if (braceCount == 0) {
@@ -121,6 +141,7 @@ ServerConfig ConfigParser::_parseServerBlock(
 {
     ServerConfig srv;
     srv.client_max_body_size = 0;
+    srv.client_body_buffer_size = 0;
 
     std::vector<std::string> currentLoc;
     bool inLoc = false;
@@ -138,10 +159,7 @@ ServerConfig ConfigParser::_parseServerBlock(
         }
 
         if (inLoc) {
-            if (line.find('{') != std::string::npos)
-                braceCount++;
-            if (line.find('}') != std::string::npos)
-                braceCount--;
+            braceCount += _braceDelta(line);
             currentLoc.push_back(line);
 
             if (braceCount == 0) {
@@ -163,10 +181,16 @@ ServerConfig ConfigParser::_parseServerBlock(
             _stripSemicolon(line);
             std::istringstream iss(line);
             std::string tmp, value;
-            iss >> tmp >> value;
-            if (value.empty())
+            iss >> tmp;
+            // Più nomi per blocco, confrontati senza distinzione di maiuscole
+            while (iss >> value) {
+                for (size_t k = 0; k < value.size(); ++k)
+                    value[k] = static_cast<char>(std::tolower(value[k]));
+                srv.server_names.push_back(value);
+            }
+            if (srv.server_names.empty())
                 throw ConfigException("Invalid server_name at line " + to_string98(lineInFile) + ": missing name");
-            srv.server_name = value;
+            srv.server_name = srv.server_names[0];
         }
         else if (_startsWith(line, "root")) {
             _stripSemicolon(line);
@@ -178,7 +202,11 @@ ServerConfig ConfigParser::_parseServerBlock(
             srv.root = value;
         }
         else if (_startsWith(line, "error_page"))
-            _parseErrorPageLine(line, srv, lineInFile);
+            _parseErrorPageLine(line, srv.error_pages, lineInFile);
+        else if (_startsWith(line, "expires"))
+            _parseExpiresLine(line, srv.headers, lineInFile);
+        else if (_startsWith(line, "add_header"))
+            _parseAddHeaderLine(line, srv.headers, lineInFile);
         else if (_startsWith(line, "client_max_body_size")) {
             _stripSemicolon(line);
             std::istringstream iss(line);
@@ -186,11 +214,42 @@ ServerConfig ConfigParser::_parseServerBlock(
             size_t val;
             iss >> tmp >> val;
             srv.client_max_body_size = val;
+        }
+        else if (_startsWith(line, "client_body_buffer_size")) {
+            _stripSemicolon(line);
+            std::istringstream iss(line);
+            std::string tmp;
+            size_t val = 0;
+            iss >> tmp >> val;
+            if (val == 0)
+                throw ConfigException("Invalid client_body_buffer_size at line " + to_string98(lineInFile));
+            srv.client_body_buffer_size = val;
         }
 				// ...dopo aver processato tutte le direttive...
 		if (srv.listen.empty())
 			throw ConfigException("Missing listen directive in server block");
     }
+
+    // Valori effettivi calcolati una volta: la location eredita dal server
+    srv.fallback.path = "/";
+    srv.fallback.modifier = LOCATION_PREFIX;
+    srv.fallback.autoindex = false;
+    srv.fallback.stub_status = STATUS_OFF;
+    srv.fallback.methods = METHOD_ALL;
+    srv.fallback.upload_shard = 0;
+    srv.fallback.max_body_size = 0;
+    srv.fallback.body_buffer_size = 0;
+    _inheritServer(srv.fallback, srv);
+
+    // Prefissi ed esatte nel trie, le regex a parte in ordine di config
+    for (size_t i = 0; i < srv.locations.size(); ++i) {
+        _inheritServer(srv.locations[i], srv);
+        const LocationConfig& loc = srv.locations[i];
+        if (loc.modifier == LOCATION_REGEX || loc.modifier == LOCATION_REGEX_ICASE)
+            srv.regexLocations.push_back(i);
+        else
+            srv.locationTrie.insert(loc.path, i, loc.modifier == LOCATION_EXACT);
+    }
     return srv;
 }
 
@@ -200,13 +259,14 @@ LocationConfig ConfigParser::_parseLocationBlock(
 {
     LocationConfig loc;
     loc.autoindex = false;
+    loc.stub_status = STATUS_OFF;
+    loc.methods = METHOD_ALL;
     loc.max_body_size = 0;
+    loc.upload_shard = 0;
+    loc.body_buffer_size = 0;
 
-    std::istringstream first(block[0]);
     std::string tmp;
-    first >> tmp >> loc.path;
-    if (loc.path.empty())
-        throw ConfigException("Invalid location path at line " + to_string98(blockStartLine));
+    _parseLocationHeader(block[0], loc, blockStartLine);
 
     for (size_t i = 1; i < block.size() - 1; ++i) {
         std::string line = block[i];
@@ -218,6 +278,16 @@ LocationConfig ConfigParser::_parseLocationBlock(
             if (loc.root.empty())
                 throw ConfigException("Invalid root in location at line " + to_string98(blockStartLine + i) + ": missing path");
         }
+        else if (_startsWith(line, "alias")) {
+            _stripSemicolon(line);
+            std::istringstream iss(line);
+            iss >> tmp >> loc.alias;
+            if (loc.alias.empty())
+                throw ConfigException("Invalid alias at line " + to_string98(blockStartLine + i) + ": missing path");
+            // Senza catture non c'è un prefisso da sostituire
+            if (loc.modifier == LOCATION_REGEX || loc.modifier == LOCATION_REGEX_ICASE)
+                throw ConfigException("Invalid alias at line " + to_string98(blockStartLine + i) + ": not allowed in regex locations");
+        }
         else if (_startsWith(line, "index")) {
             _stripSemicolon(line);
             std::istringstream iss(line);
@@ -235,13 +305,37 @@ LocationConfig ConfigParser::_parseLocationBlock(
             std::istringstream iss(line);
             iss >> tmp;
             std::string method;
-            while (iss >> method)
-                loc.methods.push_back(method);
+            loc.methods = 0;
+            while (iss >> method) {
+                unsigned int bit = methodBit(method);
+                if (bit == 0)
+                    throw ConfigException("Invalid limit_except at line " + to_string98(blockStartLine + i) + ": unsupported method " + method);
+                // Come in nginx, GET ammette anche HEAD
+                if (bit == METHOD_GET)
+                    bit |= METHOD_HEAD;
+                loc.methods |= bit;
+            }
         }
         else if (_startsWith(line, "upload_store")) {
+            // upload_store <dir> [<dir> ...]: più radici, anche su dischi diversi
             _stripSemicolon(line);
             std::istringstream iss(line);
-            iss >> tmp >> loc.upload_dir;
+            std::string dir;
+            iss >> tmp;
+            while (iss >> dir)
+                loc.upload_dirs.push_back(dir);
+            if (loc.upload_dirs.empty())
+                throw ConfigException("Invalid upload_store at line " + to_string98(blockStartLine + i) + ": missing path");
+            loc.upload_dir = loc.upload_dirs[0];
+        }
+        else if (_startsWith(line, "upload_shard")) {
+            _stripSemicolon(line);
+            std::istringstream iss(line);
+            long levels = -1;
+            iss >> tmp >> levels;
+            if (levels < 0 || levels > 2)
+                throw ConfigException("Invalid upload_shard at line " + to_string98(blockStartLine + i) + ": expected 0, 1 or 2");
+            loc.upload_shard = static_cast<size_t>(levels);
         }
         else if (_startsWith(line, "cgi_pass")) {
             _stripSemicolon(line);
@@ -250,10 +344,35 @@ LocationConfig ConfigParser::_parseLocationBlock(
             iss >> tmp >> ext >> path;
             loc.cgi[ext] = path;
         }
+        else if (_startsWith(line, "stub_status")) {
+            // stub_status [text|prometheus]: ?format= sceglie per richiesta
+            _stripSemicolon(line);
+            std::istringstream iss(line);
+            std::string format, extra;
+            iss >> tmp >> format >> extra;
+            if ((format.empty() || format == "text") && extra.empty())
+                loc.stub_status = STATUS_TEXT;
+            else if (format == "prometheus" && extra.empty())
+                loc.stub_status = STATUS_PROMETHEUS;
+            else
+                throw ConfigException("Invalid stub_status at line " + to_string98(blockStartLine + i) + ": " + format);
+        }
         else if (_startsWith(line, "return")) {
+            // return <code> [<url>] oppure return <url> (302)
             _stripSemicolon(line);
             std::istringstream iss(line);
-            iss >> tmp >> loc.redirect;
+            std::string first, target, extra, error;
+            iss >> tmp >> first >> target >> extra;
+            int code = 302;
+            if (!first.empty() && std::isdigit(static_cast<unsigned char>(first[0])))
+                code = std::atoi(first.c_str());
+            else if (target.empty())
+                target = first;
+            else
+                extra = target;
+            if (first.empty() || !extra.empty() || !loc.redirect.compile(code, target, error))
+                throw ConfigException("Invalid return directive at line " + to_string98(blockStartLine + i)
+                    + (error.empty() ? "" : ": " + error));
         }
         else if (_startsWith(line, "client_max_body_size")) {
             _stripSemicolon(line);
@@ -262,10 +381,259 @@ LocationConfig ConfigParser::_parseLocationBlock(
             iss >> tmp >> val;
             loc.max_body_size = val;
         }
+        else if (_startsWith(line, "error_page"))
+            _parseErrorPageLine(line, loc.error_pages, blockStartLine + i);
+        else if (_startsWith(line, "expires"))
+            _parseExpiresLine(line, loc.headers, blockStartLine + i);
+        else if (_startsWith(line, "add_header"))
+            _parseAddHeaderLine(line, loc.headers, blockStartLine + i);
+        else if (_startsWith(line, "client_body_buffer_size")) {
+            _stripSemicolon(line);
+            std::istringstream iss(line);
+            size_t val = 0;
+            iss >> tmp >> val;
+            if (val == 0)
+                throw ConfigException("Invalid client_body_buffer_size at line " + to_string98(blockStartLine + i));
+            loc.body_buffer_size = val;
+        }
     }
+    if (!loc.alias.empty() && !loc.root.empty())
+        throw ConfigException("Invalid location at line " + to_string98(blockStartLine) + ": root and alias are exclusive");
     return loc;
 }
 
+// Parser delle direttive globali (le righe sconosciute sono ignorate)
+void ConfigParser::_parseGlobalLine(const std::string& line, size_t lineNum)
+{
+    std::string copy = line;
+    _stripSemicolon(copy);
+    std::istringstream iss(copy);
+    std::string tmp, val;
+    iss >> tmp >> val;
+
+    if (tmp == "upload_threads") {
+        char* endptr = NULL;
+        long n = std::strtol(val.c_str(), &endptr, 10);
+        if (val.empty() || *endptr != '\0' || n < 0 || n > 64)
+            throw ConfigException("Invalid upload_threads at line " + to_string98(lineNum) + ": " + val);
+        _global.upload_threads = static_cast<size_t>(n);
+    }
+    else if (tmp == "upload_fsync") {
+        // off: nessuna sync, batch: fdatasync ogni N file, on: ogni file
+        if (val == "off")
+            _global.upload_durability = 0;
+        else if (val == "batch")
+            _global.upload_durability = 1;
+        else if (val == "on")
+            _global.upload_durability = 2;
+        else
+            throw ConfigException("Invalid upload_fsync at line " + to_string98(lineNum) + ": " + val);
+        std::string batch;
+        if (iss >> batch) {
+            long n = std::strtol(batch.c_str(), NULL, 10);
+            if (n < 1)
+                throw ConfigException("Invalid upload_fsync batch at line " + to_string98(lineNum) + ": " + batch);
+            _global.upload_sync_batch = static_cast<size_t>(n);
+        }
+    }
+    else if (tmp == "client_body_memory_limit") {
+        char* endptr = NULL;
+        unsigned long n = std::strtoul(val.c_str(), &endptr, 10);
+        if (val.empty() || *endptr != '\0' || n == 0)
+            throw ConfigException("Invalid client_body_memory_limit at line " + to_string98(lineNum) + ": " + val);
+        _global.body_memory_limit = static_cast<size_t>(n);
+    }
+    else if (tmp == "include") {
+        if (val.empty())
+            throw ConfigException("Invalid include at line " + to_string98(lineNum) + ": missing path");
+        _parseInclude(val, lineNum);
+    }
+    else if (tmp == "default_type") {
+        if (val.empty())
+            throw ConfigException("Invalid default_type at line " + to_string98(lineNum) + ": missing type");
+        _global.mime_types.setDefault(val);
+    }
+    else if (tmp == "route_cache_size") {
+        char* endptr = NULL;
+        unsigned long n = std::strtoul(val.c_str(), &endptr, 10);
+        if (val.empty() || *endptr != '\0')
+            throw ConfigException("Invalid route_cache_size at line " + to_string98(lineNum) + ": " + val);
+        _global.route_cache_size = static_cast<size_t>(n);
+    }
+    else if (tmp == "client_body_temp_path") {
+        if (val.empty())
+            throw ConfigException("Invalid client_body_temp_path at line " + to_string98(lineNum) + ": missing path");
+        _global.body_temp_path = val;
+    }
+    else if (tmp == "error_log") {
+        // error_log <path|stderr> [debug|info|notice|warn|error|crit]
+        std::string level;
+        iss >> level;
+        if (val.empty())
+            throw ConfigException("Invalid error_log at line " + to_string98(lineNum) + ": missing path");
+        if (!level.empty() && !Logger::parseLevel(level, _global.error_log_level))
+            throw ConfigException("Invalid error_log level at line " + to_string98(lineNum) + ": " + level);
+        _global.error_log = val;
+    }
+    else if (tmp == "log_format")
+        _parseLogFormatLine(copy, lineNum);
+    else if (tmp == "access_log")
+        _parseAccessLogLine(copy, lineNum);
+    else if (tmp == "capture")
+        _parseCaptureLine(copy, lineNum);
+}
+
+// log_format <nome> '<formato>'; il formato va tra apici o virgolette
+void ConfigParser::_parseLogFormatLine(const std::string& line, size_t lineNum)
+{
+    std::string args = line.substr(std::string("log_format").size());
+    _trim(args);
+    size_t space = args.find_first_of(" \t");
+    std::string name = args.substr(0, space);
+    std::string format = (space == std::string::npos) ? "" : args.substr(space);
+    _trim(format);
+    if (format.size() >= 2 && (format[0] == '\'' || format[0] == '"')
+        && format[format.size() - 1] == format[0])
+        format = format.substr(1, format.size() - 2);
+    else if (format.find_first_of(" \t'\"") != std::string::npos)
+        throw ConfigException("Invalid log_format at line " + to_string98(lineNum) + ": quote formats with spaces");
+    if (name.empty() || format.empty())
+        throw ConfigException("Invalid log_format at line " + to_string98(lineNum));
+
+    // Variabili controllate subito: a runtime il formato è già compilato
+    AccessLog check;
+    std::string error;
+    if (!check.compile(format, error))
+        throw ConfigException("Invalid log_format at line " + to_string98(lineNum) + ": " + error);
+    _logFormats[name] = format;
+}
+
+// access_log <path> [formato] | access_log off; il formato va dichiarato prima
+void ConfigParser::_parseAccessLogLine(const std::string& line, size_t lineNum)
+{
+    std::istringstream iss(line);
+    std::string directive, path, name, extra;
+    iss >> directive >> path >> name >> extra;
+    if (path.empty() || !extra.empty())
+        throw ConfigException("Invalid access_log at line " + to_string98(lineNum));
+    if (path == "off") {
+        if (!name.empty())
+            throw ConfigException("Invalid access_log at line " + to_string98(lineNum) + ": off takes no format");
+        _global.access_log.clear();
+        return;
+    }
+    if (name.empty())
+        name = "main";
+    std::map<std::string, std::string>::const_iterator it = _logFormats.find(name);
+    if (it == _logFormats.end())
+        throw ConfigException("Unknown log_format at line " + to_string98(lineNum) + ": " + name);
+    _global.access_log = path;
+    _global.access_log_format = it->second;
+}
+
+// capture <path> [sample=N] [max_size=byte] | capture off
+void ConfigParser::_parseCaptureLine(const std::string& line, size_t lineNum)
+{
+    std::istringstream iss(line);
+    std::string directive, path, option;
+    iss >> directive >> path;
+    if (path.empty())
+        throw ConfigException("Invalid capture at line " + to_string98(lineNum) + ": missing path");
+    if (path == "off") {
+        if (iss >> option)
+            throw ConfigException("Invalid capture at line " + to_string98(lineNum) + ": off takes no options");
+        _global.capture.clear();
+        return;
+    }
+
+    size_t sample = CAPTURE_DEFAULT_SAMPLE;
+    size_t maxSize = CAPTURE_DEFAULT_MAX_SIZE;
+    while (iss >> option) {
+        size_t eq = option.find('=');
+        std::string name = option.substr(0, eq);
+        std::string value = (eq == std::string::npos) ? "" : option.substr(eq + 1);
+        char* endptr = NULL;
+        unsigned long n = std::strtoul(value.c_str(), &endptr, 10);
+        if (value.empty() || *endptr != '\0' || n == 0)
+            throw ConfigException("Invalid capture option at line " + to_string98(lineNum) + ": " + option);
+        if (name == "sample")
+            sample = static_cast<size_t>(n);
+        else if (name == "max_size")
+            maxSize = static_cast<size_t>(n);
+        else
+            throw ConfigException("Unknown capture option at line " + to_string98(lineNum) + ": " + name);
+    }
+    _global.capture = path;
+    _global.capture_sample = sample;
+    _global.capture_max_size = maxSize;
+}
+
+// Blocco types { <tipo> <ext> [<ext> ...]; ... } da lines[start];
+// ritorna l'indice della riga con la graffa di chiusura
+size_t ConfigParser::_parseTypesBlock(const std::vector<std::string>& lines, size_t start)
+{
+    if (!_typesSeen) {
+        _global.mime_types.clear();
+        _typesSeen = true;
+    }
+
+    // Unisce il contenuto tra le graffe, poi divide sulle ';'
+    std::string content = lines[start].substr(lines[start].find('{') + 1);
+    size_t end = start;
+    while (content.find('}') == std::string::npos) {
+        if (++end >= lines.size())
+            throw ConfigException("Unclosed types block at line " + to_string98(start + 1));
+        content += " " + lines[end];
+    }
+    content.erase(content.find('}'));
+
+    std::istringstream statements(content);
+    std::string statement;
+    while (std::getline(statements, statement, ';')) {
+        std::istringstream iss(statement);
+        std::string type, ext;
+        if (!(iss >> type))
+            continue;
+        if (!(iss >> ext))
+            throw ConfigException("Invalid types entry near line " + to_string98(start + 1) + ": " + type);
+        do {
+            _global.mime_types.add(ext, type);
+        } while (iss >> ext);
+    }
+    return end;
+}
+
+// include <file>: per ora solo blocchi types (es. mime.types di nginx);
+// path relativi alla directory del file di configurazione
+void ConfigParser::_parseInclude(const std::string& file, size_t lineNum)
+{
+    std::string path = file;
+    size_t slash = _path.find_last_of('/');
+    if (path[0] != '/' && slash != std::string::npos)
+        path = _path.substr(0, slash + 1) + path;
+
+    std::ifstream in(path.c_str());
+    if (!in.is_open())
+        throw ConfigException("Impossibile aprire il file incluso alla riga " + to_string98(lineNum) + ": " + path);
+
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        _trim(line);
+        if (!line.empty())
+            lines.push_back(line);
+    }
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!_startsWith(lines[i], "types") || lines[i].find('{') == std::string::npos)
+            throw ConfigException("Unsupported directive in " + path + ": " + lines[i]);
+        i = _parseTypesBlock(lines, i);
+    }
+}
+
 // Parser di una direttiva listen con validazione
 void ConfigParser::_parseListenLine(
     const std::string& line, ServerConfig &srv, size_t lineNum)
@@ -273,8 +641,12 @@ void ConfigParser::_parseListenLine(
     std::string copy = line;
     _stripSemicolon(copy);
     std::istringstream iss(copy);
-    std::string tmp, val;
-    iss >> tmp >> val;
+    std::string tmp, val, flag;
+    iss >> tmp >> val >> flag;
+
+    // listen <addr> default_server: default del listener per Host sconosciuti
+    if (!flag.empty() && flag != "default_server")
+        throw ConfigException("Invalid listen directive at line " + to_string98(lineNum) + ": " + flag);
 
     size_t colon = val.find(':');
     std::string host = "0.0.0.0";
@@ -301,11 +673,12 @@ void ConfigParser::_parseListenLine(
         port = static_cast<int>(port_l);
     }
     srv.listen.push_back(std::make_pair(host, port));
+    srv.listen_default.push_back(flag == "default_server");
 }
 
 // Parser di una error_page
 void ConfigParser::_parseErrorPageLine(
-    const std::string& line, ServerConfig &srv, size_t lineNum)
+    const std::string& line, std::map<int, std::string> &pages, size_t lineNum)
 {
     std::string copy = line;
     _stripSemicolon(copy);
@@ -315,7 +688,222 @@ void ConfigParser::_parseErrorPageLine(
     iss >> tmp >> code >> path;
     if (iss.fail() || path.empty())
         throw ConfigException("Invalid error_page directive at line " + to_string98(lineNum));
-    srv.error_pages[code] = path;
+    pages[code] = path;
+}
+
+ResponseHeaders::ResponseHeaders()
+    : expires(EXPIRES_UNSET), expires_time(0), immutable(false) {}
+
+// expires [<tempo> | epoch | max | off] [immutable]
+void ConfigParser::_parseExpiresLine(const std::string& line,
+    ResponseHeaders &headers, size_t lineNum)
+{
+    std::string copy = line;
+    _stripSemicolon(copy);
+    std::istringstream iss(copy);
+    std::string tmp, value, flag, extra;
+    iss >> tmp >> value >> flag >> extra;
+
+    headers.expires_time = 0;
+    headers.immutable = false;
+    if (value == "off")
+        headers.expires = EXPIRES_OFF;
+    else if (value == "epoch")
+        headers.expires = EXPIRES_EPOCH;
+    else if (value == "max")
+        headers.expires = EXPIRES_MAX;
+    else if (!value.empty() && _parseTime(value, headers.expires_time))
+        headers.expires = EXPIRES_AFTER;
+    else
+        throw ConfigException("Invalid expires at line " + to_string98(lineNum) + ": bad time \"" + value + "\"");
+
+    if (flag == "immutable") {
+        if (headers.expires == EXPIRES_OFF || headers.expires == EXPIRES_EPOCH
+            || (headers.expires == EXPIRES_AFTER && headers.expires_time < 0))
+            throw ConfigException("Invalid expires at line " + to_string98(lineNum) + ": immutable needs a positive time");
+        headers.immutable = true;
+    } else if (!flag.empty()) {
+        throw ConfigException("Invalid expires at line " + to_string98(lineNum) + ": unexpected \"" + flag + "\"");
+    }
+    if (!extra.empty())
+        throw ConfigException("Invalid expires at line " + to_string98(lineNum) + ": too many arguments");
+}
+
+// Intervallo nginx: 90, 30s, 1h30m, 7d, 1y, -1 ... (ms, s, m, h, d, w, M, y)
+bool ConfigParser::_parseTime(const std::string& value, long &seconds)
+{
+    size_t i = 0;
+    bool negative = false;
+    if (value[0] == '-') {
+        negative = true;
+        ++i;
+    }
+    if (i >= value.size())
+        return false;
+
+    long total = 0;
+    while (i < value.size()) {
+        if (!std::isdigit(static_cast<unsigned char>(value[i])))
+            return false;
+        long n = 0;
+        while (i < value.size() && std::isdigit(static_cast<unsigned char>(value[i]))) {
+            n = n * 10 + (value[i] - '0');
+            if (n > 100000000L)
+                return false;
+            ++i;
+        }
+        long unit = 1;
+        if (i < value.size()) {
+            if (value.compare(i, 2, "ms") == 0) {
+                n /= 1000;
+                ++i;
+            }
+            else if (value[i] == 'm')
+                unit = 60;
+            else if (value[i] == 'h')
+                unit = 3600;
+            else if (value[i] == 'd')
+                unit = 86400;
+            else if (value[i] == 'w')
+                unit = 7 * 86400;
+            else if (value[i] == 'M')
+                unit = 30 * 86400;
+            else if (value[i] == 'y')
+                unit = 365 * 86400;
+            else if (value[i] != 's')
+                return false;
+            ++i;
+        }
+        if (n > 0 && unit > 0x7fffffffL / n)
+            return false;
+        total += n * unit;
+        if (total > 0x7fffffffL)
+            return false;
+    }
+    seconds = negative ? -total : total;
+    return true;
+}
+
+// add_header <nome> <valore>; il valore può stare tra virgolette
+void ConfigParser::_parseAddHeaderLine(const std::string& line,
+    ResponseHeaders &headers, size_t lineNum)
+{
+    std::string args = line.substr(std::string("add_header").size());
+    _stripSemicolon(args);
+    _trim(args);
+
+    size_t space = args.find_first_of(" \t");
+    std::string name = args.substr(0, space);
+    std::string value = (space == std::string::npos) ? "" : args.substr(space);
+    _trim(value);
+    if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+        value = value.substr(1, value.size() - 2);
+    else if (value.find_first_of(" \t\"") != std::string::npos)
+        throw ConfigException("Invalid add_header at line " + to_string98(lineNum) + ": quote values with spaces");
+
+    if (name.empty() || value.empty() || name.find_first_of(":\"") != std::string::npos)
+        throw ConfigException("Invalid add_header at line " + to_string98(lineNum));
+    headers.add.push_back(std::make_pair(name, value));
+}
+
+// Completa la location con i valori del server: root, limiti, error_page
+void ConfigParser::_inheritServer(LocationConfig &loc, const ServerConfig &srv)
+{
+    if (loc.root.empty())
+        loc.root = srv.root.empty() ? "www" : srv.root;
+    loc.root = normalizePath(loc.root);
+    if (loc.root.empty())
+        loc.root = ".";
+    if (!loc.alias.empty()) {
+        loc.alias = normalizePath(loc.alias);
+        if (loc.alias.empty())
+            loc.alias = ".";
+    }
+    if (loc.index.empty())
+        loc.index = "index.html";
+    if (loc.max_body_size == 0)
+        loc.max_body_size = srv.client_max_body_size;
+    if (loc.body_buffer_size == 0)
+        loc.body_buffer_size = srv.client_body_buffer_size;
+    // insert non sovrascrive: vincono le error_page della location
+    loc.error_pages.insert(srv.error_pages.begin(), srv.error_pages.end());
+    // expires e add_header: come in nginx, quelli della location sostituiscono
+    // in blocco quelli del server
+    if (loc.headers.expires == EXPIRES_UNSET) {
+        loc.headers.expires = srv.headers.expires;
+        loc.headers.expires_time = srv.headers.expires_time;
+        loc.headers.immutable = srv.headers.immutable;
+    }
+    if (loc.headers.add.empty())
+        loc.headers.add = srv.headers.add;
+    _renderHeaders(loc);
+}
+
+// Serializza gli header di cache una volta: a runtime si copia la stringa,
+// solo l'Expires relativo dipende dall'ora della risposta
+void ConfigParser::_renderHeaders(LocationConfig &loc)
+{
+    const ResponseHeaders &h = loc.headers;
+    bool hasCacheControl = false;
+    for (size_t i = 0; i < h.add.size(); ++i) {
+        std::string name = h.add[i].first;
+        for (size_t k = 0; k < name.size(); ++k)
+            name[k] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[k])));
+        if (name == "cache-control")
+            hasCacheControl = true;
+    }
+
+    // add_header Cache-Control prevale sul Cache-Control di expires
+    std::string out;
+    std::string immutable = h.immutable ? ", immutable" : "";
+    loc.expires_after = -1;
+    if (h.expires == EXPIRES_EPOCH || (h.expires == EXPIRES_AFTER && h.expires_time < 0)) {
+        out += "Expires: Thu, 01 Jan 1970 00:00:01 GMT\r\n";
+        if (!hasCacheControl)
+            out += "Cache-Control: no-cache\r\n";
+    } else if (h.expires == EXPIRES_MAX) {
+        out += "Expires: Thu, 31 Dec 2037 23:55:55 GMT\r\n";
+        if (!hasCacheControl)
+            out += "Cache-Control: max-age=315360000" + immutable + "\r\n";
+    } else if (h.expires == EXPIRES_AFTER) {
+        loc.expires_after = h.expires_time;
+        if (!hasCacheControl)
+            out += "Cache-Control: max-age=" + to_string98(h.expires_time) + immutable + "\r\n";
+    }
+    for (size_t i = 0; i < h.add.size(); ++i)
+        out += h.add[i].first + ": " + h.add[i].second + "\r\n";
+    loc.cache_headers = out;
+}
+
+// Serializza le error_page di ogni location (file in root della location):
+// serve la tabella MIME completa, quindi dopo tutti i blocchi
+void ConfigParser::_buildErrorPages()
+{
+    std::string error;
+    for (size_t s = 0; s < _servers.size(); ++s) {
+        ServerConfig &srv = _servers[s];
+        if (!srv.fallback.errors.build(srv.fallback.error_pages, srv.fallback.root, _global.mime_types, error))
+            throw ConfigException(error);
+        for (size_t i = 0; i < srv.locations.size(); ++i) {
+            LocationConfig &loc = srv.locations[i];
+            if (!loc.errors.build(loc.error_pages, loc.root, _global.mime_types, error))
+                throw ConfigException(error + " (location " + loc.path + ")");
+        }
+    }
+}
+
+// Bit del metodo per limit_except
+unsigned int methodBit(const std::string& method)
+{
+    if (method == "GET")
+        return METHOD_GET;
+    if (method == "HEAD")
+        return METHOD_HEAD;
+    if (method == "POST")
+        return METHOD_POST;
+    if (method == "DELETE")
+        return METHOD_DELETE;
+    return 0;
 }
 
 // Trim spazi
@@ -340,3 +928,65 @@ bool ConfigParser::_startsWith(
 {
     return (s.compare(0, pref.size(), pref) == 0);
 }
+
+// Variazione di profondità dei blocchi per una riga: le graffe dentro
+// le virgolette e nel pattern di una location (es. \d{2}) non contano
+int ConfigParser::_braceDelta(const std::string &line)
+{
+    if (_startsWith(line, "location"))
+        return (line[line.size() - 1] == '{') ? 1 : 0;
+
+    bool quoted = false;
+    bool open = false, close = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (line[i] == '"')
+            quoted = !quoted;
+        else if (!quoted && line[i] == '{')
+            open = true;
+        else if (!quoted && line[i] == '}')
+            close = true;
+    }
+    return (open ? 1 : 0) - (close ? 1 : 0);
+}
+
+// location [= | ^~ | ~ | ~*] <path> {
+void ConfigParser::_parseLocationHeader(const std::string &line,
+    LocationConfig &loc, size_t lineNum)
+{
+    std::string args = line.substr(std::string("location").size());
+    if (!args.empty() && args[args.size() - 1] == '{')
+        args.erase(args.size() - 1);
+    _trim(args);
+
+    loc.modifier = LOCATION_PREFIX;
+    size_t space = args.find_first_of(" \t");
+    std::string word = args.substr(0, space);
+    if (space != std::string::npos
+        && (word == "=" || word == "^~" || word == "~" || word == "~*")) {
+        if (word == "=")
+            loc.modifier = LOCATION_EXACT;
+        else if (word == "^~")
+            loc.modifier = LOCATION_PREFIX_NOREGEX;
+        else if (word == "~")
+            loc.modifier = LOCATION_REGEX;
+        else
+            loc.modifier = LOCATION_REGEX_ICASE;
+        args = args.substr(space);
+        _trim(args);
+    }
+
+    // Pattern tra virgolette se contiene spazi o graffe
+    if (args.size() >= 2 && args[0] == '"' && args[args.size() - 1] == '"')
+        args = args.substr(1, args.size() - 2);
+    else if (args.find_first_of(" \t") != std::string::npos)
+        throw ConfigException("Invalid location at line " + to_string98(lineNum) + ": unexpected argument");
+    if (args.empty())
+        throw ConfigException("Invalid location path at line " + to_string98(lineNum));
+    loc.path = args;
+
+    if (loc.modifier == LOCATION_REGEX || loc.modifier == LOCATION_REGEX_ICASE) {
+        std::string error;
+        if (!loc.regex.compile(loc.path, loc.modifier == LOCATION_REGEX_ICASE, error))
+            throw ConfigException("Invalid location regex at line " + to_string98(lineNum) + ": " + error);
+    }
+}
@@ -0,0 +1,76 @@
+// ********** ERROR_PAGES **********
+// Ogni risposta è serializzata una volta con HttpResponse, così gli header
+// sono identici a quelli delle altre risposte
+
+#include "ErrorPages.hpp"
+#include "HttpResponse.hpp"
+#include "MimeTable.hpp"
+#include "utils.hpp"
+#include <stdexcept>
+
+ErrorPages::ErrorPages() {}
+
+bool ErrorPages::build(const std::map<int, std::string>& pages, const std::string& root,
+    const MimeTable& types, std::string& error)
+{
+    _pages.clear();
+    for (std::map<int, std::string>::const_iterator it = pages.begin(); it != pages.end(); ++it) {
+        std::string path = joinPaths(root, it->second);
+        if (!fileExists(path) || isDirectory(path)) {
+            error = "error_page " + to_string98(it->first) + ": cannot read " + path;
+            return false;
+        }
+        std::string body;
+        try {
+            body = readFile(path);
+        } catch (const std::exception& e) {
+            error = "error_page " + to_string98(it->first) + ": " + e.what();
+            return false;
+        }
+        _pages[it->first] = _render(it->first, types.lookup(path), body);
+    }
+    return true;
+}
+
+const ErrorPages::Response& ErrorPages::find(int code) const {
+    std::map<int, Response>::const_iterator it = _pages.find(code);
+    if (it != _pages.end())
+        return it->second;
+    return _builtin(code);
+}
+
+ErrorPages::Response ErrorPages::_render(int code, const std::string& contentType, const std::string& body) {
+    HttpResponse response;
+    response.setStatusCode(code);
+    response.setHeader("Content-Type", contentType);
+    response.setBody(body);
+
+    Response out;
+    out.data = response.toString();
+    out.headerLength = out.data.size() - body.size();
+    return out;
+}
+
+// Pagina predefinita: solo status code e messaggio, niente dati della richiesta
+ErrorPages::Response ErrorPages::_renderDefault(int code) {
+    std::string title = to_string98(code) + " " + HttpResponse::getStatusMessage(code);
+    std::string body = "<html><head><title>" + title + "</title></head>"
+                       "<body><h1>" + title + "</h1></body></html>";
+    return _render(code, "text/html", body);
+}
+
+// I codici che il server genera sono pronti dal primo uso, un codice mai
+// visto viene serializzato una volta e poi riusato
+const ErrorPages::Response& ErrorPages::_builtin(int code) {
+    static std::map<int, Response> defaults;
+    if (defaults.empty()) {
+        const int codes[] = { 400, 403, 404, 405, 413, 417, 500, 501 };
+        for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i)
+            defaults[codes[i]] = _renderDefault(codes[i]);
+    }
+
+    std::map<int, Response>::iterator it = defaults.find(code);
+    if (it == defaults.end())
+        it = defaults.insert(std::make_pair(code, _renderDefault(code))).first;
+    return it->second;
+}
@@ -0,0 +1,70 @@
+// ********** HISTOGRAM **********
+// Bucket i < 16: valore esatto; poi per l'ottava e (2^e <= v < 2^(e+1))
+// i 16 bucket sono larghi 2^(e-4)
+
+#include "Histogram.hpp"
+
+size_t Histogram::bucketOf(unsigned long value) {
+    if (value < HISTOGRAM_SUB_COUNT)
+        return static_cast<size_t>(value);
+    size_t octave = 0;
+    for (unsigned long v = value; v >>= 1; )
+        ++octave;
+    size_t index = (octave - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT
+        + ((value >> (octave - HISTOGRAM_SUB_BITS)) - HISTOGRAM_SUB_COUNT);
+    // Oltre l'ultima ottava si satura
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+unsigned long Histogram::bucketLow(size_t index) {
+    if (index < HISTOGRAM_SUB_COUNT)
+        return index;
+    size_t shift = index / HISTOGRAM_SUB_COUNT - 1;
+    return (HISTOGRAM_SUB_COUNT + index % HISTOGRAM_SUB_COUNT) << shift;
+}
+
+unsigned long Histogram::bucketHigh(size_t index) {
+    if (index < HISTOGRAM_SUB_COUNT)
+        return index;
+    size_t shift = index / HISTOGRAM_SUB_COUNT - 1;
+    return bucketLow(index) + (1UL << shift) - 1;
+}
+
+void Histogram::record(unsigned long value) {
+    __atomic_fetch_add(&counts[bucketOf(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sum, value, __ATOMIC_RELAXED);
+
+    // Massimo con CAS: si riprova solo se un altro thread l'ha alzato
+    unsigned long seen = __atomic_load_n(&max, __ATOMIC_RELAXED);
+    while (value > seen
+        && !__atomic_compare_exchange_n(&max, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Il totale si ricalcola dai bucket copiati, così i percentili non
+// vedono registrazioni a metà
+void Histogram::snapshot(Histogram& out) const {
+    out.total = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        out.counts[i] = __atomic_load_n(&counts[i], __ATOMIC_RELAXED);
+        out.total += out.counts[i];
+    }
+    out.sum = __atomic_load_n(&sum, __ATOMIC_RELAXED);
+    out.max = __atomic_load_n(&max, __ATOMIC_RELAXED);
+}
+
+unsigned long Histogram::percentile(double q) const {
+    if (total == 0)
+        return 0;
+    unsigned long rank = static_cast<unsigned long>(q * total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    unsigned long seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+            return bucketHigh(i) < max ? bucketHigh(i) : max;
+    }
+    return max;
+}
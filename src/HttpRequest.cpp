@@ -1,13 +1,18 @@
 #include "HttpRequest.hpp"
+#include "UploadStore.hpp"
+#include "utils.hpp"
 #include <sstream>
 #include <algorithm>
 #include <cctype>
 #include <fstream>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <sys/mman.h>
 
 HttpRequest::HttpRequest() 
-    : _method(), _uri(), _version(), _headers(), _body(), _isComplete(false) {}
+    : _method(), _uri(), _path(), _version(), _headers(), _body(), _isComplete(false),
+      _bodyFd(-1), _bodySize(0), _bodyData(NULL), _bodyLen(0),
+      _uploadStore(NULL), _uploadLocation(NULL) {}
 
 const std::string& HttpRequest::getMethod() const {
     return _method;
@@ -46,11 +51,26 @@ bool HttpRequest::isComplete() const {
     return _isComplete;
 }
 
-std::string HttpRequest::getPath() const {
-    size_t queryPos = _uri.find('?');
-    if (queryPos != std::string::npos)
-        return _uri.substr(0, queryPos);
-    return _uri;
+// Stima: nodi della map più le stringhe fuori dal buffer interno
+static size_t mapHeapUsage(const std::map<std::string, std::string>& m) {
+    size_t bytes = 0;
+    for (std::map<std::string, std::string>::const_iterator it = m.begin(); it != m.end(); ++it)
+        bytes += MAP_NODE_OVERHEAD + sizeof(*it) + stringHeapBytes(it->first) + stringHeapBytes(it->second);
+    return bytes;
+}
+
+size_t HttpRequest::heapUsage() const {
+    return stringHeapBytes(_method) + stringHeapBytes(_uri) + stringHeapBytes(_path)
+        + stringHeapBytes(_version) + stringHeapBytes(_body) + mapHeapUsage(_headers)
+        + mapHeapUsage(_postData) + mapHeapUsage(_uploadedFiles);
+}
+
+const std::string& HttpRequest::getPath() const {
+    return _path;
+}
+
+void HttpRequest::setPath(const char* path, size_t len) {
+    _path.assign(path, len);
 }
 
 std::string HttpRequest::getQueryString() const {
@@ -110,9 +130,30 @@ bool HttpRequest::parse(const std::string& rawRequest, HttpRequest& request, std
         return false;
     }
 
-    // Estrai headers
-    std::string headers = rawRequest.substr(0, headerEnd);
-    std::istringstream stream(headers);
+    if (!parseHeaders(rawRequest.substr(0, headerEnd), request, errorMsg))
+        return false;
+
+    // Verifica content-length
+    if (request.hasHeader("content-length")) {
+        std::istringstream lengthStream(request.getHeader("content-length"));
+        size_t contentLength;
+        if (!(lengthStream >> contentLength)) {
+            errorMsg = "Invalid Content-Length value";
+            return false;
+        }
+    }
+
+    // Estrai il body se presente (il parsing POST avviene in parseBody)
+    if (headerEnd + 4 < rawRequest.size())
+        request.setBody(rawRequest.substr(headerEnd + 4));
+    else
+        request._isComplete = true;
+
+    return true;
+}
+
+bool HttpRequest::parseHeaders(const std::string& rawHeaders, HttpRequest& request, std::string& errorMsg) {
+    std::istringstream stream(rawHeaders);
     std::string line;
 
     // Parse request line
@@ -131,6 +172,7 @@ bool HttpRequest::parse(const std::string& rawRequest, HttpRequest& request, std
         errorMsg = "Invalid request line format";
         return false;
     }
+    request._path.assign(request._uri, 0, request._uri.find('?'));
 
     // Validazione richiesta HTTP
     if (request._version.substr(0, 5) != "HTTP/") {
@@ -166,39 +208,78 @@ bool HttpRequest::parse(const std::string& rawRequest, HttpRequest& request, std
         request._headers[key] = value;
     }
 
-    // Estrai il body se presente
-    if (headerEnd + 4 < rawRequest.size()) {
-        request._body = rawRequest.substr(headerEnd + 4);
-        
-        // Verifica content-length
-        if (request.hasHeader("content-length")) {
-            std::istringstream lengthStream(request.getHeader("content-length"));
-            size_t contentLength;
-            
-            if (!(lengthStream >> contentLength)) {
-                errorMsg = "Invalid Content-Length value";
-                return false;
-            }
-            
-            // Il body è completo se abbiamo ricevuto tutti i byte
-            request._isComplete = (request._body.size() >= contentLength);
-        } else {
-            // Senza Content-Length, assumiamo che il body sia completo
-            request._isComplete = true;
-        }
-        
-        // NUOVO: Per richieste POST, parsa i dati del body
-        if (request._method == "POST") {
-            request._parsePostData();
+    // Content-Length deve essere numerico: serve prima di leggere il body
+    if (request.hasHeader("content-length")) {
+        const std::string& length = request._headers["content-length"];
+        if (length.empty() || length.find_first_not_of("0123456789") != std::string::npos) {
+            errorMsg = "Invalid Content-Length value";
+            return false;
         }
-    } else {
-        // Nessun body
-        request._isComplete = true;
     }
 
+    // Senza Content-Length la richiesta è completa già dopo gli header
+    request._isComplete = (request.getContentLength() == 0);
     return true;
 }
 
+void HttpRequest::setBody(const std::string& body) {
+    _body = body;
+    _bodyFd = -1;
+    _bodySize = _body.size();
+    // Senza Content-Length, assumiamo che il body sia completo
+    if (hasHeader("content-length"))
+        _isComplete = (_body.size() >= getContentLength());
+    else
+        _isComplete = true;
+}
+
+void HttpRequest::setBodyFile(int fd, size_t size) {
+    // Il descrittore resta di proprietà del chiamante
+    _body.clear();
+    _bodyFd = fd;
+    _bodySize = size;
+    _isComplete = true;
+}
+
+bool HttpRequest::isBodyOnDisk() const {
+    return _bodyFd >= 0;
+}
+
+size_t HttpRequest::getBodySize() const {
+    return _bodySize;
+}
+
+void HttpRequest::parseBody(UploadStore* store, const LocationConfig* location) {
+    // Consumatore del body: invocato solo dopo i controlli di routing,
+    // così le richieste rifiutate non vengono parsate né scritte su disco.
+    // Gli upload vanno nell'upload_store della location
+    if (_method != "POST" || _bodySize == 0)
+        return;
+    
+    // Body su disco: mappato in sola lettura, senza copiarlo in memoria
+    void* mapped = NULL;
+    if (_bodyFd >= 0) {
+        mapped = mmap(NULL, _bodySize, PROT_READ, MAP_PRIVATE, _bodyFd, 0);
+        if (mapped == MAP_FAILED)
+            return;
+        _bodyData = static_cast<const char*>(mapped);
+    } else {
+        _bodyData = _body.data();
+    }
+    _bodyLen = _bodySize;
+    
+    _uploadStore = store;
+    _uploadLocation = location;
+    _parsePostData();
+    _uploadStore = NULL;
+    _uploadLocation = NULL;
+    
+    if (mapped)
+        munmap(mapped, _bodySize);
+    _bodyData = NULL;
+    _bodyLen = 0;
+}
+
 const std::map<std::string, std::string>& HttpRequest::getPostData() const {
     return _postData;
 }
@@ -244,33 +325,36 @@ void HttpRequest::_parseUrlEncodedData() {
     // Parse application/x-www-form-urlencoded data
     // Format: key1=value1&key2=value2
     
-    std::string data = _body;
+    const char* data = _bodyData;
     size_t pos = 0;
     
-    while (pos < data.length()) {
-        size_t ampPos = data.find('&', pos);
-        if (ampPos == std::string::npos) {
-            ampPos = data.length();
-        }
-        
-        std::string pair = data.substr(pos, ampPos - pos);
-        size_t eqPos = pair.find('=');
+    while (pos < _bodyLen) {
+        const void* amp = std::memchr(data + pos, '&', _bodyLen - pos);
+        size_t ampPos = amp ? static_cast<const char*>(amp) - data : _bodyLen;
         
-        if (eqPos != std::string::npos) {
-            std::string key = pair.substr(0, eqPos);
-            std::string value = pair.substr(eqPos + 1);
+        const void* eq = std::memchr(data + pos, '=', ampPos - pos);
+        if (eq) {
+            size_t eqPos = static_cast<const char*>(eq) - data;
+            std::string key(data + pos, eqPos - pos);
+            std::string value(data + eqPos + 1, ampPos - eqPos - 1);
             
             // URL decode key and value
-            key = _urlDecode(key);
-            value = _urlDecode(value);
-            
-            _postData[key] = value;
+            _postData[_urlDecode(key)] = _urlDecode(value);
         }
         
         pos = ampPos + 1;
     }
 }
 
+// Cerca needle nel body a partire da from (npos se assente)
+size_t HttpRequest::_findInBody(const std::string& needle, size_t from) const {
+    if (from >= _bodyLen)
+        return std::string::npos;
+    const char* end = _bodyData + _bodyLen;
+    const char* found = std::search(_bodyData + from, end, needle.begin(), needle.end());
+    return (found == end) ? std::string::npos : static_cast<size_t>(found - _bodyData);
+}
+
 void HttpRequest::_parseMultipartFormData() {
     std::string contentType = getContentType();
     
@@ -280,41 +364,42 @@ void HttpRequest::_parseMultipartFormData() {
     
     std::string boundary = "--" + contentType.substr(boundaryPos + 9);
     
-    // Split body by boundary
+    // Split body by boundary (senza copiare le parti)
     size_t pos = 0;
-    while (pos < _body.length()) {
-        size_t boundaryStart = _body.find(boundary, pos);
+    while (pos < _bodyLen) {
+        size_t boundaryStart = _findInBody(boundary, pos);
         if (boundaryStart == std::string::npos) break;
         
-        size_t nextBoundaryStart = _body.find(boundary, boundaryStart + boundary.length());
+        size_t nextBoundaryStart = _findInBody(boundary, boundaryStart + boundary.length());
         if (nextBoundaryStart == std::string::npos) {
-            nextBoundaryStart = _body.length();
+            nextBoundaryStart = _bodyLen;
         }
         
-        // Extract part between boundaries
-        std::string part = _body.substr(boundaryStart + boundary.length(), 
-                                     nextBoundaryStart - boundaryStart - boundary.length());
-        
-        _parseMultipartPart(part);
+        // Part between boundaries
+        size_t partStart = boundaryStart + boundary.length();
+        _parseMultipartPart(partStart, nextBoundaryStart - partStart);
         
         pos = nextBoundaryStart;
     }
 }
 
-void HttpRequest::_parseMultipartPart(const std::string& part) {
+void HttpRequest::_parseMultipartPart(size_t partStart, size_t partLength) {
+    const char* part = _bodyData + partStart;
+    
     // Skip CRLF after boundary
     size_t pos = 0;
-    if (part.length() >= 2 && part.substr(0, 2) == "\r\n") {
+    if (partLength >= 2 && part[0] == '\r' && part[1] == '\n') {
         pos = 2;
     }
     
     // Parse headers of this part
     std::map<std::string, std::string> partHeaders;
-    while (pos < part.length()) {
-        size_t lineEnd = part.find("\r\n", pos);
-        if (lineEnd == std::string::npos) break;
+    while (pos < partLength) {
+        size_t lineEnd = _findInBody("\r\n", partStart + pos);
+        if (lineEnd == std::string::npos || lineEnd >= partStart + partLength) break;
+        lineEnd -= partStart;
         
-        std::string line = part.substr(pos, lineEnd - pos);
+        std::string line(part + pos, lineEnd - pos);
         if (line.empty()) {
             pos = lineEnd + 2;
             break; // End of part headers
@@ -330,12 +415,14 @@ void HttpRequest::_parseMultipartPart(const std::string& part) {
         
         pos = lineEnd + 2;
     }
+    if (pos > partLength)
+        return;
     
-    // Extract content
-    std::string content = part.substr(pos);
-    // Remove trailing CRLF
-    if (content.length() >= 2 && content.substr(content.length() - 2) == "\r\n") {
-        content = content.substr(0, content.length() - 2);
+    // Content range, without trailing CRLF
+    size_t contentStart = partStart + pos;
+    size_t contentLength = partLength - pos;
+    if (contentLength >= 2 && part[partLength - 2] == '\r' && part[partLength - 1] == '\n') {
+        contentLength -= 2;
     }
     
     // Parse Content-Disposition header
@@ -362,45 +449,30 @@ void HttpRequest::_parseMultipartPart(const std::string& part) {
                         
                         if (!filename.empty()) {
                             // Save file to upload directory
-                            std::string uploadPath = _saveUploadedFile(filename, content);
-                            _uploadedFiles[fieldName] = uploadPath;
+                            _uploadedFiles[fieldName] = _saveUploadedFile(filename, contentStart, contentLength);
                         }
                     }
                 } else {
                     // It's a regular form field
-                    _postData[fieldName] = content;
+                    _postData[fieldName] = std::string(_bodyData + contentStart, contentLength);
                 }
             }
         }
     }
 }
 
-std::string HttpRequest::_saveUploadedFile(const std::string& filename, const std::string& content) {
-    // Create uploads directory if it doesn't exist
-    std::string uploadDir = "./uploads/";
-    system(("mkdir -p " + uploadDir).c_str());
+std::string HttpRequest::_saveUploadedFile(const std::string& filename, size_t offset, size_t length) {
+    // Senza store (uso fuori dal server) si scrive in modo sincrono
+    // nella directory di default
+    static UploadStore fallbackStore;
+    UploadStore* store = _uploadStore ? _uploadStore : &fallbackStore;
     
-    // Generate unique filename to avoid conflicts
-    std::string uniqueFilename = _generateUniqueFilename(filename);
-    std::string fullPath = uploadDir + uniqueFilename;
-    
-    // Write file
-    std::ofstream file(fullPath.c_str(), std::ios::binary);
-    if (file.is_open()) {
-        file.write(content.c_str(), content.length());
-        file.close();
-        return fullPath;
-    }
+    // Body su disco: il writer copia direttamente dal file temporaneo
+    if (_bodyFd >= 0)
+        return store->saveRange(_uploadLocation, filename, _bodyFd, offset, length);
     
-    return "";
-}
-
-std::string HttpRequest::_generateUniqueFilename(const std::string& filename) {
-    // Simple implementation: add timestamp
-    time_t now = time(0);
-    std::ostringstream oss;
-    oss << now << "_" << filename;
-    return oss.str();
+    std::string content(_bodyData + offset, length);
+    return store->save(_uploadLocation, filename, content);
 }
 
 std::string HttpRequest::_urlDecode(const std::string& str) {
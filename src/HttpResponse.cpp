@@ -1,6 +1,9 @@
 #include "HttpResponse.hpp"
 #include "utils.hpp"
+#include "MimeTable.hpp"
 #include <sstream>
+#include <cstring>
+#include <cstdio>
 
 HttpResponse::HttpResponse() : _statusCode(200) {
     // Imposta header di default
@@ -21,6 +24,10 @@ void HttpResponse::setBody(const std::string& body) {
     _headers["Content-Length"] = to_string98(_body.length());
 }
 
+void HttpResponse::addHeaderLines(const std::string& lines) {
+    _headerLines += lines;
+}
+
 std::string HttpResponse::toString() const {
     std::ostringstream oss;
     
@@ -32,6 +39,7 @@ std::string HttpResponse::toString() const {
          it != _headers.end(); ++it) {
         oss << it->first << ": " << it->second << "\r\n";
     }
+    oss << _headerLines;
     
     // Empty line separating headers from body
     oss << "\r\n";
@@ -44,19 +52,56 @@ std::string HttpResponse::toString() const {
     return oss.str();
 }
 
+static bool appendBytes(char* out, size_t capacity, size_t& length, const char* data, size_t size) {
+    if (capacity - length < size)
+        return false;
+    std::memcpy(out + length, data, size);
+    length += size;
+    return true;
+}
+
+size_t HttpResponse::writeHeaders(char* out, size_t capacity) const {
+    size_t length = 0;
+    char statusLine[32];
+    int n = snprintf(statusLine, sizeof(statusLine), "HTTP/1.1 %d ", _statusCode);
+    std::string message = getStatusMessage(_statusCode);
+    if (!appendBytes(out, capacity, length, statusLine, n)
+        || !appendBytes(out, capacity, length, message.data(), message.size())
+        || !appendBytes(out, capacity, length, "\r\n", 2))
+        return 0;
+    
+    for (std::map<std::string, std::string>::const_iterator it = _headers.begin();
+         it != _headers.end(); ++it) {
+        if (!appendBytes(out, capacity, length, it->first.data(), it->first.size())
+            || !appendBytes(out, capacity, length, ": ", 2)
+            || !appendBytes(out, capacity, length, it->second.data(), it->second.size())
+            || !appendBytes(out, capacity, length, "\r\n", 2))
+            return 0;
+    }
+    if (!appendBytes(out, capacity, length, _headerLines.data(), _headerLines.size())
+        || !appendBytes(out, capacity, length, "\r\n", 2))
+        return 0;
+    return length;
+}
+
 std::string HttpResponse::getStatusMessage(int code) {
     switch (code) {
+        case 100: return "Continue";
         case 200: return "OK";
         case 201: return "Created";
         case 204: return "No Content";
         case 301: return "Moved Permanently";
         case 302: return "Found";
+        case 303: return "See Other";
         case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
         case 400: return "Bad Request";
         case 403: return "Forbidden";
         case 404: return "Not Found";
         case 405: return "Method Not Allowed";
         case 413: return "Payload Too Large";
+        case 417: return "Expectation Failed";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         default: return "Unknown";
@@ -64,25 +109,7 @@ std::string HttpResponse::getStatusMessage(int code) {
 }
 
 std::string HttpResponse::getContentType(const std::string& path) {
-    size_t dot = path.find_last_of('.');
-    if (dot == std::string::npos)
-        return "application/octet-stream";
-        
-    std::string ext = path.substr(dot);
-    
-    if (ext == ".html" || ext == ".htm") return "text/html";
-    if (ext == ".css") return "text/css";
-    if (ext == ".js") return "application/javascript";
-    if (ext == ".json") return "application/json";
-    if (ext == ".xml") return "application/xml";
-    if (ext == ".txt") return "text/plain";
-    if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
-    if (ext == ".png") return "image/png";
-    if (ext == ".gif") return "image/gif";
-    if (ext == ".svg") return "image/svg+xml";
-    if (ext == ".ico") return "image/x-icon";
-    if (ext == ".pdf") return "application/pdf";
-    if (ext == ".zip") return "application/zip";
-    
-    return "application/octet-stream";
+    // Tabella predefinita; il server usa quella della configurazione
+    static const MimeTable defaults;
+    return defaults.lookup(path);
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+// ********** LOCATION_TRIE **********
+// Costruzione e ricerca nel radix trie delle location
+
+#include "LocationTrie.hpp"
+
+LocationTrie::LocationTrie() {
+    _newNode("", -1, false);
+}
+
+size_t LocationTrie::_newNode(const std::string& label, long location, bool slash) {
+    Node node;
+    node.label = label;
+    node.location = location;
+    node.exact = -1;
+    node.slashTerminated = slash;
+    _nodes.push_back(node);
+    return _nodes.size() - 1;
+}
+
+void LocationTrie::insert(const std::string& path, size_t locationIndex, bool exact) {
+    bool slash = !path.empty() && path[path.size() - 1] == '/';
+    size_t current = 0;
+    size_t pos = 0;
+
+    while (pos < path.size()) {
+        // Cerca l'arco che inizia con il prossimo carattere
+        size_t child = 0;
+        bool found = false;
+        for (size_t i = 0; i < _nodes[current].children.size(); ++i) {
+            child = _nodes[current].children[i];
+            if (_nodes[child].label[0] == path[pos]) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            size_t leaf = _newNode(path.substr(pos), -1, false);
+            _nodes[current].children.push_back(leaf);
+            current = leaf;
+            break;
+        }
+
+        // Lunghezza del prefisso comune tra arco e path residuo
+        const std::string label = _nodes[child].label;
+        size_t common = 0;
+        while (common < label.size() && pos + common < path.size()
+            && label[common] == path[pos + common])
+            ++common;
+
+        if (common < label.size()) {
+            // Divide l'arco: il nodo intermedio prende il prefisso comune
+            size_t middle = _newNode(label.substr(0, common), -1, false);
+            _nodes[child].label = label.substr(common);
+            _nodes[middle].children.push_back(child);
+            for (size_t i = 0; i < _nodes[current].children.size(); ++i) {
+                if (_nodes[current].children[i] == child)
+                    _nodes[current].children[i] = middle;
+            }
+            child = middle;
+        }
+        current = child;
+        pos += common;
+    }
+
+    // Marca il nodo del path (nuovo, intermedio o radice)
+    if (exact) {
+        if (_nodes[current].exact < 0)
+            _nodes[current].exact = static_cast<long>(locationIndex);
+    } else if (_nodes[current].location < 0) {
+        _nodes[current].location = static_cast<long>(locationIndex);
+        _nodes[current].slashTerminated = slash;
+    }
+}
+
+long LocationTrie::match(const char* uri, size_t len, bool* exact) const {
+    long best = _nodes[0].location;
+    if (exact)
+        *exact = false;
+    size_t current = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        const Node* next = NULL;
+        const std::vector<size_t>& children = _nodes[current].children;
+        for (size_t i = 0; i < children.size(); ++i) {
+            const Node& candidate = _nodes[children[i]];
+            if (candidate.label[0] == uri[pos]) {
+                next = &candidate;
+                current = children[i];
+                break;
+            }
+        }
+        if (!next || next->label.size() > len - pos
+            || next->label.compare(0, next->label.size(), uri + pos, next->label.size()) != 0)
+            break;
+        pos += next->label.size();
+
+        if (pos == len && next->exact >= 0) {
+            if (exact)
+                *exact = true;
+            return next->exact;
+        }
+
+        // Prefisso valido solo su confine di segmento
+        if (next->location >= 0
+            && (next->slashTerminated || pos == len || uri[pos] == '/'))
+            best = next->location;
+    }
+    return best;
+}
+
+long LocationTrie::match(const std::string& uri, bool* exact) const {
+    return match(uri.data(), uri.size(), exact);
+}
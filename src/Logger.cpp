@@ -0,0 +1,345 @@
+// ********** LOGGER **********
+// Ring SPSC per thread: il produttore scrive e pubblica head con una store
+// release, il flusher legge head con una load acquire e libera con tail
+
+#include "Logger.hpp"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+
+LogLevel Logger::_level = LEVEL_NOTICE;
+int Logger::_fd = STDERR_FILENO;
+std::string Logger::_path = "stderr";
+bool Logger::_reopenRequested = false;
+bool Logger::_running = false;
+bool Logger::_stopping = false;
+pthread_t Logger::_thread;
+pthread_mutex_t Logger::_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Logger::_cond = PTHREAD_COND_INITIALIZER;
+pthread_key_t Logger::_key;
+pthread_once_t Logger::_once = PTHREAD_ONCE_INIT;
+std::vector<Logger::Ring*> Logger::_rings;
+
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    static const char* names[] = { "debug", "info", "notice", "warn", "error", "crit" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (name == names[i]) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* Logger::levelName(LogLevel level) {
+    switch (level) {
+        case LEVEL_DEBUG: return "debug";
+        case LEVEL_INFO: return "info";
+        case LEVEL_NOTICE: return "notice";
+        case LEVEL_WARN: return "warn";
+        case LEVEL_ERROR: return "error";
+        default: return "crit";
+    }
+}
+
+bool Logger::open(const std::string& path, LogLevel level, std::string& error) {
+    int fd = STDERR_FILENO;
+    if (path != "stderr") {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            error = "cannot open error_log " + path + ": " + strerror(errno);
+            return false;
+        }
+    }
+    close();
+    _fd = fd;
+    _path = path;
+    _level = level;
+
+    // Senza flusher le righe restano sincrone
+    _stopping = false;
+    if (pthread_create(&_thread, NULL, &Logger::_flusherMain, NULL) == 0)
+        __atomic_store_n(&_running, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+void Logger::close() {
+    if (__atomic_load_n(&_running, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&_mutex);
+        _stopping = true;
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_mutex);
+        pthread_join(_thread, NULL);
+        __atomic_store_n(&_running, false, __ATOMIC_RELEASE);
+        _drain();
+    }
+    if (_fd != STDERR_FILENO)
+        ::close(_fd);
+    _fd = STDERR_FILENO;
+    _path = "stderr";
+}
+
+void Logger::reopen() {
+    if (!__atomic_load_n(&_running, __ATOMIC_ACQUIRE)) {
+        _reopenFile();
+        return;
+    }
+    __atomic_store_n(&_reopenRequested, true, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&_mutex);
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+}
+
+// Il nuovo file sostituisce il vecchio solo se si apre
+void Logger::_reopenFile() {
+    if (_path == "stderr")
+        return;
+    int fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("cannot reopen error_log " << _path << ": " << strerror(errno));
+        return;
+    }
+    int old = _fd;
+    _fd = fd;
+    ::close(old);
+}
+
+unsigned long Logger::dropped() {
+    unsigned long total = 0;
+    pthread_mutex_lock(&_mutex);
+    for (size_t i = 0; i < _rings.size(); ++i)
+        total += __atomic_load_n(&_rings[i]->dropped, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&_mutex);
+    return total;
+}
+
+void Logger::_initKey() {
+    pthread_key_create(&_key, NULL);
+}
+
+// Ring del thread chiamante, creato al primo log; i ring vivono quanto il processo
+Logger::Ring* Logger::_ring() {
+    pthread_once(&_once, &Logger::_initKey);
+    Ring* ring = static_cast<Ring*>(pthread_getspecific(_key));
+    if (ring)
+        return ring;
+
+    ring = new Ring;
+    ring->data = new char[LOG_RING_SIZE];
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    ring->stampSecond = 0;
+    ring->stampLength = 0;
+    pthread_mutex_lock(&_mutex);
+    _rings.push_back(ring);
+    pthread_mutex_unlock(&_mutex);
+    pthread_setspecific(_key, ring);
+    return ring;
+}
+
+size_t Logger::timestamp(char* out, size_t size) {
+    Ring* ring = _ring();
+    time_t now = time(NULL);
+    if (now != ring->stampSecond) {
+        struct tm tm;
+        localtime_r(&now, &tm);
+        ring->stampLength = strftime(ring->stamp, sizeof(ring->stamp), "%Y/%m/%d %H:%M:%S ", &tm);
+        ring->stampSecond = now;
+    }
+    size_t len = ring->stampLength < size ? ring->stampLength : size;
+    memcpy(out, ring->stamp, len);
+    return len;
+}
+
+void Logger::commit(const char* line, size_t len) {
+    if (!__atomic_load_n(&_running, __ATOMIC_ACQUIRE)) {
+        _writeAll(line, len);
+        return;
+    }
+
+    // Il produttore non aspetta mai: ring pieno = riga persa e contata
+    Ring* ring = _ring();
+    size_t head = ring->head;
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (LOG_RING_SIZE - (head - tail) < len) {
+        __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    size_t pos = head % LOG_RING_SIZE;
+    size_t first = LOG_RING_SIZE - pos;
+    if (first > len)
+        first = len;
+    memcpy(ring->data + pos, line, first);
+    memcpy(ring->data, line + first, len - first);
+    __atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+
+    // Oltre metà ring conviene non aspettare l'intervallo del flusher
+    if (head + len - tail > LOG_RING_SIZE / 2)
+        pthread_cond_signal(&_cond);
+}
+
+void* Logger::_flusherMain(void*) {
+    unsigned long reported = dropped();
+    pthread_mutex_lock(&_mutex);
+    while (!_stopping) {
+        pthread_mutex_unlock(&_mutex);
+        _drain();
+        if (__atomic_exchange_n(&_reopenRequested, false, __ATOMIC_ACQ_REL))
+            _reopenFile();
+        unsigned long lost = dropped();
+        if (lost != reported) {
+            LOG_WARN(lost - reported << " log lines dropped, ring buffer full");
+            reported = lost;
+        }
+        pthread_mutex_lock(&_mutex);
+        if (_stopping)
+            break;
+        // Una riapertura chiesta durante il drain non aspetta l'intervallo
+        if (__atomic_load_n(&_reopenRequested, __ATOMIC_ACQUIRE))
+            continue;
+
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        struct timespec deadline;
+        long nsec = now.tv_usec * 1000L + LOG_FLUSH_INTERVAL_MS * 1000000L;
+        deadline.tv_sec = now.tv_sec + nsec / 1000000000L;
+        deadline.tv_nsec = nsec % 1000000000L;
+        pthread_cond_timedwait(&_cond, &_mutex, &deadline);
+    }
+    pthread_mutex_unlock(&_mutex);
+    _drain();
+    return NULL;
+}
+
+// Una writev per tutti i ring (due segmenti per ring se il dato fa il giro)
+bool Logger::_drain() {
+    pthread_mutex_lock(&_mutex);
+    std::vector<Ring*> rings(_rings);
+    pthread_mutex_unlock(&_mutex);
+
+    std::vector<struct iovec> iov;
+    std::vector<size_t> heads(rings.size());
+    size_t total = 0;
+    for (size_t i = 0; i < rings.size(); ++i) {
+        Ring* ring = rings[i];
+        heads[i] = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        size_t len = heads[i] - ring->tail;
+        if (len == 0)
+            continue;
+        size_t pos = ring->tail % LOG_RING_SIZE;
+        size_t first = LOG_RING_SIZE - pos;
+        if (first > len)
+            first = len;
+        struct iovec v;
+        v.iov_base = ring->data + pos;
+        v.iov_len = first;
+        iov.push_back(v);
+        if (len > first) {
+            v.iov_base = ring->data;
+            v.iov_len = len - first;
+            iov.push_back(v);
+        }
+        total += len;
+    }
+    if (total == 0)
+        return false;
+
+    // Una scrittura parziale viene completata segmento per segmento
+    ssize_t written = writev(_fd, &iov[0], static_cast<int>(iov.size()));
+    if (written < 0 || static_cast<size_t>(written) != total) {
+        size_t done = written > 0 ? static_cast<size_t>(written) : 0;
+        for (size_t i = 0; i < iov.size(); ++i) {
+            if (done >= iov[i].iov_len) {
+                done -= iov[i].iov_len;
+                continue;
+            }
+            _writeAll(static_cast<char*>(iov[i].iov_base) + done, iov[i].iov_len - done);
+            done = 0;
+        }
+    }
+
+    for (size_t i = 0; i < rings.size(); ++i)
+        __atomic_store_n(&rings[i]->tail, heads[i], __ATOMIC_RELEASE);
+    return true;
+}
+
+void Logger::_writeAll(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(_fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+// ********** LOG_LINE **********
+
+LogLine::LogLine(LogLevel level) {
+    _length = Logger::timestamp(_buffer, sizeof(_buffer));
+    _append("[", 1);
+    *this << Logger::levelName(level);
+    _append("] ", 2);
+}
+
+LogLine::~LogLine() {
+    // Lo spazio per il '\n' è sempre riservato da _append
+    _buffer[_length++] = '\n';
+    Logger::commit(_buffer, _length);
+}
+
+void LogLine::_append(const char* s, size_t len) {
+    size_t room = sizeof(_buffer) - 1 - _length;
+    if (len > room)
+        len = room;
+    memcpy(_buffer + _length, s, len);
+    _length += len;
+}
+
+LogLine& LogLine::operator<<(const char* s) {
+    _append(s, strlen(s));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const std::string& s) {
+    _append(s.data(), s.size());
+    return *this;
+}
+
+LogLine& LogLine::operator<<(char c) {
+    _append(&c, 1);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(int n) {
+    return *this << static_cast<long>(n);
+}
+
+LogLine& LogLine::operator<<(long n) {
+    if (n < 0) {
+        _append("-", 1);
+        return *this << static_cast<unsigned long>(-(n + 1)) + 1;
+    }
+    return *this << static_cast<unsigned long>(n);
+}
+
+LogLine& LogLine::operator<<(unsigned int n) {
+    return *this << static_cast<unsigned long>(n);
+}
+
+LogLine& LogLine::operator<<(unsigned long n) {
+    char digits[24];
+    size_t i = sizeof(digits);
+    do {
+        digits[--i] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    _append(digits + i, sizeof(digits) - i);
+    return *this;
+}
@@ -0,0 +1,156 @@
+// ********** MIME_TABLE **********
+// Hash perfetto "hash and displace": ogni bucket di primo livello sceglie
+// un seed che manda tutte le sue chiavi in slot liberi e distinti
+
+#include "MimeTable.hpp"
+#include <algorithm>
+#include <cctype>
+
+// Tentativi di seed per bucket prima di allargare la tabella
+#define MIME_MAX_SEED 4096
+
+MimeTable::MimeTable() : _default("application/octet-stream") {
+    const char* defaults[][2] = {
+        { "html", "text/html" }, { "htm", "text/html" },
+        { "css", "text/css" },
+        { "js", "application/javascript" },
+        { "json", "application/json" },
+        { "xml", "application/xml" },
+        { "txt", "text/plain" },
+        { "jpg", "image/jpeg" }, { "jpeg", "image/jpeg" },
+        { "png", "image/png" },
+        { "gif", "image/gif" },
+        { "svg", "image/svg+xml" },
+        { "ico", "image/x-icon" },
+        { "pdf", "application/pdf" },
+        { "zip", "application/zip" }
+    };
+    for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); ++i)
+        add(defaults[i][0], defaults[i][1]);
+    build();
+}
+
+void MimeTable::clear() {
+    _entries.clear();
+    _slots.clear();
+    _seeds.clear();
+}
+
+void MimeTable::add(const std::string& extension, const std::string& type) {
+    std::string ext = extension;
+    for (size_t i = 0; i < ext.size(); ++i)
+        ext[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(ext[i])));
+    if (ext.empty() || ext.size() > MIME_MAX_EXTENSION)
+        return;
+
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        if (_entries[i].extension == ext) {
+            _entries[i].type = type;
+            return;
+        }
+    }
+    Entry entry;
+    entry.extension = ext;
+    entry.type = type;
+    _entries.push_back(entry);
+}
+
+void MimeTable::setDefault(const std::string& type) {
+    _default = type;
+}
+
+size_t MimeTable::size() const {
+    return _entries.size();
+}
+
+// FNV-1a con seed
+unsigned int MimeTable::_hash(const char* key, size_t len, unsigned int seed) {
+    unsigned int h = 2166136261u ^ (seed * 16777619u);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void MimeTable::build() {
+    size_t n = _entries.size();
+    size_t size = 1;
+    while (size < n * 2)
+        size <<= 1;
+
+    while (true) {
+        size_t buckets = size / 2 ? size / 2 : 1;
+        std::vector< std::vector<size_t> > groups(buckets);
+        for (size_t i = 0; i < n; ++i) {
+            const std::string& ext = _entries[i].extension;
+            groups[_hash(ext.data(), ext.size(), 0) & (buckets - 1)].push_back(i);
+        }
+        // Bucket dal più pieno: i grandi trovano un seed finché la tabella è vuota
+        std::vector< std::pair<size_t, size_t> > bySize;
+        for (size_t b = 0; b < buckets; ++b)
+            bySize.push_back(std::make_pair(groups[b].size(), b));
+        std::sort(bySize.rbegin(), bySize.rend());
+
+        _slots.assign(size, -1);
+        _seeds.assign(buckets, 0);
+        bool ok = true;
+        for (size_t k = 0; k < bySize.size() && ok; ++k) {
+            const std::vector<size_t>& group = groups[bySize[k].second];
+            if (group.empty())
+                break;
+            bool placed = false;
+            for (unsigned int seed = 1; seed < MIME_MAX_SEED && !placed; ++seed) {
+                std::vector<size_t> taken;
+                placed = true;
+                for (size_t g = 0; g < group.size(); ++g) {
+                    const std::string& ext = _entries[group[g]].extension;
+                    size_t slot = _hash(ext.data(), ext.size(), seed) & (size - 1);
+                    if (_slots[slot] >= 0 || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+                        placed = false;
+                        break;
+                    }
+                    taken.push_back(slot);
+                }
+                if (placed) {
+                    _seeds[bySize[k].second] = seed;
+                    for (size_t g = 0; g < group.size(); ++g)
+                        _slots[taken[g]] = static_cast<long>(group[g]);
+                }
+            }
+            ok = placed;
+        }
+        if (ok)
+            return;
+        size <<= 1;     // raro: tabella più larga e si riprova
+    }
+}
+
+const std::string& MimeTable::lookup(const std::string& path) const {
+    return lookup(path.data(), path.size());
+}
+
+const std::string& MimeTable::lookup(const char* path, size_t len) const {
+    if (_entries.empty())
+        return _default;
+
+    // Estensione dopo l'ultimo '.' del nome file, minuscola sullo stack
+    size_t dot = len;
+    while (dot > 0 && path[dot - 1] != '.' && path[dot - 1] != '/')
+        --dot;
+    if (dot == 0 || path[dot - 1] != '.')
+        return _default;
+    size_t extLen = len - dot;
+    if (extLen == 0 || extLen > MIME_MAX_EXTENSION)
+        return _default;
+    char ext[MIME_MAX_EXTENSION];
+    for (size_t i = 0; i < extLen; ++i)
+        ext[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(path[dot + i])));
+
+    size_t bucket = _hash(ext, extLen, 0) & (_seeds.size() - 1);
+    size_t slot = _hash(ext, extLen, _seeds[bucket]) & (_slots.size() - 1);
+    long index = _slots[slot];
+    if (index < 0 || _entries[index].extension.compare(0, std::string::npos, ext, extLen) != 0)
+        return _default;
+    return _entries[index].type;
+}
@@ -0,0 +1,143 @@
+// ********** REDIRECT **********
+// Il template di Location è diviso una volta in pezzi fissi e variabili;
+// gli header sono quelli di HttpResponse, tagliati attorno a Location
+
+#include "Redirect.hpp"
+#include "HttpResponse.hpp"
+#include "utils.hpp"
+#include <cctype>
+
+// Segnaposto per il valore di Location nella risposta serializzata
+#define REDIRECT_MARKER "\x01"
+
+Redirect::Redirect() : _code(0), _fixedLength(0) {}
+
+bool Redirect::isRedirectCode(int code) {
+    return code == 301 || code == 302 || code == 303 || code == 307 || code == 308;
+}
+
+int Redirect::code() const {
+    return _code;
+}
+
+bool Redirect::isRedirect() const {
+    return isRedirectCode(_code);
+}
+
+bool Redirect::compile(int code, const std::string& target, std::string& error) {
+    _parts.clear();
+    _head.clear();
+    _tail.clear();
+    _fixedLength = 0;
+    _code = 0;
+
+    if (!isRedirectCode(code)) {
+        // Senza URL: la risposta è la error_page del codice
+        if (code < 400 || code > 599) {
+            error = "unsupported return code " + to_string98(code);
+            return false;
+        }
+        if (!target.empty()) {
+            error = "return " + to_string98(code) + " does not take a URL";
+            return false;
+        }
+        _code = code;
+        return true;
+    }
+    if (target.empty()) {
+        error = "return " + to_string98(code) + " needs a URL";
+        return false;
+    }
+
+    // Pezzi fissi e variabili ($name o ${name})
+    std::string text;
+    size_t i = 0;
+    while (i < target.size()) {
+        if (target[i] != '$') {
+            text += target[i++];
+            continue;
+        }
+        size_t start = i + 1;
+        bool braces = (start < target.size() && target[start] == '{');
+        if (braces)
+            ++start;
+        size_t end = start;
+        while (end < target.size() && (std::isalnum(static_cast<unsigned char>(target[end])) || target[end] == '_'))
+            ++end;
+        std::string name = target.substr(start, end - start);
+        if (braces) {
+            if (end >= target.size() || target[end] != '}') {
+                error = "unterminated variable in return URL";
+                return false;
+            }
+            ++end;
+        }
+
+        Part part;
+        if (name == "request_uri")
+            part.type = PART_REQUEST_URI;
+        else if (name == "host")
+            part.type = PART_HOST;
+        else {
+            error = "unknown variable \"$" + name + "\" in return URL";
+            return false;
+        }
+        if (!text.empty()) {
+            Part literal;
+            literal.type = PART_TEXT;
+            literal.text = text;
+            _parts.push_back(literal);
+            _fixedLength += text.size();
+            text.clear();
+        }
+        _parts.push_back(part);
+        i = end;
+    }
+    if (!text.empty()) {
+        Part literal;
+        literal.type = PART_TEXT;
+        literal.text = text;
+        _parts.push_back(literal);
+        _fixedLength += text.size();
+    }
+
+    // Risposta serializzata una volta, divisa attorno al valore di Location
+    HttpResponse response;
+    response.setStatusCode(code);
+    response.setHeader("Location", REDIRECT_MARKER);
+    response.setBody("");
+    std::string serialized = response.toString();
+    size_t marker = serialized.find(REDIRECT_MARKER);
+    _head = serialized.substr(0, marker);
+    _tail = serialized.substr(marker + 1);
+    _fixedLength += _head.size() + _tail.size();
+
+    // Target senza variabili: tutta la risposta è un unico pezzo fisso
+    if (_parts.size() == 1 && _parts[0].type == PART_TEXT) {
+        _head += _parts[0].text + _tail;
+        _tail.clear();
+        _parts.clear();
+    }
+    _code = code;
+    return true;
+}
+
+const std::string& Redirect::render(const std::string& requestUri, const std::string& host,
+    std::string& out) const
+{
+    if (_parts.empty())
+        return _head;
+    out.clear();
+    out.reserve(_fixedLength + requestUri.size() + host.size());
+    out += _head;
+    for (size_t i = 0; i < _parts.size(); ++i) {
+        if (_parts[i].type == PART_REQUEST_URI)
+            out += requestUri;
+        else if (_parts[i].type == PART_HOST)
+            out += host;
+        else
+            out += _parts[i].text;
+    }
+    out += _tail;
+    return out;
+}
@@ -0,0 +1,648 @@
+// ********** REGEX **********
+// Parser a discesa ricorsiva, compilazione Thompson e DFA costruito
+// lazy: il costo del match è lineare nella lunghezza del testo
+
+#include "Regex.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+// Limite degli stati DFA in cache: oltre, la cache riparte da zero
+#define REGEX_MAX_DFA_STATES 1024
+
+// Passi massimi del backtracking per carattere di input, per l'intera
+// search: oltre, il testo è considerato senza match
+#define REGEX_BACKTRACK_BUDGET 1000
+
+Regex::Regex()
+    : _icase(false), _hasBackrefs(false), _groups(0), _pos(0), _startState(-1) {}
+
+const std::string& Regex::pattern() const {
+    return _pattern;
+}
+
+bool Regex::empty() const {
+    return _prog.empty();
+}
+
+bool Regex::usesDfa() const {
+    return !_hasBackrefs;
+}
+
+bool Regex::compile(const std::string& pattern, bool caseInsensitive, std::string& error) {
+    _pattern = pattern;
+    _icase = caseInsensitive;
+    _hasBackrefs = false;
+    _groups = 0;
+    _classes.clear();
+    _prog.clear();
+    _nodes.clear();
+    _states.clear();
+    _stateIndex.clear();
+    _startState = -1;
+    _pos = 0;
+    _error.clear();
+
+    int root = _parseAlt();
+    if (_error.empty() && _pos < _pattern.size())
+        _error = "unmatched ')'";
+    for (size_t i = 0; _error.empty() && i < _nodes.size(); ++i) {
+        if (_nodes[i].type == N_BACKREF && _nodes[i].value > _groups)
+            _error = "invalid backreference";
+    }
+    if (!_error.empty()) {
+        error = _error;
+        _prog.clear();
+        return false;
+    }
+
+    // Gruppo 0 = match intero, poi MATCH
+    _push(OP_SAVE, 0, 0);
+    _emit(root);
+    _push(OP_SAVE, 1, 0);
+    _push(OP_MATCH, 0, 0);
+    _nodes.clear();
+    return true;
+}
+
+bool Regex::search(const std::string& text) const {
+    return search(text.data(), text.size());
+}
+
+bool Regex::search(const char* text, size_t len) const {
+    if (_prog.empty())
+        return false;
+    if (!_hasBackrefs)
+        return _dfaSearch(text, len);
+    // Un solo budget per tutte le posizioni di partenza: il costo resta
+    // lineare nel testo anche con pattern patologici come (a|a)*b\1
+    size_t budget = (len + 1) * REGEX_BACKTRACK_BUDGET;
+    for (size_t start = 0; start <= len && budget > 0; ++start) {
+        if (_backtrackAt(text, len, start, budget))
+            return true;
+    }
+    return false;
+}
+
+// ********** PARSER **********
+
+int Regex::_newNode(NodeType type, int value) {
+    Node node;
+    node.type = type;
+    node.value = value;
+    node.min = 0;
+    node.max = 0;
+    _nodes.push_back(node);
+    return static_cast<int>(_nodes.size()) - 1;
+}
+
+int Regex::_addClass(const std::bitset<256>& set) {
+    std::bitset<256> folded = set;
+    if (_icase) {
+        for (int c = 0; c < 256; ++c) {
+            if (set[c]) {
+                folded[std::tolower(c)] = true;
+                folded[std::toupper(c)] = true;
+            }
+        }
+    }
+    _classes.push_back(folded);
+    return static_cast<int>(_classes.size()) - 1;
+}
+
+// alt := seq ('|' seq)*
+int Regex::_parseAlt() {
+    int first = _parseSeq();
+    if (_pos >= _pattern.size() || _pattern[_pos] != '|')
+        return first;
+
+    int alt = _newNode(N_ALT, 0);
+    _nodes[alt].kids.push_back(first);
+    while (_error.empty() && _pos < _pattern.size() && _pattern[_pos] == '|') {
+        ++_pos;
+        int next = _parseSeq();
+        _nodes[alt].kids.push_back(next);
+    }
+    return alt;
+}
+
+// seq := (atom quantifier?)*
+int Regex::_parseSeq() {
+    int seq = _newNode(N_CONCAT, 0);
+    while (_error.empty() && _pos < _pattern.size()
+        && _pattern[_pos] != '|' && _pattern[_pos] != ')') {
+        int atom = _parseAtom();
+        if (!_error.empty())
+            break;
+
+        // Quantificatori, anche ripetuti (a+?: il lazy non cambia l'esito)
+        while (_pos < _pattern.size()) {
+            char q = _pattern[_pos];
+            int min = 0, max = -1;
+            if (q == '*') {
+                ++_pos;
+            } else if (q == '+') {
+                min = 1;
+                ++_pos;
+            } else if (q == '?') {
+                max = 1;
+                ++_pos;
+            } else if (q == '{') {
+                if (!_parseBraces(min, max))
+                    break;
+            } else {
+                break;
+            }
+            int type = _nodes[atom].type;
+            if (type == N_BOL || type == N_EOL) {
+                _error = "nothing to repeat";
+                return seq;
+            }
+            int rep = _newNode(N_REPEAT, 0);
+            _nodes[rep].min = min;
+            _nodes[rep].max = max;
+            _nodes[rep].kids.push_back(atom);
+            atom = rep;
+            if (_pos < _pattern.size() && _pattern[_pos] == '?')
+                ++_pos;
+        }
+        _nodes[seq].kids.push_back(atom);
+    }
+    return seq;
+}
+
+// {n}, {n,}, {n,m}; altrimenti '{' è un carattere normale
+bool Regex::_parseBraces(int& min, int& max) {
+    size_t p = _pos + 1;
+    size_t digits = p;
+    int n = 0;
+    while (p < _pattern.size() && std::isdigit(static_cast<unsigned char>(_pattern[p])))
+        n = n * 10 + (_pattern[p++] - '0');
+    if (p == digits || p >= _pattern.size())
+        return false;
+    min = n;
+    max = n;
+    if (_pattern[p] == ',') {
+        ++p;
+        size_t mdigits = p;
+        int m = 0;
+        while (p < _pattern.size() && std::isdigit(static_cast<unsigned char>(_pattern[p])))
+            m = m * 10 + (_pattern[p++] - '0');
+        max = (p == mdigits) ? -1 : m;
+    }
+    if (p >= _pattern.size() || _pattern[p] != '}')
+        return false;
+    if (min > 1000 || max > 1000 || (max >= 0 && max < min)) {
+        _error = "invalid repetition count";
+        return false;
+    }
+    _pos = p + 1;
+    return true;
+}
+
+int Regex::_parseAtom() {
+    char c = _pattern[_pos];
+    std::bitset<256> set;
+
+    if (c == '(') {
+        ++_pos;
+        int group = -1;
+        if (_pattern.compare(_pos, 2, "?:") == 0)
+            _pos += 2;
+        else
+            group = ++_groups;
+        int inner = _parseAlt();
+        if (_pos >= _pattern.size() || _pattern[_pos] != ')') {
+            if (_error.empty())
+                _error = "missing ')'";
+            return inner;
+        }
+        ++_pos;
+        if (group < 0)
+            return inner;
+        int node = _newNode(N_GROUP, group);
+        _nodes[node].kids.push_back(inner);
+        return node;
+    }
+    if (c == '*' || c == '+' || c == '?') {
+        _error = "nothing to repeat";
+        return _newNode(N_EMPTY, 0);
+    }
+    ++_pos;
+    if (c == '[')
+        return _parseClass();
+    if (c == '^')
+        return _newNode(N_BOL, 0);
+    if (c == '$')
+        return _newNode(N_EOL, 0);
+    if (c == '.') {
+        set.set();
+        set['\n'] = false;
+        return _newNode(N_CLASS, _addClass(set));
+    }
+    if (c == '\\') {
+        if (_pos >= _pattern.size()) {
+            _error = "trailing backslash";
+            return _newNode(N_EMPTY, 0);
+        }
+        char e = _pattern[_pos++];
+        if (e >= '1' && e <= '9') {
+            _hasBackrefs = true;
+            return _newNode(N_BACKREF, e - '0');
+        }
+        bool isClass = false;
+        int cls = _escapeClass(e, isClass);
+        if (isClass)
+            return _newNode(N_CLASS, cls);
+        c = static_cast<char>(cls);
+    }
+    set[static_cast<unsigned char>(c)] = true;
+    return _newNode(N_CLASS, _addClass(set));
+}
+
+// \d \w \s (e negate) diventano classi, gli altri escape un carattere
+int Regex::_escapeClass(char e, bool& isClass) {
+    std::bitset<256> set;
+    isClass = true;
+    switch (e) {
+        case 'd': case 'D':
+            for (int c = '0'; c <= '9'; ++c)
+                set[c] = true;
+            break;
+        case 'w': case 'W':
+            for (int c = 0; c < 256; ++c)
+                set[c] = (std::isalnum(c) != 0 || c == '_');
+            break;
+        case 's': case 'S':
+            set[' '] = set['\t'] = set['\n'] = set['\r'] = set['\f'] = set['\v'] = true;
+            break;
+        default:
+            isClass = false;
+            if (e == 'n') return '\n';
+            if (e == 't') return '\t';
+            if (e == 'r') return '\r';
+            return static_cast<unsigned char>(e);
+    }
+    if (std::isupper(static_cast<unsigned char>(e)))
+        set.flip();
+    return _addClass(set);
+}
+
+// [abc], [^a-z], [\d_]
+int Regex::_parseClass() {
+    std::bitset<256> set;
+    bool negate = false;
+    if (_pos < _pattern.size() && _pattern[_pos] == '^') {
+        negate = true;
+        ++_pos;
+    }
+    bool first = true;
+    while (_pos < _pattern.size() && (_pattern[_pos] != ']' || first)) {
+        first = false;
+        unsigned char lo = static_cast<unsigned char>(_pattern[_pos++]);
+        if (lo == '\\' && _pos < _pattern.size()) {
+            bool isClass = false;
+            int cls = _escapeClass(_pattern[_pos++], isClass);
+            if (isClass) {
+                set |= _classes[cls];
+                _classes.pop_back();
+                continue;
+            }
+            lo = static_cast<unsigned char>(cls);
+        }
+        unsigned char hi = lo;
+        if (_pos + 1 < _pattern.size() && _pattern[_pos] == '-' && _pattern[_pos + 1] != ']') {
+            hi = static_cast<unsigned char>(_pattern[_pos + 1]);
+            _pos += 2;
+            if (hi == '\\' && _pos < _pattern.size())
+                hi = static_cast<unsigned char>(_pattern[_pos++]);
+            if (hi < lo) {
+                _error = "invalid range in character class";
+                return _newNode(N_EMPTY, 0);
+            }
+        }
+        for (int c = lo; c <= hi; ++c)
+            set[c] = true;
+    }
+    if (_pos >= _pattern.size()) {
+        _error = "missing ']'";
+        return _newNode(N_EMPTY, 0);
+    }
+    ++_pos;
+    if (negate) {
+        // La negazione va applicata dopo il folding delle maiuscole
+        int cls = _addClass(set);
+        _classes[cls].flip();
+        return _newNode(N_CLASS, cls);
+    }
+    return _newNode(N_CLASS, _addClass(set));
+}
+
+// ********** COMPILAZIONE **********
+
+int Regex::_push(Op op, int x, int y) {
+    Inst inst;
+    inst.op = op;
+    inst.x = x;
+    inst.y = y;
+    _prog.push_back(inst);
+    return static_cast<int>(_prog.size()) - 1;
+}
+
+void Regex::_emit(int index) {
+    // Copia: _nodes non cambia qui, ma i riferimenti restano semplici
+    const Node node = _nodes[index];
+    switch (node.type) {
+        case N_EMPTY:
+            break;
+        case N_CLASS:
+            _push(OP_CLASS, node.value, 0);
+            break;
+        case N_BOL:
+            _push(OP_BOL, 0, 0);
+            break;
+        case N_EOL:
+            _push(OP_EOL, 0, 0);
+            break;
+        case N_BACKREF:
+            _push(OP_BACKREF, node.value, 0);
+            break;
+        case N_CONCAT:
+            for (size_t i = 0; i < node.kids.size(); ++i)
+                _emit(node.kids[i]);
+            break;
+        case N_GROUP:
+            _push(OP_SAVE, node.value * 2, 0);
+            _emit(node.kids[0]);
+            _push(OP_SAVE, node.value * 2 + 1, 0);
+            break;
+        case N_ALT: {
+            // SPLIT a, next; a; JMP end; next: SPLIT b, ...
+            std::vector<int> jumps;
+            for (size_t i = 0; i < node.kids.size(); ++i) {
+                int split = -1;
+                if (i + 1 < node.kids.size())
+                    split = _push(OP_SPLIT, 0, 0);
+                int start = static_cast<int>(_prog.size());
+                _emit(node.kids[i]);
+                if (split >= 0) {
+                    jumps.push_back(_push(OP_JMP, 0, 0));
+                    _prog[split].x = start;
+                    _prog[split].y = static_cast<int>(_prog.size());
+                }
+            }
+            for (size_t i = 0; i < jumps.size(); ++i)
+                _prog[jumps[i]].x = static_cast<int>(_prog.size());
+            break;
+        }
+        case N_REPEAT: {
+            for (int i = 0; i < node.min; ++i)
+                _emit(node.kids[0]);
+            if (node.max < 0) {
+                // L: SPLIT body, out; body; JMP L
+                int split = _push(OP_SPLIT, 0, 0);
+                _emit(node.kids[0]);
+                _push(OP_JMP, split, 0);
+                _prog[split].x = split + 1;
+                _prog[split].y = static_cast<int>(_prog.size());
+            } else {
+                std::vector<int> splits;
+                for (int i = node.min; i < node.max; ++i) {
+                    splits.push_back(_push(OP_SPLIT, 0, 0));
+                    _prog[splits.back()].x = splits.back() + 1;
+                    _emit(node.kids[0]);
+                }
+                for (size_t i = 0; i < splits.size(); ++i)
+                    _prog[splits[i]].y = static_cast<int>(_prog.size());
+            }
+            break;
+        }
+    }
+}
+
+// ********** DFA **********
+
+// Chiusura epsilon: segue SPLIT/JMP/SAVE, ^ solo a inizio testo,
+// $ solo se followEol (fine testo); tiene CLASS, EOL e MATCH
+void Regex::_closure(const std::vector<int>& seeds, bool atStart, bool followEol,
+    std::vector<int>& out) const
+{
+    std::vector<char> seen(_prog.size(), 0);
+    std::vector<int> stack(seeds.rbegin(), seeds.rend());
+    out.clear();
+
+    while (!stack.empty()) {
+        int pc = stack.back();
+        stack.pop_back();
+        if (seen[pc])
+            continue;
+        seen[pc] = 1;
+        const Inst& inst = _prog[pc];
+        switch (inst.op) {
+            case OP_JMP:
+                stack.push_back(inst.x);
+                break;
+            case OP_SPLIT:
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case OP_SAVE:
+                stack.push_back(pc + 1);
+                break;
+            case OP_BOL:
+                if (atStart)
+                    stack.push_back(pc + 1);
+                break;
+            case OP_EOL:
+                if (followEol)
+                    stack.push_back(pc + 1);
+                else
+                    out.push_back(pc);
+                break;
+            default:
+                out.push_back(pc);
+                break;
+        }
+    }
+    std::sort(out.begin(), out.end());
+}
+
+int Regex::_intern(const std::vector<int>& pcs) const {
+    std::map<std::vector<int>, int>::const_iterator it = _stateIndex.find(pcs);
+    if (it != _stateIndex.end())
+        return it->second;
+
+    DfaState state;
+    state.pcs = pcs;
+    state.accept = false;
+    state.acceptAtEnd = false;
+    std::memset(state.next, -1, sizeof(state.next));
+
+    std::vector<int> eolSeeds;
+    for (size_t i = 0; i < pcs.size(); ++i) {
+        if (_prog[pcs[i]].op == OP_MATCH)
+            state.accept = true;
+        else if (_prog[pcs[i]].op == OP_EOL)
+            eolSeeds.push_back(pcs[i] + 1);
+    }
+    if (!eolSeeds.empty()) {
+        std::vector<int> end;
+        _closure(eolSeeds, false, true, end);
+        for (size_t i = 0; i < end.size(); ++i) {
+            if (_prog[end[i]].op == OP_MATCH)
+                state.acceptAtEnd = true;
+        }
+    }
+
+    _states.push_back(state);
+    int id = static_cast<int>(_states.size()) - 1;
+    _stateIndex[pcs] = id;
+    return id;
+}
+
+int Regex::_step(int state, unsigned char c) const {
+    int cached = _states[state].next[c];
+    if (cached >= 0)
+        return cached;
+
+    // Avanza i CLASS che accettano c e riparte da capo (ricerca non ancorata)
+    std::vector<int> seeds;
+    const std::vector<int>& pcs = _states[state].pcs;
+    for (size_t i = 0; i < pcs.size(); ++i) {
+        const Inst& inst = _prog[pcs[i]];
+        if (inst.op == OP_CLASS && _classes[inst.x][c])
+            seeds.push_back(pcs[i] + 1);
+    }
+    seeds.push_back(0);
+    std::vector<int> next;
+    _closure(seeds, false, false, next);
+
+    // Cache piena: si ricomincia tenendo solo lo stato corrente
+    if (_states.size() >= REGEX_MAX_DFA_STATES) {
+        std::vector<int> current = pcs;
+        _states.clear();
+        _stateIndex.clear();
+        _startState = -1;
+        state = _intern(current);
+    }
+    int target = _intern(next);
+    _states[state].next[c] = target;
+    return target;
+}
+
+bool Regex::_dfaSearch(const char* text, size_t len) const {
+    // Testo vuoto: inizio e fine coincidono, valgono sia ^ che $
+    if (len == 0) {
+        std::vector<int> all;
+        _closure(std::vector<int>(1, 0), true, true, all);
+        for (size_t i = 0; i < all.size(); ++i) {
+            if (_prog[all[i]].op == OP_MATCH)
+                return true;
+        }
+        return false;
+    }
+
+    if (_startState < 0) {
+        std::vector<int> start;
+        _closure(std::vector<int>(1, 0), true, false, start);
+        _startState = _intern(start);
+    }
+
+    int state = _startState;
+    for (size_t i = 0; i < len; ++i) {
+        if (_states[state].accept)
+            return true;
+        state = _step(state, static_cast<unsigned char>(text[i]));
+    }
+    return _states[state].accept || _states[state].acceptAtEnd;
+}
+
+// ********** BACKTRACKING **********
+
+bool Regex::_backtrackAt(const char* text, size_t len, size_t start, size_t& budget) const {
+    // Stack esplicito: rami da provare e catture da ripristinare
+    std::vector<long> caps((_groups + 1) * 2, -1);
+    std::vector<BacktrackFrame> stack;
+
+    BacktrackFrame first = { 0, start, 0, 0 };
+    stack.push_back(first);
+
+    while (!stack.empty()) {
+        BacktrackFrame f = stack.back();
+        stack.pop_back();
+        if (f.pc < 0) {
+            caps[f.slot] = f.old;
+            continue;
+        }
+        int pc = f.pc;
+        size_t pos = f.pos;
+
+        while (true) {
+            if (budget == 0)
+                return false;
+            --budget;
+            const Inst& inst = _prog[pc];
+            bool ok = true;
+            switch (inst.op) {
+                case OP_MATCH:
+                    return true;
+                case OP_CLASS:
+                    ok = pos < len && _classes[inst.x][static_cast<unsigned char>(text[pos])];
+                    ++pos;
+                    ++pc;
+                    break;
+                case OP_JMP:
+                    pc = inst.x;
+                    break;
+                case OP_SPLIT: {
+                    BacktrackFrame alt = { inst.y, pos, 0, 0 };
+                    stack.push_back(alt);
+                    pc = inst.x;
+                    break;
+                }
+                case OP_SAVE: {
+                    BacktrackFrame restore = { -1, 0, inst.x, caps[inst.x] };
+                    stack.push_back(restore);
+                    caps[inst.x] = static_cast<long>(pos);
+                    ++pc;
+                    break;
+                }
+                case OP_BOL:
+                    ok = (pos == 0);
+                    ++pc;
+                    break;
+                case OP_EOL:
+                    ok = (pos == len);
+                    ++pc;
+                    break;
+                case OP_BACKREF: {
+                    long s = caps[inst.x * 2];
+                    long e = caps[inst.x * 2 + 1];
+                    if (s < 0 || e < s) {
+                        ok = false;
+                        break;
+                    }
+                    // Il confronto costa un passo per carattere
+                    size_t n = static_cast<size_t>(e - s);
+                    if (n > budget) {
+                        budget = 0;
+                        return false;
+                    }
+                    budget -= n;
+                    ok = (pos + n <= len);
+                    for (size_t i = 0; ok && i < n; ++i) {
+                        unsigned char a = static_cast<unsigned char>(text[s + i]);
+                        unsigned char b = static_cast<unsigned char>(text[pos + i]);
+                        ok = _icase ? (std::tolower(a) == std::tolower(b)) : (a == b);
+                    }
+                    pos += n;
+                    ++pc;
+                    break;
+                }
+            }
+            if (!ok)
+                break;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,130 @@
+// ********** ROUTE_CACHE **********
+// LRU con revalidazione: un solo stat al posto dell'intera pipeline di routing
+
+#include "RouteCache.hpp"
+#include "Stats.hpp"
+#include <sys/stat.h>
+#include <cctype>
+
+Route::Route()
+    : server(NULL), location(NULL), kind(FILE), filePath(), contentType(),
+      dev(0), ino(0), size(0), mtime(0), ctime(0) {}
+
+RouteCache::RouteCache() : _capacity(0) {}
+
+void RouteCache::setCapacity(size_t capacity) {
+    _capacity = capacity;
+    while (_lru.size() > _capacity) {
+        const Entry& last = _lru.back();
+        _index.erase(_hash(last.listenFd, last.host, last.uri));
+        _lru.pop_back();
+    }
+}
+
+void RouteCache::clear() {
+    _lru.clear();
+    _index.clear();
+}
+
+uint64_t RouteCache::_hash(int listenFd, const std::string& host, const std::string& uri) {
+    // Host confrontato senza maiuscole, come nel VhostTable
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* fd = reinterpret_cast<const unsigned char*>(&listenFd);
+    for (size_t i = 0; i < sizeof(listenFd); ++i)
+        hash = (hash ^ fd[i]) * 1099511628211ULL;
+    for (size_t i = 0; i < host.size(); ++i)
+        hash = (hash ^ static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(host[i])))) * 1099511628211ULL;
+    // Separatore: "ab" + "c" e "a" + "bc" non devono coincidere
+    hash = (hash ^ 0xff) * 1099511628211ULL;
+    for (size_t i = 0; i < uri.size(); ++i)
+        hash = (hash ^ static_cast<unsigned char>(uri[i])) * 1099511628211ULL;
+    return hash;
+}
+
+bool RouteCache::_matches(const Entry& entry, int listenFd, const std::string& host, const std::string& uri) {
+    if (entry.listenFd != listenFd || entry.host.size() != host.size() || entry.uri != uri)
+        return false;
+    for (size_t i = 0; i < host.size(); ++i) {
+        if (entry.host[i] != std::tolower(static_cast<unsigned char>(host[i])))
+            return false;
+    }
+    return true;
+}
+
+bool RouteCache::stamp(Route& route) {
+    struct stat st;
+    if (stat(route.filePath.c_str(), &st) != 0)
+        return false;
+    route.dev = st.st_dev;
+    route.ino = st.st_ino;
+    route.size = st.st_size;
+    route.mtime = st.st_mtime;
+    route.ctime = st.st_ctime;
+    return true;
+}
+
+bool RouteCache::lookup(int listenFd, const std::string& host, const std::string& uri, Route& out) {
+    if (_capacity == 0)
+        return false;
+    std::map<uint64_t, LruList::iterator>::iterator it = _index.find(_hash(listenFd, host, uri));
+    if (it == _index.end() || !_matches(*it->second, listenFd, host, uri)) {
+        Stats::add(Stats::counters().routeMisses, 1);
+        return false;
+    }
+
+    // File cambiato, cancellato o permessi modificati: la entry decade
+    const Route& cached = it->second->route;
+    struct stat st;
+    if (stat(cached.filePath.c_str(), &st) != 0
+        || st.st_dev != cached.dev || st.st_ino != cached.ino
+        || st.st_size != cached.size || st.st_mtime != cached.mtime
+        || st.st_ctime != cached.ctime) {
+        _lru.erase(it->second);
+        _index.erase(it);
+        Stats::add(Stats::counters().metaStale, 1);
+        Stats::add(Stats::counters().routeMisses, 1);
+        return false;
+    }
+
+    Stats::add(Stats::counters().metaFresh, 1);
+    Stats::add(Stats::counters().routeHits, 1);
+    _lru.splice(_lru.begin(), _lru, it->second);
+    out = cached;
+    return true;
+}
+
+void RouteCache::store(int listenFd, const std::string& host, const std::string& uri, const Route& route) {
+    if (_capacity == 0)
+        return;
+    uint64_t hash = _hash(listenFd, host, uri);
+    std::map<uint64_t, LruList::iterator>::iterator it = _index.find(hash);
+    if (it != _index.end()) {
+        // Stessa chiave o collisione: la entry viene riscritta
+        Entry& entry = *it->second;
+        if (!_matches(entry, listenFd, host, uri)) {
+            entry.listenFd = listenFd;
+            entry.host.resize(host.size());
+            for (size_t i = 0; i < host.size(); ++i)
+                entry.host[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(host[i])));
+            entry.uri = uri;
+        }
+        entry.route = route;
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return;
+    }
+
+    _lru.push_front(Entry());
+    Entry& entry = _lru.front();
+    entry.listenFd = listenFd;
+    entry.host.resize(host.size());
+    for (size_t i = 0; i < host.size(); ++i)
+        entry.host[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(host[i])));
+    entry.uri = uri;
+    entry.route = route;
+    _index[hash] = _lru.begin();
+    if (_lru.size() > _capacity) {
+        const Entry& last = _lru.back();
+        _index.erase(_hash(last.listenFd, last.host, last.uri));
+        _lru.pop_back();
+    }
+}
@@ -1,99 +1,277 @@
 #include "Server.hpp"
-#include <iostream>
+#include "Logger.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <cstring>
 #include <cerrno>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
 #include "utils.hpp"
 #include "HttpResponse.hpp"
 #include <sys/stat.h>
+#include <fcntl.h>
 
-Server::Server() : _max_fd(0) {
-    FD_ZERO(&_master_set);
-    FD_ZERO(&_working_set);
+volatile sig_atomic_t Server::_stopRequested = 0;
+volatile sig_atomic_t Server::_reopenRequested = 0;
+volatile sig_atomic_t Server::_dumpRequested = 0;
+
+void Server::handleStopSignal(int) {
+    _stopRequested = 1;
+}
+
+void Server::handleReopenSignal(int) {
+    _reopenRequested = 1;
 }
 
+void Server::handleDumpSignal(int) {
+    _dumpRequested = 1;
+}
+
+Server::Server() : _bodyMemory(0) {}
+
 Server::~Server() {
     // Gli instances sono gestiti esternamente, non dobbiamo cancellarli qui
     
-    // Chiudi tutti i socket aperti nel master set
-    for (int fd = 0; fd <= _max_fd; ++fd) {
-        if (FD_ISSET(fd, &_master_set)) {
-            close(fd);
-        }
+    // Chiudi tutti i socket ancora osservati
+    for (size_t i = 0; i < _pollfds.size(); ++i) {
+        if (_pollfds[i].fd >= 0)
+            close(_pollfds[i].fd);
     }
 }
 
-void Server::addInstance(ServerInstance* instance, const ServerConfig& config) {
-    _instances.push_back(instance);
-    
-    // Verifica se questa configurazione è già presente
-    bool found = false;
-    for (size_t i = 0; i < _servers.size(); i++) {
-        if (_servers[i].server_name == config.server_name) {
-            found = true;
+void Server::addInstance(ServerInstance* instance, size_t serverIndex, bool isDefault) {
+    // Lo stesso socket può servire più blocchi server
+    bool known = false;
+    for (size_t i = 0; i < _instances.size(); ++i) {
+        if (_instances[i] == instance) {
+            known = true;
             break;
         }
     }
-    
-    // Aggiungi solo se non è già presente
-    if (!found) {
-        _servers.push_back(config);
-    }
+    if (!known)
+        _instances.push_back(instance);
+    
+    // Indicizza i nomi del blocco su questo listener; il primo blocco
+    // (o quello con default_server) risponde per gli Host sconosciuti
+    int fd = instance->getSocket();
+    const ServerConfig& config = _servers[serverIndex];
+    for (size_t i = 0; i < config.server_names.size(); ++i)
+        _vhosts.addName(fd, config.server_names[i], serverIndex);
+    _vhosts.setDefault(fd, serverIndex, isDefault);
 }
 
 void Server::setServers(const std::vector<ServerConfig>& servers) {
     _servers = servers;
+    // Le route puntano dentro _servers
+    _routes.clear();
 }
 
-void Server::_initializeSets() {
-    FD_ZERO(&_master_set);
-    _max_fd = 0;
-    
-    // Aggiungi tutti i socket di ascolto al master set
-    for (size_t i = 0; i < _instances.size(); ++i) {
-        int sockfd = _instances[i]->getSocket();
-        FD_SET(sockfd, &_master_set);
-        if (sockfd > _max_fd)
-            _max_fd = sockfd;
+void Server::setGlobalConfig(const GlobalConfig& global) {
+    _global = global;
+    // Le route copiano i tipi MIME della configurazione precedente
+    _routes.clear();
+    _routes.setCapacity(global.route_cache_size);
+}
+
+// poll(): a differenza di select non ha il limite di FD_SETSIZE (1024) fd
+void Server::_initializePoll() {
+    _pollfds.clear();
+    _pollSlot.clear();
+    
+    // Aggiungi tutti i socket di ascolto
+    for (size_t i = 0; i < _instances.size(); ++i)
+        _watch(_instances[i]->getSocket());
+}
+
+void Server::_watch(int fd) {
+    struct pollfd entry;
+    entry.fd = fd;
+    entry.events = POLLIN;
+    entry.revents = 0;
+    if (static_cast<size_t>(fd) >= _pollSlot.size())
+        _pollSlot.resize(fd + 1, static_cast<size_t>(-1));
+    _pollSlot[fd] = _pollfds.size();
+    _pollfds.push_back(entry);
+}
+
+// La entry resta fino a _compactPoll: il giro in corso non si sposta
+void Server::_unwatch(int fd) {
+    if (static_cast<size_t>(fd) >= _pollSlot.size() || _pollSlot[fd] == static_cast<size_t>(-1))
+        return;
+    _pollfds[_pollSlot[fd]].fd = -1;
+    _pollSlot[fd] = static_cast<size_t>(-1);
+}
+
+void Server::_compactPoll() {
+    size_t kept = 0;
+    for (size_t i = 0; i < _pollfds.size(); ++i) {
+        if (_pollfds[i].fd < 0)
+            continue;
+        _pollfds[kept] = _pollfds[i];
+        _pollSlot[_pollfds[kept].fd] = kept;
+        ++kept;
     }
+    _pollfds.resize(kept);
 }
 
 void Server::run() {
-    _initializeSets();
+    _initializePoll();
+
+    // Directory degli upload create una volta, writer avviato fuori dal loop
+    std::vector<std::string> uploadDirs(1, UPLOAD_DEFAULT_DIR);
+    for (size_t i = 0; i < _servers.size(); ++i) {
+        for (size_t j = 0; j < _servers[i].locations.size(); ++j) {
+            const LocationConfig& loc = _servers[i].locations[j];
+            uploadDirs.insert(uploadDirs.end(), loc.upload_dirs.begin(), loc.upload_dirs.end());
+        }
+    }
+    for (size_t i = 0; i < uploadDirs.size(); ++i) {
+        if (!ensureDirectory(uploadDirs[i]))
+            LOG_ERROR("Impossibile creare " << uploadDirs[i]);
+    }
+    _uploadWriter.start(_global.upload_threads,
+        static_cast<UploadWriter::Durability>(_global.upload_durability),
+        _global.upload_sync_batch);
+    _uploadStore.setWriter(&_uploadWriter);
+
+    LOG_NOTICE("Server in esecuzione, in attesa di connessioni...");
+
+    while (!_stopRequested) {
+        for (size_t i = 0; i < _pollfds.size(); ++i)
+            _pollfds[i].events = POLLIN;
 
-    std::cout << "Server in esecuzione, in attesa di connessioni..." << std::endl;
+        // Backpressure: oltre il budget globale i body in memoria non
+        // vengono più letti finché qualcuno non libera spazio
+        bool throttled = _bodyMemory >= _global.body_memory_limit;
+        if (throttled)
+            _pauseBodyReaders();
+        int timeout = throttled ? 100 : -1;
 
-    while (1) {
-        _working_set = _master_set;  // Copia il master set
+        // Righe di access log in attesa: la poll non dorme oltre il flush
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        long flushMs = _accessLog.msUntilFlush(now);
+        if (flushMs >= 0 && (!throttled || flushMs < 100))
+            timeout = static_cast<int>(flushMs);
 
         // Attendi attività sui socket
-        if (select(_max_fd + 1, &_working_set, NULL, NULL, NULL) < 0) {
-            std::cerr << "select() fallita" << std::endl;
+        int ready = poll(&_pollfds[0], _pollfds.size(), timeout);
+        gettimeofday(&now, NULL);
+        _accessLog.flushIfDue(now);
+        if (_reopenRequested) {
+            _reopenRequested = 0;
+            _reopenLogs();
+        }
+        if (_dumpRequested) {
+            _dumpRequested = 0;
+            Stats::dumpHistograms();
+        }
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;   // segnale: il while ricontrolla _stopRequested
+            LOG_CRIT("poll() fallita: " << strerror(errno));
             break;
         }
+        if (ready == 0 && throttled) {
+            // Nessun progresso: sposta su disco il body più grande
+            _spillLargestBody();
+            continue;
+        }
 
-        // Controlla tutti i socket per attività
-        for (int i = 0; i <= _max_fd; ++i) {
-            if (FD_ISSET(i, &_working_set)) {
-                // Controlla se è un socket di ascolto
-                bool is_listener = false;
-                for (size_t j = 0; j < _instances.size(); ++j) {
-                    if (_instances[j]->getSocket() == i) {
-                        is_listener = true;
-                        _handleNewConnection(i);
-                        break;
-                    }
-                }
+        // Controlla tutti i socket per attività; le connessioni accettate
+        // in questo giro finiscono in coda e aspettano la prossima poll
+        size_t watched = _pollfds.size();
+        for (size_t i = 0; i < watched; ++i) {
+            int fd = _pollfds[i].fd;
+            if (fd < 0 || _pollfds[i].revents == 0)
+                continue;
 
-                // Se non è un socket di ascolto, è un client
-                if (!is_listener) {
-                    _handleClientData(i);
+            // Controlla se è un socket di ascolto
+            bool is_listener = false;
+            for (size_t j = 0; j < _instances.size(); ++j) {
+                if (_instances[j]->getSocket() == fd) {
+                    is_listener = true;
+                    _handleNewConnection(fd);
+                    break;
                 }
             }
+
+            // Se non è un socket di ascolto, è un client
+            if (!is_listener) {
+                _handleClientData(fd);
+            }
         }
+        _compactPoll();
+    }
+    if (_stopRequested)
+        LOG_NOTICE("Segnale di arresto ricevuto, chiusura del server");
+    _accessLog.flush();
+}
+
+bool Server::openAccessLog(std::string& error) {
+    if (_global.access_log.empty())
+        return true;
+    if (!_accessLog.compile(_global.access_log_format, error))
+        return false;
+    return _accessLog.open(_global.access_log, error);
+}
+
+bool Server::openCapture(std::string& error) {
+    if (_global.capture.empty())
+        return true;
+    if (!_capture.open(_global.capture, _global.capture_sample, _global.capture_max_size, error))
+        return false;
+    LOG_NOTICE("Cattura delle richieste in " << _global.capture << " (1 connessione ogni "
+        << _global.capture_sample << ", max " << _global.capture_max_size << " byte)");
+    return true;
+}
+
+// SIGUSR1: dopo una rotazione i log ripartono da file nuovi
+void Server::_reopenLogs() {
+    std::string error;
+    if (!_accessLog.reopen(error))
+        LOG_ERROR(error);
+    Logger::reopen();
+    LOG_NOTICE("Log riaperti");
+}
+
+// Ogni risposta finale passa da qui: status e byte servono all'access log.
+// total = byte dell'intera risposta se seguono blocchi con _sendMore
+bool Server::_send(int client_fd, const char* data, size_t length, int status, size_t total) {
+    (void)total;    // solo per la tracepoint, senza USDT resta inutilizzato
+    TRACE_RESPONSE_START(client_fd, status, total ? total : length);
+    std::map<int, Client>::iterator it = _clients.find(client_fd);
+    if (it != _clients.end()) {
+        if (it->second.status == 0 && it->second.startTime.tv_sec != 0)
+            Stats::record(PHASE_FIRST_BYTE, usecSince(it->second.startTime));
+        Stats::transition(it->second.phase, CONN_WRITING);
+        it->second.status = status;
+    }
+    return _sendMore(client_fd, data, length);
+}
+
+// Contratto comune a tutti i blocchi: send parziali e interrotte vengono
+// ritentate, i byte usciti vanno nel conto del client anche se poi fallisce.
+// true solo se il blocco è partito tutto. MSG_NOSIGNAL: un client che
+// chiude a metà risposta dà EPIPE, non SIGPIPE
+bool Server::_sendMore(int client_fd, const char* data, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t sent = send(client_fd, data + done, length - done, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            break;
+        done += static_cast<size_t>(sent);
     }
+    std::map<int, Client>::iterator it = _clients.find(client_fd);
+    if (it != _clients.end())
+        it->second.bytesSent += done;
+    return done == length;
 }
 
 void Server::_handleNewConnection(int listen_fd) {
@@ -102,281 +280,619 @@ void Server::_handleNewConnection(int listen_fd) {
 
     int new_fd = accept(listen_fd, (struct sockaddr*)&client_addr, &addr_len);
     if (new_fd < 0) {
-        std::cerr << "accept() fallita" << std::endl;
+        LOG_ERROR("accept() fallita");
         return;
     }
 
-    // Aggiungi il nuovo client al master set
-    FD_SET(new_fd, &_master_set);
-    if (new_fd > _max_fd)
-        _max_fd = new_fd;
+    // Il listener serve per scegliere il virtual host
+    Client& client = _clients[new_fd];
+    client.listenFd = listen_fd;
+    client.address = client_addr;
+    gettimeofday(&client.acceptTime, NULL);
+    client.capturing = _capture.sample();
+    Stats::opened(client.phase);
+    TRACE_ACCEPT(new_fd, listen_fd);
+    
+    // Aggiungi il nuovo client alla poll
+    _watch(new_fd);
 
-    std::cout << "Nuova connessione, socket fd: " << new_fd << std::endl;
+    LOG_DEBUG("Nuova connessione, socket fd: " << new_fd);
 }
 
 void Server::_handleClientData(int client_fd) {
-    char buffer[4096];
-    int bytes_read = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
+    Client& client = _clients[client_fd];
+    
+    // Il buffer si prende solo quando arrivano dati: chi resta fermo non ne
+    // tiene. Negli header si accumula, nel body è solo appoggio per la recv
+    IoBuffer& input = client.input;
+    if (!input.data && !_buffers.acquire(input, BUFFER_POOL_MIN)) {
+        LOG_ERROR("Nessun buffer di ricezione per il socket " << client_fd);
+        _closeClient(client_fd);
+        return;
+    }
+    if (client.state == Client::READING_HEADERS && input.length == input.capacity
+        && !_buffers.grow(input, CLIENT_MAX_HEADER_SIZE)) {
+        LOG_ERROR("Nessun buffer di ricezione per il socket " << client_fd);
+        _closeClient(client_fd);
+        return;
+    }
+    char* buffer = input.data + input.length;
+    int bytes_read = recv(client_fd, buffer, input.capacity - input.length, 0);
 
     if (bytes_read <= 0) {
         // Connessione chiusa o errore
         if (bytes_read == 0)
-            std::cout << "Socket " << client_fd << " ha chiuso la connessione" << std::endl;
+            LOG_DEBUG("Socket " << client_fd << " ha chiuso la connessione");
         else
-            std::cerr << "recv() fallita su socket " << client_fd << std::endl;
+            LOG_INFO("recv() fallita su socket " << client_fd);
         
-        close(client_fd);
-        FD_CLR(client_fd, &_master_set);
+        _closeClient(client_fd);
         return;
     }
     
-    // Aggiungi terminatore di stringa e converti in std::string
-    buffer[bytes_read] = '\0';
-    std::string rawRequest(buffer, bytes_read);
-    
-    // Stampa la richiesta per debug
-    std::cout << "Richiesta ricevuta (fd=" << client_fd << "):" << std::endl;
-    std::cout << rawRequest << std::endl;
-    
-    // Parsa la richiesta
-    HttpRequest request;
-    std::string errorMsg;
+    client.bytesReceived += static_cast<size_t>(bytes_read);
+    Stats::add(Stats::counters().bytesIn, static_cast<unsigned long>(bytes_read));
+    Stats::transition(client.phase, CONN_READING);
+    if (client.capturing) {
+        // Richieste oltre il limite non si catturano: replicarle a metà non serve
+        if (client.captured.size() + bytes_read <= CAPTURE_RECORD_MAX)
+            client.captured.append(buffer, bytes_read);
+        else {
+            client.capturing = false;
+            std::string().swap(client.captured);
+        }
+    }
     
-    if (!HttpRequest::parse(rawRequest, request, errorMsg)) {
-        // Parsing fallito, invia errore 400 Bad Request
-        _sendError(client_fd, 400, "Bad Request", errorMsg);
-        close(client_fd);
-        FD_CLR(client_fd, &_master_set);
+    // 1. Header: finché non sono completi non si fa altro
+    if (client.state == Client::READING_HEADERS) {
+        if (client.startTime.tv_sec == 0) {
+            gettimeofday(&client.startTime, NULL);
+            Stats::record(PHASE_WAIT, elapsedUsec(client.acceptTime, client.startTime));
+        }
+        input.length += static_cast<size_t>(bytes_read);
+        if (!_processHeaders(client_fd, client))
+            return; // header incompleti oppure richiesta già rifiutata
+        
+        // I byte dopo gli header sono già body
+        bool stored = _storeBody(client, input.data, input.length);
+        input.length = 0;
+        if (!stored) {
+            _sendError(client_fd, client, 500, "Cannot buffer request body");
+            _closeClient(client_fd);
+            return;
+        }
+    }
+    // 2. Body: si legge solo se la richiesta ha superato i controlli
+    else if (!_storeBody(client, buffer, bytes_read)) {
+        _sendError(client_fd, client, 500, "Cannot buffer request body");
+        _closeClient(client_fd);
         return;
     }
     
-    // Handle different HTTP methods
-    if (request.getMethod() == "GET") {
-        _handleGetRequest(client_fd, request);
-    } else if (request.getMethod() == "HEAD") {
-        _handleHeadRequest(client_fd, request);
-    } else if (request.getMethod() == "POST") {
-        _handlePostRequest(client_fd, request);
-    } else if (request.getMethod() == "DELETE") {
-        _handleDeleteRequest(client_fd, request);
-    } else {
-        _sendError(client_fd, 405, "Method Not Allowed", "Only GET, HEAD, POST and DELETE methods are currently supported");
-    }
+    if (client.bodyReceived < client.bodyExpected)
+        return;
     
-    close(client_fd);
-    FD_CLR(client_fd, &_master_set);
+    _dispatchRequest(client_fd, client);
+    _closeClient(client_fd);
 }
 
-const LocationConfig* Server::_findLocationMatch(const std::string& uri, const ServerConfig& server) const {
-    std::cout << "Matching location per URI: '" << uri << "'" << std::endl;
-    
-    // Prima cerca match esatto
-    for (size_t i = 0; i < server.locations.size(); ++i) {
-        if (uri == server.locations[i].path) {
-            std::cout << "Match esatto trovato: " << server.locations[i].path << std::endl;
-            return &server.locations[i];
+bool Server::_processHeaders(int client_fd, Client& client) {
+    IoBuffer& input = client.input;
+    static const char terminator[] = "\r\n\r\n";
+    const char* end = std::search(input.data, input.data + input.length, terminator, terminator + 4);
+    if (longestLine(input.data, end - input.data) > CLIENT_MAX_HEADER_LINE) {
+        _sendError(client_fd, client, 400, "Request header line too large");
+        _closeClient(client_fd);
+        return false;
+    }
+    if (end == input.data + input.length) {
+        // Il buffer degli header non cresce oltre il limite: pieno = rifiuto
+        if (input.length >= CLIENT_MAX_HEADER_SIZE) {
+            _sendError(client_fd, client, 400, "Request header too large");
+            _closeClient(client_fd);
         }
+        return false;
     }
     
-    // Poi cerca il prefisso più lungo
-    std::string bestMatch = "";
-    const LocationConfig* bestLocation = NULL;
+    // Stampa la richiesta per debug (solo header, mai il body)
+    size_t headerEnd = static_cast<size_t>(end - input.data);
+    LOG_DEBUG("Richiesta ricevuta (fd=" << client_fd << "):\n" << std::string(input.data, headerEnd));
     
-    for (size_t i = 0; i < server.locations.size(); ++i) {
-        std::string locPath = server.locations[i].path;
-        
-        // Caso speciale per "/"
-        if (locPath == "/") {
-            if (bestMatch.empty()) {
-                bestMatch = "/";
-                bestLocation = &server.locations[i];
-            }
-            continue;
-        }
-        
-        // Verifica se l'URI inizia con il path della location
-        if (uri.find(locPath) == 0) {
-            // Se la location non termina con /, verifica che l'URI abbia / o sia uguale
-            if (locPath[locPath.length()-1] != '/') {
-                // Se l'URI è più lungo, deve avere / dopo il prefisso
-                if (uri.length() > locPath.length() && uri[locPath.length()] != '/') {
-                    continue; // Non è un match valido
-                }
-            } else {
-                // Location termina con /, l'URI deve essere uguale o iniziare con questo prefisso
-                // Accettiamo sia /uploads/ che /uploads/file.txt
-                if (uri.length() < locPath.length()) {
-                    continue; // URI troppo corto per matchare
-                }
-            }
-            
-            // Prendiamo il match più lungo
-            if (locPath.length() > bestMatch.length()) {
-                bestMatch = locPath;
-                bestLocation = &server.locations[i];
-            }
-        }
+    // Parsa request line e header
+    struct timeval phaseStart;
+    gettimeofday(&phaseStart, NULL);
+    std::string errorMsg;
+    if (!HttpRequest::parseHeaders(std::string(input.data, headerEnd), client.request, errorMsg)) {
+        // Parsing fallito, invia errore 400 Bad Request
+        _sendError(client_fd, client, 400, errorMsg);
+        _closeClient(client_fd);
+        return false;
     }
-    
-    if (bestLocation) {
-        std::cout << "Best location match: " + bestMatch;
+    // Nel buffer restano solo i byte di body già arrivati
+    input.length -= headerEnd + 4;
+    std::memmove(input.data, end + 4, input.length);
+    TRACE_REQUEST_PARSED(client_fd, client.request.getMethod().c_str(), client.request.getUri().c_str());
+    
+    // Path canonico una volta sola: routing, cache e handler vedono lo stesso
+    if (!_canonicalizePath(client_fd, client)) {
+        _closeClient(client_fd);
+        return false;
+    }
+    Stats::record(PHASE_PARSE, usecSince(phaseStart));
+    gettimeofday(&phaseStart, NULL);
+    
+    // GET/HEAD ripetute: la route in cache salta vhost, location e filesystem
+    const std::string& method = client.request.getMethod();
+    if ((method == "GET" || method == "HEAD")
+        && _routes.lookup(client.listenFd, client.request.getHeader("host"),
+            client.request.getPath(), client.route)) {
+        client.server = client.route.server;
+        client.location = client.route.location;
     } else {
-        std::cout << "Nessuna location trovata per URI: " + uri;
+        // Risolve vhost e location prima di accettare il body
+        client.server = _findServer(client);
+        if (client.server)
+            client.location = _findLocationMatch(client.request.getPath(), *client.server);
     }
-    
-    return bestLocation;
-}
-
-std::string Server::_getFilePath(const std::string& uri, const LocationConfig* location) {
-    if (!location) {
-        std::cout << "Nessuna location trovata, usando path predefinito" << std::endl;
-        return joinPaths("./", uri.substr(1)); // Rimuovi lo slash iniziale
+    Stats::record(PHASE_ROUTE, usecSince(phaseStart));
+    TRACE_ROUTE_RESOLVED(client_fd, client.request.getPath().c_str(),
+        client.location ? client.location->path.c_str() : "");
+    
+    // limit_except per ogni metodo, prima di servire qualsiasi cosa: anche
+    // GET e HEAD senza body e quelle risolte dalla route in cache. DELETE
+    // non ammesso resta il 403 di _handleDeleteRequest
+    if (client.location && method != "DELETE" && !(client.location->methods & methodBit(method))) {
+        _sendError(client_fd, client, 405, method + " not allowed for this location");
+        _closeClient(client_fd);
+        return false;
     }
     
-    std::string root = location->root;
-    std::string path = uri;
+    // return: risposta già pronta, prima del filesystem e senza leggere il body
+    if (client.location && client.location->redirect.code()) {
+        _sendReturn(client_fd, client);
+        _closeClient(client_fd);
+        return false;
+    }
     
-    // Ottieni il path relativo rimuovendo il prefisso della location
-    if (path.find(location->path) == 0) {
-        if (location->path != "/") {
-            path = path.substr(location->path.length());
-            if (path.empty() || path[0] != '/')
-                path = "/" + path;
-        }
+    // stub_status: contatori in memoria, nessun body da leggere
+    if (client.location && client.location->stub_status != STATUS_OFF) {
+        _sendStatus(client_fd, client);
+        _closeClient(client_fd);
+        return false;
     }
     
-    // Gestione directory e index
-    if (path.empty() || path == "/") {
-        // Se autoindex è abilitato, non cercare index file
-        if (location->autoindex) {
-            // Per autoindex, usa il path della location come directory
-            if (location->path != "/") {
-                path = location->path;
-            } else {
-                path = "/";
-            }
-        } else {
-            if (!location->index.empty())
-                path = "/" + location->index;
-            else
-                path = "/index.html";
-        }
+    // Rifiuta subito 413: il body non viene letto né salvato
+    if (!_checkBodyAllowed(client_fd, client)) {
+        _closeClient(client_fd);
+        return false;
     }
     
-    // Rimuovi lo slash iniziale per il join
-    if (!path.empty() && path[0] == '/')
-        path = path.substr(1);
-        
-    std::string fullPath = joinPaths(root, path);
-    std::cout << "URI: " << uri << ", Root: " << root 
-              << ", Path: " << path << ", FullPath: " << fullPath << std::endl;
+    client.bodyExpected = client.request.getContentLength();
+    client.state = Client::READING_BODY;
     
-    return fullPath;
+    // Expect: 100-continue, i limiti sono già stati verificati
+    if (client.request.hasHeader("expect") && !_handleExpect(client_fd, client)) {
+        _closeClient(client_fd);
+        return false;
+    }
+    return true;
 }
 
-void Server::_handleGetRequest(int client_fd, const HttpRequest& request) {
-    std::cout << "GET " << request.getPath() << std::endl;
-    
-    // 1. Trova il server config che gestisce questo host
-    const ServerConfig* server = NULL;
-    std::string host = request.getHeader("host");
-    
-    // Rimuovi la porta dall'header host, se presente
-    size_t colonPos = host.find(':');
-    if (colonPos != std::string::npos)
-        host = host.substr(0, colonPos);
-    
-    // Debug
-    std::cout << "Cercando server per host: '" << host << "'" << std::endl;
+bool Server::_canonicalizePath(int client_fd, Client& client) {
+    const std::string& path = client.request.getPath();
+    char canonical[CANONICAL_PATH_MAX];
+    size_t length = 0;
+    
+    PathStatus status = canonicalizePath(path.data(), path.size(), canonical, sizeof(canonical), length);
+    if (status == PATH_INVALID || status == PATH_ESCAPES_ROOT) {
+        // Per GET/HEAD un path così non esiste; gli altri metodi lo vedono
+        // come richiesta malformata o tentativo di traversal
+        const std::string& method = client.request.getMethod();
+        client.server = _findServer(client);
+        if (method == "GET" || method == "HEAD")
+            _sendError(client_fd, client, 404, path);
+        else if (status == PATH_INVALID)
+            _sendError(client_fd, client, 400, "invalid request path");
+        else
+            _sendError(client_fd, client, 403, "directory traversal attempt");
+        return false;
+    }
+    client.pathRewritten = (status == PATH_REWRITTEN);
+    client.request.setPath(canonical, length);
+    return true;
+}
+
+bool Server::_handleExpect(int client_fd, const Client& client) {
+    std::string expect = client.request.getHeader("expect");
+    for (size_t i = 0; i < expect.size(); ++i)
+        expect[i] = static_cast<char>(std::tolower(expect[i]));
+    
+    if (expect != "100-continue") {
+        _sendError(client_fd, client, 417, "Unsupported Expect value");
+        return false;
+    }
     
-    // Trova il server config corrispondente
-    for (size_t i = 0; i < _servers.size(); ++i) {
-        if (_servers[i].server_name == host) {
-            server = &_servers[i];
-            std::cout << "Trovato server per host: " << host << std::endl;
-            break;
+    // Il client aspetta il via libera solo se il body non è già arrivato
+    if (client.request.getVersion() == "HTTP/1.1"
+        && client.bodyExpected > 0 && client.input.length == 0) {
+        const char continueLine[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        send(client_fd, continueLine, sizeof(continueLine) - 1, MSG_NOSIGNAL);
+    }
+    return true;
+}
+
+bool Server::_storeBody(Client& client, const char* data, size_t len) {
+    // Oltre Content-Length non si accumula nulla
+    size_t remaining = client.bodyExpected - client.bodyReceived;
+    if (len > remaining)
+        len = remaining;
+    if (len == 0)
+        return true;
+    
+    // Sopra client_body_buffer_size il body passa su disco
+    if (client.bodyFd < 0
+        && client.buffer.size() + len > _getBodyBufferSize(client.location)
+        && !_spillBody(client))
+        return false;
+    
+    if (client.bodyFd >= 0) {
+        const char* p = data;
+        size_t left = len;
+        while (left > 0) {
+            ssize_t n = write(client.bodyFd, p, left);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                LOG_ERROR("Errore scrittura body temporaneo: " << strerror(errno));
+                return false;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+    } else {
+        client.buffer.append(data, len);
+        client.bodyInMemory += len;
+        _bodyMemory += len;
+    }
+    client.bodyReceived += len;
+    return true;
+}
+
+bool Server::_spillBody(Client& client) {
+    std::string tmpl = _global.body_temp_path + "/webserv_body_XXXXXX";
+    std::vector<char> path(tmpl.begin(), tmpl.end());
+    path.push_back('\0');
+    
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        LOG_ERROR("mkstemp() fallita in " << _global.body_temp_path << ": " << strerror(errno));
+        return false;
+    }
+    // Il file sparisce alla chiusura del descrittore, anche in caso di crash
+    unlink(&path[0]);
+    
+    // Sposta su disco quanto già ricevuto e libera la memoria
+    const char* p = client.buffer.data();
+    size_t left = client.buffer.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            close(fd);
+            return false;
         }
+        p += n;
+        left -= static_cast<size_t>(n);
     }
+    _bodyMemory -= client.bodyInMemory;
+    client.bodyInMemory = 0;
+    std::string().swap(client.buffer);
+    client.bodyFd = fd;
+    return true;
+}
+
+void Server::_pauseBodyReaders() {
+    for (std::map<int, Client>::const_iterator it = _clients.begin(); it != _clients.end(); ++it) {
+        if (it->second.state == Client::READING_BODY && it->second.bodyFd < 0)
+            _pollfds[_pollSlot[it->first]].events = 0;
+    }
+}
+
+void Server::_spillLargestBody() {
+    Client* largest = NULL;
+    for (std::map<int, Client>::iterator it = _clients.begin(); it != _clients.end(); ++it) {
+        if (it->second.bodyInMemory > 0 && it->second.bodyFd < 0
+            && (!largest || it->second.bodyInMemory > largest->bodyInMemory))
+            largest = &it->second;
+    }
+    if (largest)
+        _spillBody(*largest);
+}
+
+size_t Server::_getBodyBufferSize(const LocationConfig* location) const {
+    // Valore già ereditato dal server in fase di parsing
+    if (location && location->body_buffer_size > 0)
+        return location->body_buffer_size;
+    return CLIENT_BODY_BUFFER_SIZE;
+}
+
+void Server::_dispatchRequest(int client_fd, Client& client) {
+    HttpRequest& request = client.request;
+    if (client.bodyFd >= 0)
+        request.setBodyFile(client.bodyFd, client.bodyReceived);
+    else if (client.bodyExpected > 0)
+        request.setBody(client.buffer);
     
-    // Se non troviamo un server specifico, usa il primo
-    if (!server && !_servers.empty()) {
-        server = &_servers[0];
-        std::cout << "Nessuna corrispondenza, usando server predefinito" << std::endl;
+    // Handle different HTTP methods
+    if (request.getMethod() == "GET") {
+        _handleGetRequest(client_fd, client);
+    } else if (request.getMethod() == "HEAD") {
+        _handleHeadRequest(client_fd, client);
+    } else if (request.getMethod() == "POST") {
+        _handlePostRequest(client_fd, client);
+    } else if (request.getMethod() == "DELETE") {
+        _handleDeleteRequest(client_fd, client);
+    } else {
+        _sendError(client_fd, client, 405, "Only GET, HEAD, POST and DELETE methods are currently supported");
     }
+}
+
+void Server::_closeClient(int client_fd) {
+    std::map<int, Client>::iterator it = _clients.find(client_fd);
+    if (it != _clients.end()) {
+        if (it->second.status != 0) {
+            // Dopo l'ultimo blocco, una volta per risposta
+            TRACE_RESPONSE_COMPLETE(client_fd, it->second.status, it->second.bytesSent);
+            Stats::response(it->second.status, it->second.bytesSent);
+            if (it->second.fsUsec >= 0)
+                Stats::record(PHASE_FS, it->second.fsUsec);
+            Stats::record(PHASE_TOTAL, usecSince(it->second.startTime));
+            if (_accessLog.enabled())
+                _accessLog.write(it->second);
+        }
+        if (it->second.capturing && !it->second.captured.empty())
+            _recordCapture(client_fd, it->second);
+        Stats::closed(it->second.phase);
+        TRACE_CONNECTION_CLOSE(client_fd, it->second.bytesReceived, it->second.bytesSent);
+        _bodyMemory -= it->second.bodyInMemory;
+        if (it->second.bodyFd >= 0)
+            close(it->second.bodyFd);
+        _buffers.release(it->second.input);
+    }
+    close(client_fd);
+    _unwatch(client_fd);
+    _clients.erase(client_fd);
+}
+
+// Record con la porta locale del listener: il replay la usa per il vhost
+void Server::_recordCapture(int client_fd, const Client& client) {
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    int port = 0;
+    if (getsockname(client_fd, reinterpret_cast<struct sockaddr*>(&local), &len) == 0)
+        port = ntohs(local.sin_port);
+    if (!_capture.record(port, client.startTime, client.captured))
+        LOG_NOTICE("Cattura in " << _global.capture << " terminata: max_size raggiunto o write fallita");
+}
+
+const ServerConfig* Server::_findServer(const Client& client) const {
+    // Lookup O(1) su (listener, host), con default per listener
+    long index = _vhosts.find(client.listenFd, client.request.getHeader("host"));
+    if (index >= 0)
+        return &_servers[index];
     
-    // 2. Trova il location block che combacia con l'URI
-    const LocationConfig* location = NULL;
-    if (server)
-        location = _findLocationMatch(request.getPath(), *server);
+    // Se non troviamo un server specifico, usa il primo
+    if (!_servers.empty())
+        return &_servers[0];
+    return NULL;
+}
+
+bool Server::_checkBodyAllowed(int client_fd, const Client& client) {
+    const HttpRequest& request = client.request;
+    size_t contentLength = request.getContentLength();
     
-    // 3. Ottieni il path del file
-    std::string filePath = _getFilePath(request.getPath(), location);
+    // Solo le richieste che portano un body passano da qui; il metodo è
+    // già stato verificato subito dopo il routing
+    if (request.getMethod() != "POST" && contentLength == 0)
+        return true;
     
-    // 4. Verifica che il file esista e sia leggibile
-    if (!fileExists(filePath)) {
-        _sendNotFound(client_fd, request.getPath());
-        return;
+    // Verifica content length limit (già ereditato dal server)
+    const LocationConfig* location = client.location;
+    if (location && location->max_body_size > 0 && contentLength > location->max_body_size) {
+        _sendError(client_fd, client, 413, "Request body too large");
+        return false;
+    }
+    return true;
+}
+
+const LocationConfig* Server::_findLocationMatch(const std::string& uri, const ServerConfig& server) const {
+    // Precedenza nginx: "=" esatta, poi prefisso più lungo se "^~",
+    // poi la prima regex che fa match, infine il prefisso più lungo
+    bool exact = false;
+    long index = server.locationTrie.match(uri, &exact);
+    if (index >= 0 && (exact || server.locations[index].modifier == LOCATION_PREFIX_NOREGEX))
+        return &server.locations[index];
+
+    for (size_t i = 0; i < server.regexLocations.size(); ++i) {
+        const LocationConfig& loc = server.locations[server.regexLocations[i]];
+        if (loc.regex.search(uri))
+            return &loc;
+    }
+    if (index < 0)
+        return &server.fallback;
+    return &server.locations[index];
+}
+
+std::string Server::_getFilePath(const std::string& uri, const LocationConfig* location) {
+    // Root già normalizzata ed ereditata: root + URI completo, come
+    // nginx, per tutti i metodi
+    if (location->alias.empty()) {
+        std::string fullPath = joinPaths(location->root, uri);
+        LOG_DEBUG("URI: " << uri << ", Root: " << location->root
+            << ", FullPath: " << fullPath);
+        return fullPath;
     }
     
-    // 5. Controlla se è una directory
-    if (isDirectory(filePath)) {
-        // Verifica se autoindex è abilitato
-        bool autoindex = location && location->autoindex;
-        
-        if (autoindex) {
-            _sendAutoindex(client_fd, filePath, request.getPath());
+    // alias: il prefisso della location è sostituito. Il resto deve
+    // iniziare da un segmento nuovo, altrimenti /upload.. diventerebbe
+    // alias + "/.." fuori dalla directory
+    std::string rest = uri.substr(std::min(location->path.size(), uri.size()));
+    if (!rest.empty() && rest[0] != '/' && location->path[location->path.size() - 1] != '/')
+        return "";
+    std::string fullPath = joinPaths(location->alias, rest);
+    LOG_DEBUG("URI: " << uri << ", Alias: " << location->alias
+        << ", FullPath: " << fullPath);
+    return fullPath;
+}
+
+int Server::_resolveRoute(const Client& client, Route& route) {
+    route.server = client.server;
+    route.location = client.location;
+    if (!client.location)
+        return 404;
+    
+    // Path del file e verifica che esista
+    const LocationConfig* location = client.location;
+    route.filePath = _getFilePath(client.request.getPath(), location);
+    if (!fileExists(route.filePath))
+        return 404;
+    
+    if (isDirectory(route.filePath)) {
+        // Prova con l'index file, poi l'autoindex
+        std::string indexPath = joinPaths(route.filePath, location->index);
+        if (fileExists(indexPath) && !isDirectory(indexPath) && isReadable(indexPath)) {
+            route.kind = Route::FILE;
+            route.filePath = indexPath;
+        } else if (location->autoindex) {
+            route.kind = Route::AUTOINDEX;
         } else {
-            // Prova con l'index file
-            std::string indexPath = joinPaths(filePath, location && !location->index.empty() ? 
-                                               location->index : "index.html");
-            
-            if (fileExists(indexPath) && isReadable(indexPath)) {
-                _sendFile(client_fd, indexPath);
-            } else {
-                _sendForbidden(client_fd, request.getPath());
-            }
+            route.kind = Route::FORBIDDEN;
         }
-        return;
+    } else if (!isReadable(route.filePath)) {
+        LOG_DEBUG("File non leggibile: " << route.filePath);
+        route.kind = Route::FORBIDDEN;
+    } else {
+        route.kind = Route::FILE;
     }
+    route.contentType = (route.kind == Route::FILE) ? _global.mime_types.lookup(route.filePath) : "text/html";
     
-    // 6. Verifica permessi di lettura
-    if (!isReadable(filePath)) {
-        std::cout << "File non leggibile: " << filePath << std::endl;
-        _sendForbidden(client_fd, request.getPath());
-        return;
+    // Le richieste successive per lo stesso URI saltano tutto il routing
+    if (RouteCache::stamp(route))
+        _routes.store(client.listenFd, client.request.getHeader("host"), client.request.getPath(), route);
+    return (route.kind == Route::FORBIDDEN) ? 403 : 200;
+}
+
+void Server::_handleGetRequest(int client_fd, Client& client) {
+    const HttpRequest& request = client.request;
+    LOG_DEBUG("GET " << request.getPath());
+    
+    // Route dalla cache (già in client) o risolta ora
+    const Route* route = &client.route;
+    Route resolved;
+    if (!route->location) {
+        struct timeval start;
+        gettimeofday(&start, NULL);
+        int resolvedStatus = _resolveRoute(client, resolved);
+        client.fsUsec = usecSince(start);
+        if (resolvedStatus == 404) {
+            _sendError(client_fd, client, 404, request.getPath());
+            return;
+        }
+        route = &resolved;
     }
     
-    // 7. Invia il file
-    _sendFile(client_fd, filePath);
+    if (route->kind == Route::FORBIDDEN)
+        _sendError(client_fd, client, 403, request.getPath());
+    else if (route->kind == Route::AUTOINDEX)
+        _sendAutoindex(client_fd, client, route->filePath);
+    else
+        _sendFile(client_fd, client, route->filePath, route->contentType);
 }
 
-void Server::_sendFile(int client_fd, const std::string& path) {
-    std::string content;
-    
-    try {
-        content = readFile(path);
-    } catch (const std::exception& e) {
-        std::cerr << "Errore lettura file " << path << ": " << e.what() << std::endl;
-        _sendError(client_fd, 500, "Internal Server Error", "Errore lettura file");
+// Header e file passano da un buffer del pool: una send sola se il file ci
+// sta, altrimenti blocchi da BUFFER_POOL_MAX. Nessuna stringa grande quanto
+// il file, né per leggerlo né per la risposta
+void Server::_sendFile(int client_fd, Client& client, const std::string& path, const std::string& contentType) {
+    // $file_time: tempo speso ad aprire e leggere il file
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        LOG_ERROR("Errore lettura file " << path << ": " << strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        _sendError(client_fd, client, 500, "Errore lettura file");
         return;
     }
+    size_t size = static_cast<size_t>(st.st_size);
+    TRACE_FILE_OPENED(client_fd, path.c_str(), size);
     
     // Crea la risposta
     HttpResponse response;
     response.setStatusCode(200);
-    response.setHeader("Content-Type", HttpResponse::getContentType(path));
-    response.setBody(content);
+    response.setHeader("Content-Type", contentType);
+    response.setHeader("Content-Length", to_string98(size));
+    _addCacheHeaders(response, client);
+    
+    IoBuffer out;
+    size_t head = 0;
+    if (_buffers.acquire(out, size + RESPONSE_HEADER_RESERVE))
+        head = response.writeHeaders(out.data, out.capacity);
+    if (head == 0 && out.data && _buffers.grow(out, BUFFER_POOL_MAX))
+        head = response.writeHeaders(out.data, out.capacity);
+    if (head == 0) {
+        LOG_ERROR("Nessun buffer per la risposta " << path);
+        _buffers.release(out);
+        close(fd);
+        _sendError(client_fd, client, 500, "Errore lettura file");
+        return;
+    }
     
-    // Invia la risposta
-    std::string responseStr = response.toString();
-    if (send(client_fd, responseStr.c_str(), responseStr.size(), 0) < 0) {
-        std::cerr << "Errore invio risposta al client " << client_fd << std::endl;
-    } else {
-        std::cout << "Risposta 200 OK, " << content.size() << " bytes" << std::endl;
+    // Primo blocco insieme agli header: se la lettura fallisce è ancora un 500
+    size_t chunk = std::min(size, out.capacity - head);
+    ssize_t n = readFull(fd, out.data + head, chunk);
+    gettimeofday(&end, NULL);
+    client.fileUsec = elapsedUsec(start, end);
+    if (n != static_cast<ssize_t>(chunk)) {
+        LOG_ERROR("Errore lettura file " << path << ": " << (n < 0 ? strerror(errno) : "file accorciato"));
+        _buffers.release(out);
+        close(fd);
+        _sendError(client_fd, client, 500, "Errore lettura file");
+        return;
+    }
+    bool sent = _send(client_fd, out.data, head + chunk, 200, head + size);
+    
+    // Il resto a blocchi: ora un errore può solo troncare la risposta
+    size_t left = size - chunk;
+    while (sent && left > 0) {
+        chunk = std::min(left, out.capacity);
+        gettimeofday(&start, NULL);
+        n = readFull(fd, out.data, chunk);
+        gettimeofday(&end, NULL);
+        client.fileUsec += elapsedUsec(start, end);
+        if (n != static_cast<ssize_t>(chunk)) {
+            LOG_ERROR("Errore lettura file " << path << ": " << (n < 0 ? strerror(errno) : "file accorciato"));
+            break;
+        }
+        sent = _sendMore(client_fd, out.data, chunk);
+        left -= chunk;
+    }
+    close(fd);
+    _buffers.release(out);
+    client.fsUsec = (client.fsUsec < 0 ? 0 : client.fsUsec) + client.fileUsec;
+    
+    if (!sent) {
+        LOG_INFO("Errore invio risposta al client " << client_fd);
+    } else if (left == 0) {
+        LOG_DEBUG("Risposta 200 OK, " << size << " bytes");
     }
 }
 
-void Server::_sendAutoindex(int client_fd, const std::string& path, const std::string& uri) {
+void Server::_sendAutoindex(int client_fd, const Client& client, const std::string& path) {
+    const std::string uri = client.request.getPath();
+    
     // Lista i contenuti della directory
     std::vector<std::string> files = listDirectory(path);
     
@@ -404,142 +920,126 @@ void Server::_sendAutoindex(int client_fd, const std::string& path, const std::s
     HttpResponse response;
     response.setStatusCode(200);
     response.setHeader("Content-Type", "text/html");
+    _addCacheHeaders(response, client);
     response.setBody(body);
     
     // Invia la risposta
     std::string responseStr = response.toString();
-    send(client_fd, responseStr.c_str(), responseStr.size(), 0);
+    _send(client_fd, responseStr.data(), responseStr.size(), 200);
     
-    std::cout << "Risposta 200 OK (autoindex)" << std::endl;
+    LOG_DEBUG("Risposta 200 OK (autoindex)");
 }
 
-void Server::_sendNotFound(int client_fd, const std::string& uri) {
-    std::string body = "<html><head><title>404 Not Found</title></head>"
-                       "<body><h1>404 Not Found</h1><p>The requested URL " + 
-                       uri + " was not found on this server.</p></body></html>";
-    
-    // Crea la risposta
-    HttpResponse response;
-    response.setStatusCode(404);
-    response.setHeader("Content-Type", "text/html");
-    response.setBody(body);
-    
-    // Invia la risposta
-    std::string responseStr = response.toString();
-    send(client_fd, responseStr.c_str(), responseStr.size(), 0);
-    
-    std::cout << "Risposta 404 Not Found per " << uri << std::endl;
+// Header di cache della location, serializzati al caricamento; solo
+// l'Expires relativo si calcola qui
+void Server::_addCacheHeaders(HttpResponse& response, const Client& client) const {
+    const LocationConfig* location = client.location;
+    if (!location)
+        return;
+    response.addHeaderLines(location->cache_headers);
+    if (location->expires_after >= 0)
+        response.setHeader("Expires", httpDate(time(NULL) + location->expires_after));
 }
 
-void Server::_sendForbidden(int client_fd, const std::string& uri) {
-    std::string body = "<html><head><title>403 Forbidden</title></head>"
-                       "<body><h1>403 Forbidden</h1><p>You don't have permission to access " +
-                       uri + " on this server.</p></body></html>";
-    
-    // Crea la risposta
-    HttpResponse response;
-    response.setStatusCode(403);
-    response.setHeader("Content-Type", "text/html");
-    response.setBody(body);
-    
-    // Invia la risposta
-    std::string responseStr = response.toString();
-    send(client_fd, responseStr.c_str(), responseStr.size(), 0);
+void Server::_sendReturn(int client_fd, const Client& client) {
+    const Redirect& redirect = client.location->redirect;
+    if (!redirect.isRedirect()) {
+        _sendError(client_fd, client, redirect.code(), "return");
+        return;
+    }
     
-    std::cout << "Risposta 403 Forbidden per " << uri << std::endl;
+    // $host: header Host senza porta, in minuscolo, altrimenti server_name
+    std::string host = client.request.getHeader("host");
+    host.resize(VhostTable::hostLength(host));
+    for (size_t i = 0; i < host.size(); ++i)
+        host[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(host[i])));
+    if (host.empty() && client.server)
+        host = client.server->server_name;
+    
+    std::string scratch;
+    const std::string& response = redirect.render(client.request.getUri(), host, scratch);
+    if (!_send(client_fd, response.data(), response.size(), redirect.code())) {
+        LOG_INFO("Errore invio redirect al client " << client_fd);
+    } else {
+        LOG_DEBUG("Risposta " << redirect.code() << " "
+            << HttpResponse::getStatusMessage(redirect.code()) << " (return)");
+    }
 }
 
-void Server::_sendError(int client_fd, int statusCode, const std::string& statusText, const std::string& message) {
-    // Crea HTML per l'errore
-    std::string body = "<html><head><title>" + to_string98(statusCode) + " " + statusText + 
-                      "</title></head><body><h1>" + to_string98(statusCode) + " " + 
-                      statusText + "</h1><p>" + message + "</p></body></html>";
+void Server::_sendStatus(int client_fd, Client& client) {
+    const std::string& method = client.request.getMethod();
+    if (method != "GET" && method != "HEAD") {
+        _sendError(client_fd, client, 405, "stub_status accepts only GET and HEAD");
+        return;
+    }
     
-    // Crea la risposta
+    // ?format=prometheus|text sostituisce il formato della direttiva
+    StatusFormat format = client.location->stub_status;
+    std::map<std::string, std::string> params = client.request.getQueryParams();
+    std::map<std::string, std::string>::const_iterator it = params.find("format");
+    if (it != params.end() && it->second == "prometheus")
+        format = STATUS_PROMETHEUS;
+    else if (it != params.end() && it->second == "text")
+        format = STATUS_TEXT;
+    
+    // La richiesta corrente si conta tra quelle in scrittura, come in nginx
+    Stats::transition(client.phase, CONN_WRITING);
+    std::string body;
     HttpResponse response;
-    response.setStatusCode(statusCode);
-    response.setHeader("Content-Type", "text/html");
+    response.setStatusCode(200);
+    ConnMemory memory;
+    _connectionMemory(memory);
+    if (format == STATUS_PROMETHEUS) {
+        Stats::renderPrometheus(body, memory);
+        response.setHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    } else {
+        Stats::renderText(body, memory);
+        response.setHeader("Content-Type", "text/plain");
+    }
+    response.setHeader("Cache-Control", "no-cache");
     response.setBody(body);
     
-    // Invia la risposta
     std::string responseStr = response.toString();
-    send(client_fd, responseStr.c_str(), responseStr.size(), 0);
-    
-    std::cout << "Risposta " << statusCode << " " << statusText << std::endl;
+    size_t length = responseStr.size();
+    if (method == "HEAD")
+        length = responseStr.find("\r\n\r\n") + 4;
+    if (!_send(client_fd, responseStr.data(), length, 200)) {
+        LOG_INFO("Errore invio stub_status al client " << client_fd);
+    } else {
+        LOG_DEBUG("Risposta 200 OK (stub_status)");
+    }
 }
 
-// Aggiungi questa funzione di log con diversi livelli
-enum LogLevel { DEBUG, INFO, WARNING, ERROR };
-
-void log(LogLevel level, const std::string& message) {
-    std::string prefix;
-    switch (level) {
-        case DEBUG: prefix = "[DEBUG] "; break;
-        case INFO: prefix = "[INFO] "; break;
-        case WARNING: prefix = "[WARNING] "; break;
-        case ERROR: prefix = "[ERROR] "; break;
+void Server::_sendError(int client_fd, const Client& client, int statusCode, const std::string& reason) {
+    // Pagine della location, altrimenti del server, altrimenti predefinite:
+    // la risposta è già serializzata, HEAD ne invia solo gli header
+    static const ErrorPages builtin;
+    const ErrorPages* pages = &builtin;
+    if (client.location)
+        pages = &client.location->errors;
+    else if (client.server)
+        pages = &client.server->fallback.errors;
+    
+    const ErrorPages::Response& response = pages->find(statusCode);
+    size_t length = (client.request.getMethod() == "HEAD") ? response.headerLength : response.data.size();
+    
+    if (!_send(client_fd, response.data.data(), length, statusCode)) {
+        LOG_INFO("Errore invio risposta " << statusCode << " al client " << client_fd);
+    } else {
+        LOG_DEBUG("Risposta " << statusCode << " " << HttpResponse::getStatusMessage(statusCode)
+            << ": " << reason);
     }
-    
-    std::cout << prefix << message << std::endl;
 }
 
-void Server::_handlePostRequest(int client_fd, const HttpRequest& request) {
-    std::cout << "POST " << request.getPath() << std::endl;
-    
-    // 1. Trova il server config che gestisce questo host
-    const ServerConfig* server = NULL;
-    std::string host = request.getHeader("host");
-    
-    // Rimuovi la porta dall'header host, se presente
-    size_t colonPos = host.find(':');
-    if (colonPos != std::string::npos)
-        host = host.substr(0, colonPos);
-    
-    // Trova il server config corrispondente
-    for (size_t i = 0; i < _servers.size(); ++i) {
-        if (_servers[i].server_name == host) {
-            server = &_servers[i];
-            break;
-        }
-    }
+void Server::_handlePostRequest(int client_fd, Client& client) {
+    HttpRequest& request = client.request;
+    LOG_DEBUG("POST " << request.getPath());
     
-    // Se non troviamo un server specifico, usa il primo
-    if (!server && !_servers.empty()) {
-        server = &_servers[0];
-    }
-    
-    // 2. Trova il location block che combacia con l'URI
-    const LocationConfig* location = NULL;
-    if (server)
-        location = _findLocationMatch(request.getPath(), *server);
-    
-    // 3. Verifica che POST sia permesso
-    if (location && !location->methods.empty()) {
-        bool postAllowed = false;
-        for (size_t i = 0; i < location->methods.size(); ++i) {
-            if (location->methods[i] == "POST") {
-                postAllowed = true;
-                break;
-            }
-        }
-        if (!postAllowed) {
-            _sendError(client_fd, 405, "Method Not Allowed", "POST not allowed for this location");
-            return;
-        }
-    }
+    // limit_except e client_max_body_size sono già stati verificati
+    // in _processHeaders, prima di ricevere il body
     
-    // 4. Verifica content length limit
-    size_t contentLength = request.getContentLength();
-    size_t maxBodySize = server ? server->client_max_body_size : 0;
-    if (location && location->max_body_size > 0) {
-        maxBodySize = location->max_body_size;
-    }
-    if (maxBodySize > 0 && contentLength > maxBodySize) {
-        _sendError(client_fd, 413, "Payload Too Large", "Request body too large");
-        return;
-    }
-    
-    // 5. Processa i dati POST
+    // Processa i dati POST (form e upload)
+    request.parseBody(&_uploadStore, client.location);
     _sendPostResponse(client_fd, request);
 }
 
@@ -585,100 +1085,39 @@ void Server::_sendPostResponse(int client_fd, const HttpRequest& request) {
     response.setBody(responseBody.str());
     
     std::string responseStr = response.toString();
-    if (send(client_fd, responseStr.c_str(), responseStr.size(), 0) < 0) {
-        std::cerr << "Errore invio risposta POST al client " << client_fd << std::endl;
+    if (!_send(client_fd, responseStr.data(), responseStr.size(), 200)) {
+        LOG_INFO("Errore invio risposta POST al client " << client_fd);
     } else {
-        std::cout << "Risposta POST 200 OK inviata" << std::endl;
+        LOG_DEBUG("Risposta POST 200 OK inviata");
     }
 }
 
-void Server::_handleDeleteRequest(int client_fd, const HttpRequest& request) {
-    std::cout << "DELETE " << request.getPath() << std::endl;
-    
-    // 0. Security check: prevent null byte injection
-    std::string requestPath = request.getPath();
-    if (requestPath.find('\0') != std::string::npos) {
-        _sendErrorResponse(client_fd, 400, "Bad Request: null byte in path");
+void Server::_handleDeleteRequest(int client_fd, const Client& client) {
+    const HttpRequest& request = client.request;
+    LOG_DEBUG("DELETE " << request.getPath());
+    
+    // 0. Path already canonical: NUL bytes and bad escapes got a 400, root
+    // escapes a 403. A path that needed '.', '..' or '//' resolution is
+    // still refused for a destructive method
+    const std::string requestPath = request.getPath();
+    if (client.pathRewritten) {
+        _sendError(client_fd, client, 403, "directory traversal attempt");
         return;
     }
     
-    // 1. Find the server config that handles this host
-    const ServerConfig* server = NULL;
-    std::string host = request.getHeader("host");
-    
-    // Remove port from host header if present
-    size_t colonPos = host.find(':');
-    if (colonPos != std::string::npos)
-        host = host.substr(0, colonPos);
-    
-    // Find matching server config
-    for (size_t i = 0; i < _servers.size(); ++i) {
-        if (_servers[i].server_name == host) {
-            server = &_servers[i];
-            break;
-        }
-    }
-    
-    // If no specific server found, use the first one
-    if (!server && !_servers.empty()) {
-        server = &_servers[0];
-    }
-    
-    // 2. Find location block that matches the URI
-    const LocationConfig* location = NULL;
-    if (server)
-        location = _findLocationMatch(request.getPath(), *server);
+    // 1-2. Server and location were resolved right after the headers
+    const LocationConfig* location = client.location;
     
     // 3. Check if DELETE is allowed
-    if (location && !location->methods.empty()) {
-        bool deleteAllowed = false;
-        for (size_t i = 0; i < location->methods.size(); ++i) {
-            if (location->methods[i] == "DELETE") {
-                deleteAllowed = true;
-                break;
-            }
-        }
-        if (!deleteAllowed) {
-            _sendDeleteResponse(client_fd, request, false, "DELETE method not allowed for this location");
-            return;
-        }
-    }
-    
-    // 4. Resolve the file path
-    std::string filePath;
-    
-    if (location) {
-        // Use location root
-        filePath = location->root + requestPath;
-    } else if (server) {
-        // Use server root
-        filePath = server->root + requestPath;
-    } else {
-        // Default root
-        filePath = "./www" + requestPath;
-    }
-    
-    // Normalize path and prevent directory traversal
-    filePath = normalizePath(filePath);
-    
-    // 5. Enhanced security check: ensure path is within allowed directory
-    std::string allowedRoot = location ? location->root : (server ? server->root : "./www");
-    allowedRoot = normalizePath(allowedRoot);
-    
-    // Check for directory traversal attempts
-    if (requestPath.find("..") != std::string::npos || 
-        requestPath.find("//") != std::string::npos ||
-        requestPath.find("./") != std::string::npos) {
-        _sendErrorResponse(client_fd, 403, "Forbidden: directory traversal attempt");
-        return;
-    }
-
-    if (filePath.find(allowedRoot) != 0) {
-        _sendErrorResponse(client_fd, 403, "Forbidden: path outside allowed directory");
+    if (!location || !(location->methods & METHOD_DELETE)) {
+        _sendDeleteResponse(client_fd, request, false, "DELETE method not allowed for this location");
         return;
     }
     
-    // 6. Check if path exists and what type it is (safer approach)
+    // 4. Resolve the file path, same mapping as GET
+    std::string filePath = _getFilePath(requestPath, location);
+    
+    // 5. Check if path exists and what type it is (safer approach)
     struct stat fileStat;
     if (stat(filePath.c_str(), &fileStat) != 0) {
         // File/directory doesn't exist
@@ -686,25 +1125,25 @@ void Server::_handleDeleteRequest(int client_fd, const HttpRequest& request) {
         return;
     }
     
-    // 7. Check if it's a directory - we don't delete directories
+    // 6. Check if it's a directory - we don't delete directories
     if (S_ISDIR(fileStat.st_mode)) {
         _sendDeleteResponse(client_fd, request, false, "Cannot delete directory");
         return;
     }
     
-    // 8. Check file permissions (readable implies we can access it)
+    // 7. Check file permissions (readable implies we can access it)
     if (!isReadable(filePath)) {
         _sendDeleteResponse(client_fd, request, false, "Access denied: insufficient permissions");
         return;
     }
     
-    // 9. Attempt to delete the file
+    // 8. Attempt to delete the file
     if (unlink(filePath.c_str()) == 0) {
         _sendDeleteResponse(client_fd, request, true, "File deleted successfully");
-        std::cout << "File deleted: " << filePath << std::endl;
+        LOG_INFO("File deleted: " << filePath);
     } else {
         _sendDeleteResponse(client_fd, request, false, "Failed to delete file: " + std::string(strerror(errno)));
-        std::cerr << "Failed to delete " << filePath << ": " << strerror(errno) << std::endl;
+        LOG_ERROR("Failed to delete " << filePath << ": " << strerror(errno));
     }
 }
 
@@ -742,10 +1181,10 @@ void Server::_sendDeleteResponse(int client_fd, const HttpRequest& request, bool
     response.setBody(responseBody.str());
     
     std::string responseStr = response.toString();
-    if (send(client_fd, responseStr.c_str(), responseStr.size(), 0) < 0) {
-        std::cerr << "Error sending DELETE response to client " << client_fd << std::endl;
+    if (!_send(client_fd, responseStr.data(), responseStr.size(), response.getStatusCode())) {
+        LOG_INFO("Error sending DELETE response to client " << client_fd);
     } else {
-        std::cout << "DELETE response " << response.getStatusCode() << " sent" << std::endl;
+        LOG_DEBUG("DELETE response " << response.getStatusCode() << " sent");
     }
 }
 
@@ -767,103 +1206,40 @@ std::string Server::_normalizePath(const std::string& path) {
     return normalized;
 }*/
 
-void Server::_handleHeadRequest(int client_fd, const HttpRequest& request) {
-    std::cout << "HEAD " << request.getPath() << std::endl;
-    
-    // Il HEAD method è identico al GET, ma senza inviare il body
-    // Riutilizziamo la stessa logica del GET per generare gli headers
-    
-    std::string uri = request.getUri();
-    
-    // 1. Trova il server config che gestisce questo host
-    const ServerConfig* server = NULL;
-    std::string host = request.getHeader("host");
-    
-    // Rimuovi la porta dall'header host, se presente
-    size_t colonPos = host.find(':');
-    if (colonPos != std::string::npos)
-        host = host.substr(0, colonPos);
-    
-    // Trova il server config corrispondente
-    for (size_t i = 0; i < _servers.size(); ++i) {
-        if (_servers[i].server_name == host) {
-            server = &_servers[i];
-            break;
-        }
-    }
-    
-    // Se non troviamo un server specifico, usa il primo
-    if (!server && !_servers.empty()) {
-        server = &_servers[0];
-    }
-    
-    // 2. Trova il location block che combacia con l'URI
-    const LocationConfig* location = NULL;
-    if (server)
-        location = _findLocationMatch(request.getPath(), *server);
-    
-    if (!location) {
-        // Nessun location match trovato
-        _sendHeadError(client_fd, 404, "Not Found");
-        return;
-    }
-    
-    // 3. Costruisci il percorso del file
-    std::string filePath = _getFilePath(request.getPath(), location);
-    filePath = normalizePath(filePath);
-    
-    // 4. Controlla se il file esiste
-    if (!fileExists(filePath)) {
-        // Se è una directory, prova con index
-        if (isDirectory(filePath)) {
-            std::string indexFile = filePath;
-            if (indexFile[indexFile.length() - 1] != '/')
-                indexFile += "/";
-            indexFile += location->index;
-            
-            if (fileExists(indexFile)) {
-                filePath = indexFile;
-            } else if (location->autoindex) {
-                // Per HEAD su directory con autoindex, invia headers come se fosse HTML
-                _sendHeadResponse(client_fd, 200, "text/html", 0); // 0 = unknown content length for directory listing
-                return;
-            } else {
-                _sendHeadError(client_fd, 403, "Forbidden");
-                return;
-            }
-        } else {
-            _sendHeadError(client_fd, 404, "Not Found");
+void Server::_handleHeadRequest(int client_fd, Client& client) {
+    const HttpRequest& request = client.request;
+    LOG_DEBUG("HEAD " << request.getPath());
+    
+    // Il HEAD method è identico al GET, ma senza inviare il body:
+    // stessa route, e la dimensione viene dallo stat già fatto
+    const Route* route = &client.route;
+    Route resolved;
+    if (!route->location) {
+        struct timeval start;
+        gettimeofday(&start, NULL);
+        int resolvedStatus = _resolveRoute(client, resolved);
+        client.fsUsec = usecSince(start);
+        if (resolvedStatus == 404) {
+            _sendError(client_fd, client, 404, request.getPath());
             return;
         }
+        route = &resolved;
     }
     
-    // 5. Controlla se il file è leggibile
-    if (!isReadable(filePath)) {
-        _sendHeadError(client_fd, 403, "Forbidden");
-        return;
-    }
-    
-    // 6. Determina Content-Type e Content-Length
-    std::string contentType = HttpResponse::getContentType(filePath);
-    
-    // Ottieni la dimensione del file senza leggerlo
-    struct stat fileStat;
-    if (stat(filePath.c_str(), &fileStat) != 0) {
-        _sendHeadError(client_fd, 500, "Internal Server Error");
-        return;
-    }
-    
-    size_t contentLength = fileStat.st_size;
-    
-    // 7. Invia solo gli headers (senza body)
-    _sendHeadResponse(client_fd, 200, contentType, contentLength);
+    if (route->kind == Route::FORBIDDEN)
+        _sendError(client_fd, client, 403, request.getPath());
+    else if (route->kind == Route::AUTOINDEX)
+        _sendHeadResponse(client_fd, client, 200, "text/html", 0); // 0 = unknown content length for directory listing
+    else
+        _sendHeadResponse(client_fd, client, 200, route->contentType, static_cast<size_t>(route->size));
 }
 
-void Server::_sendHeadResponse(int client_fd, int statusCode, const std::string& contentType, size_t contentLength) {
+void Server::_sendHeadResponse(int client_fd, const Client& client, int statusCode, const std::string& contentType, size_t contentLength) {
     // Crea HttpResponse ma senza body
     HttpResponse response;
     response.setStatusCode(statusCode);
     response.setHeader("Content-Type", contentType);
+    _addCacheHeaders(response, client);
     
     if (contentLength > 0) {
         std::ostringstream oss;
@@ -876,54 +1252,26 @@ void Server::_sendHeadResponse(int client_fd, int statusCode, const std::string&
     
     std::string responseStr = response.toString();
     
-    if (send(client_fd, responseStr.c_str(), responseStr.size(), 0) < 0) {
-        std::cerr << "Errore invio risposta HEAD al client " << client_fd << std::endl;
+    if (!_send(client_fd, responseStr.data(), responseStr.size(), statusCode)) {
+        LOG_INFO("Errore invio risposta HEAD al client " << client_fd);
     } else {
-        std::cout << "Risposta HEAD " << statusCode << " inviata (headers only)" << std::endl;
+        LOG_DEBUG("Risposta HEAD " << statusCode << " inviata (headers only)");
     }
 }
 
-void Server::_sendHeadError(int client_fd, int statusCode, const std::string& statusText) {
-    // Per errori HEAD, invia solo gli headers dell'errore
-    HttpResponse response;
-    response.setStatusCode(statusCode);
-    response.setHeader("Content-Type", "text/html");
-    
-    // Calcola la lunghezza dell'errore HTML che AVREMMO inviato
-    std::string errorBody = "<html><body><h1>" + to_string98(statusCode) + " " + statusText + "</h1></body></html>";
-    std::ostringstream oss;
-    oss << errorBody.length();
-    response.setHeader("Content-Length", oss.str());
-    
-    // NON settiamo il body per HEAD!
-    
-    std::string responseStr = response.toString();
-    
-    if (send(client_fd, responseStr.c_str(), responseStr.size(), 0) < 0) {
-        std::cerr << "Errore invio risposta HEAD error al client " << client_fd << std::endl;
-    } else {
-        std::cout << "Risposta HEAD " << statusCode << " " << statusText << " inviata (headers only)" << std::endl;
+// Stima per stub_status: struct e nodi a dimensione fissa, stringhe e
+// map per capacità, buffer del pool per classe. Le risposte sono inviate
+// subito, senza coda in uscita
+void Server::_connectionMemory(ConnMemory& memory) const {
+    memory.poolSlabs = _buffers.slabBytes();
+    memory.poolInUse = _buffers.inUse();
+    for (std::map<int, Client>::const_iterator it = _clients.begin(); it != _clients.end(); ++it) {
+        const Client& client = it->second;
+        ++memory.connections;
+        memory.client += MAP_NODE_OVERHEAD + sizeof(*it) + sizeof(struct pollfd) + sizeof(size_t);
+        memory.buffers += client.input.capacity + stringHeapBytes(client.buffer)
+            + stringHeapBytes(client.captured);
+        memory.request += client.request.heapUsage() + stringHeapBytes(client.route.filePath)
+            + stringHeapBytes(client.route.contentType);
     }
 }
-
-void Server::_sendErrorResponse(int client_fd, int statusCode, const std::string& message) {
-    HttpResponse response;
-    response.setStatusCode(statusCode);
-    response.setHeader("Content-Type", "text/html");
-    
-    std::string body = "<html><body><h1>" + to_string98(statusCode) + " " + 
-                      HttpResponse::getStatusMessage(statusCode) + "</h1><p>" + message + "</p></body></html>";
-    
-    std::ostringstream oss;
-    oss << body.length();
-    response.setHeader("Content-Length", oss.str());
-    response.setBody(body);
-    
-    std::string responseStr = response.toString();
-    
-    if (send(client_fd, responseStr.c_str(), responseStr.size(), 0) < 0) {
-        std::cerr << "Errore invio risposta error al client " << client_fd << std::endl;
-    } else {
-        std::cout << "Risposta " << statusCode << " " << HttpResponse::getStatusMessage(statusCode) << " inviata" << std::endl;
-    }
-}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "ServerInstance.hpp"
+#include "Logger.hpp"
 #include <cstring>
 
 ServerInstance::ServerInstance(const std::string& host, int port)
@@ -18,10 +19,12 @@ ServerInstance::ServerInstance(const std::string& host, int port)
     if (bind(_sockfd, (struct sockaddr*)&_addr, sizeof(_addr)) < 0)
         throw std::runtime_error("Errore: bind() fallita");
 
-    if (listen(_sockfd, 10) < 0)
+    // Coda di accept ampia: con molte connect contemporanee i SYN oltre
+    // la coda vengono scartati e il client ritenta dopo un secondo
+    if (listen(_sockfd, SOMAXCONN) < 0)
         throw std::runtime_error("Errore: listen() fallita");
 
-    std::cout << "Socket in ascolto su " << _host << ":" << _port << std::endl;
+    LOG_NOTICE("Socket in ascolto su " << _host << ":" << _port);
 }
 
 ServerInstance::~ServerInstance() {
@@ -38,7 +41,7 @@ void ServerInstance::acceptClient() {
     if (client_fd < 0)
         throw std::runtime_error("Errore: accept() fallita");
 
-    std::cout << "Nuovo client connesso (fd=" << client_fd << ")" << std::endl;
+    LOG_DEBUG("Nuovo client connesso (fd=" << client_fd << ")");
 }
 
 void ServerInstance::handleClient(int client_fd) {
@@ -47,12 +50,12 @@ void ServerInstance::handleClient(int client_fd) {
 
     int bytes = recv(client_fd, buffer, sizeof(buffer)-1, 0);
     if (bytes <= 0) {
-        std::cout << "Client disconnesso (fd=" << client_fd << ")" << std::endl;
+        LOG_DEBUG("Client disconnesso (fd=" << client_fd << ")");
         close(client_fd);
         return;
     }
 
-    std::cout << "Richiesta ricevuta (fd=" << client_fd << "):\n" << buffer << std::endl;
+    LOG_DEBUG("Richiesta ricevuta (fd=" << client_fd << "):\n" << buffer);
 
     std::string response =
         "HTTP/1.1 200 OK\r\n"
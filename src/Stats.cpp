@@ -0,0 +1,266 @@
+// ********** STATS **********
+// I contatori sono letti uno per uno senza snapshot: ogni valore è
+// coerente, la pagina nel suo insieme è approssimata come in nginx
+
+#include "Stats.hpp"
+#include "Logger.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+
+StatsCounters Stats::_local;
+StatsCounters* Stats::_counters = &Stats::_local;
+
+void Stats::init() {
+    void* page = mmap(NULL, sizeof(StatsCounters), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        LOG_WARN("mmap dei contatori fallita, stub_status per processo: " << strerror(errno));
+        return;
+    }
+    // Memoria anonima già a zero
+    _counters = static_cast<StatsCounters*>(page);
+}
+
+long* Stats::_gauge(ConnPhase phase) {
+    if (phase == CONN_READING)
+        return &_counters->reading;
+    if (phase == CONN_WRITING)
+        return &_counters->writing;
+    return &_counters->waiting;
+}
+
+void Stats::transition(ConnPhase& phase, ConnPhase next) {
+    if (phase == next)
+        return;
+    __atomic_fetch_sub(_gauge(phase), 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(_gauge(next), 1, __ATOMIC_RELAXED);
+    phase = next;
+}
+
+void Stats::opened(ConnPhase& phase) {
+    add(_counters->accepted, 1);
+    add(_counters->handled, 1);
+    __atomic_fetch_add(&_counters->active, 1, __ATOMIC_RELAXED);
+    phase = CONN_WAITING;
+    __atomic_fetch_add(_gauge(phase), 1, __ATOMIC_RELAXED);
+}
+
+void Stats::closed(ConnPhase phase) {
+    __atomic_fetch_sub(&_counters->active, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(_gauge(phase), 1, __ATOMIC_RELAXED);
+}
+
+void Stats::response(int status, unsigned long bytesSent) {
+    add(_counters->requests, 1);
+    add(_counters->bytesOut, bytesSent);
+    if (status >= STATS_STATUS_MIN && status <= STATS_STATUS_MAX)
+        add(_counters->status[status - STATS_STATUS_MIN], 1);
+}
+
+const char* Stats::_phaseName(int phase) {
+    static const char* names[PHASE_COUNT] = { "wait", "parse", "route", "fs", "first_byte", "total" };
+    return names[phase];
+}
+
+void Stats::dumpHistograms() {
+    Histogram h;
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        _counters->phases[phase].snapshot(h);
+        LOG_NOTICE("latency " << _phaseName(phase) << " (us): count " << h.total
+            << " p50 " << h.percentile(0.5) << " p90 " << h.percentile(0.9)
+            << " p99 " << h.percentile(0.99) << " p99.9 " << h.percentile(0.999)
+            << " max " << h.max);
+        if (h.total == 0)
+            continue;
+
+        // Distribuzione completa: "basso-alto:conteggio" per i bucket non vuoti
+        std::string buckets;
+        char item[64];
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            if (h.counts[i] == 0)
+                continue;
+            int n = snprintf(item, sizeof(item), " %lu-%lu:%lu",
+                Histogram::bucketLow(i), Histogram::bucketHigh(i), h.counts[i]);
+            buckets.append(item, n);
+        }
+        LOG_NOTICE("latency " << _phaseName(phase) << " buckets" << buckets);
+    }
+}
+
+unsigned long Stats::residentBytes() {
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    if (fields != 2)
+        return 0;
+    return resident * static_cast<unsigned long>(sysconf(_SC_PAGESIZE));
+}
+
+unsigned long Stats::_load(const unsigned long& counter) {
+    return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+}
+
+long Stats::_load(const long& gauge) {
+    return __atomic_load_n(&gauge, __ATOMIC_RELAXED);
+}
+
+// Formato di stub_status di nginx, seguito da byte, status e cache
+void Stats::renderText(std::string& out, const ConnMemory& memory) {
+    const StatsCounters& c = *_counters;
+    char line[256];
+    int n;
+
+    n = snprintf(line, sizeof(line),
+        "Active connections: %ld \nserver accepts handled requests\n %lu %lu %lu \n"
+        "Reading: %ld Writing: %ld Waiting: %ld \n",
+        _load(c.active), _load(c.accepted), _load(c.handled), _load(c.requests),
+        _load(c.reading), _load(c.writing), _load(c.waiting));
+    out.append(line, n);
+    n = snprintf(line, sizeof(line), "Bytes: in %lu out %lu\n", _load(c.bytesIn), _load(c.bytesOut));
+    out.append(line, n);
+
+    out += "Status:";
+    for (int code = STATS_STATUS_MIN; code <= STATS_STATUS_MAX; ++code) {
+        unsigned long count = _load(c.status[code - STATS_STATUS_MIN]);
+        if (count == 0)
+            continue;
+        n = snprintf(line, sizeof(line), " %d %lu", code, count);
+        out.append(line, n);
+    }
+    out += '\n';
+
+    unsigned long hits = _load(c.routeHits), misses = _load(c.routeMisses);
+    n = snprintf(line, sizeof(line), "Cache route: hits %lu misses %lu ratio %.3f\n",
+        hits, misses, hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0);
+    out.append(line, n);
+    unsigned long fresh = _load(c.metaFresh), stale = _load(c.metaStale);
+    n = snprintf(line, sizeof(line), "Cache metadata: fresh %lu stale %lu ratio %.3f\n",
+        fresh, stale, fresh + stale ? static_cast<double>(fresh) / (fresh + stale) : 0.0);
+    out.append(line, n);
+
+    // Totale delle connessioni, poi media per connessione e per parte
+    unsigned long total = memory.client + memory.buffers + memory.request;
+    unsigned long conns = memory.connections ? memory.connections : 1;
+    n = snprintf(line, sizeof(line), "Memory: rss %lu connections %lu\n", residentBytes(), total);
+    out.append(line, n);
+    n = snprintf(line, sizeof(line),
+        "Memory per connection: client %lu buffers %lu request %lu total %lu\n",
+        memory.client / conns, memory.buffers / conns, memory.request / conns, total / conns);
+    out.append(line, n);
+    n = snprintf(line, sizeof(line), "Buffer pool: slabs %lu in use %lu\n", memory.poolSlabs, memory.poolInUse);
+    out.append(line, n);
+
+    Histogram h;
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        c.phases[phase].snapshot(h);
+        n = snprintf(line, sizeof(line),
+            "Latency %s (us): count %lu p50 %lu p90 %lu p99 %lu p99.9 %lu max %lu\n",
+            _phaseName(phase), h.total, h.percentile(0.5), h.percentile(0.9),
+            h.percentile(0.99), h.percentile(0.999), h.max);
+        out.append(line, n);
+    }
+}
+
+// Exposition format 0.0.4 di Prometheus
+void Stats::renderPrometheus(std::string& out, const ConnMemory& memory) {
+    const StatsCounters& c = *_counters;
+    char line[256];
+    int n;
+
+    out += "# HELP webserv_connections Open client connections by state.\n"
+           "# TYPE webserv_connections gauge\n";
+    n = snprintf(line, sizeof(line),
+        "webserv_connections{state=\"active\"} %ld\n"
+        "webserv_connections{state=\"reading\"} %ld\n"
+        "webserv_connections{state=\"writing\"} %ld\n"
+        "webserv_connections{state=\"waiting\"} %ld\n",
+        _load(c.active), _load(c.reading), _load(c.writing), _load(c.waiting));
+    out.append(line, n);
+
+    static const char* totals[][2] = {
+        { "webserv_connections_accepted_total", "Accepted client connections." },
+        { "webserv_connections_handled_total", "Handled client connections." },
+        { "webserv_http_requests_total", "Completed HTTP requests." },
+        { "webserv_bytes_received_total", "Bytes received from clients." },
+        { "webserv_bytes_sent_total", "Bytes sent to clients." }
+    };
+    const unsigned long values[] = {
+        _load(c.accepted), _load(c.handled), _load(c.requests), _load(c.bytesIn), _load(c.bytesOut)
+    };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        n = snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %lu\n",
+            totals[i][0], totals[i][1], totals[i][0], totals[i][0], values[i]);
+        out.append(line, n);
+    }
+
+    out += "# HELP webserv_http_responses_total HTTP responses by status code.\n"
+           "# TYPE webserv_http_responses_total counter\n";
+    for (int code = STATS_STATUS_MIN; code <= STATS_STATUS_MAX; ++code) {
+        unsigned long count = _load(c.status[code - STATS_STATUS_MIN]);
+        if (count == 0)
+            continue;
+        n = snprintf(line, sizeof(line), "webserv_http_responses_total{code=\"%d\"} %lu\n", code, count);
+        out.append(line, n);
+    }
+
+    n = snprintf(line, sizeof(line),
+        "# HELP webserv_cache_hits_total Cache lookups served from the cache.\n"
+        "# TYPE webserv_cache_hits_total counter\n"
+        "webserv_cache_hits_total{cache=\"route\"} %lu\n"
+        "webserv_cache_hits_total{cache=\"metadata\"} %lu\n",
+        _load(c.routeHits), _load(c.metaFresh));
+    out.append(line, n);
+    n = snprintf(line, sizeof(line),
+        "# HELP webserv_cache_misses_total Cache lookups that missed or were stale.\n"
+        "# TYPE webserv_cache_misses_total counter\n"
+        "webserv_cache_misses_total{cache=\"route\"} %lu\n"
+        "webserv_cache_misses_total{cache=\"metadata\"} %lu\n",
+        _load(c.routeMisses), _load(c.metaStale));
+    out.append(line, n);
+
+    out += "# HELP webserv_resident_memory_bytes Resident set size of the process.\n"
+           "# TYPE webserv_resident_memory_bytes gauge\n";
+    n = snprintf(line, sizeof(line), "webserv_resident_memory_bytes %lu\n", residentBytes());
+    out.append(line, n);
+    out += "# HELP webserv_connection_memory_bytes Estimated memory held by open connections.\n"
+           "# TYPE webserv_connection_memory_bytes gauge\n";
+    n = snprintf(line, sizeof(line),
+        "webserv_connection_memory_bytes{part=\"client\"} %lu\n"
+        "webserv_connection_memory_bytes{part=\"buffers\"} %lu\n"
+        "webserv_connection_memory_bytes{part=\"request\"} %lu\n",
+        memory.client, memory.buffers, memory.request);
+    out.append(line, n);
+    out += "# HELP webserv_buffer_pool_bytes I/O buffer pool slabs, total and lent to connections.\n"
+           "# TYPE webserv_buffer_pool_bytes gauge\n";
+    n = snprintf(line, sizeof(line),
+        "webserv_buffer_pool_bytes{state=\"total\"} %lu\n"
+        "webserv_buffer_pool_bytes{state=\"in_use\"} %lu\n",
+        memory.poolSlabs, memory.poolInUse);
+    out.append(line, n);
+
+    // Summary con quantili: i 608 bucket sarebbero troppi per uno scrape
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    out += "# HELP webserv_phase_latency_seconds Request processing time by phase.\n"
+           "# TYPE webserv_phase_latency_seconds summary\n";
+    Histogram h;
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        c.phases[phase].snapshot(h);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q) {
+            n = snprintf(line, sizeof(line),
+                "webserv_phase_latency_seconds{phase=\"%s\",quantile=\"%g\"} %.6f\n",
+                _phaseName(phase), quantiles[q], h.percentile(quantiles[q]) / 1e6);
+            out.append(line, n);
+        }
+        n = snprintf(line, sizeof(line),
+            "webserv_phase_latency_seconds_sum{phase=\"%s\"} %.6f\n"
+            "webserv_phase_latency_seconds_count{phase=\"%s\"} %lu\n",
+            _phaseName(phase), h.sum / 1e6, _phaseName(phase), h.total);
+        out.append(line, n);
+    }
+}
@@ -0,0 +1,121 @@
+// ********** UPLOAD_STORE **********
+// Routing degli upload verso upload_store, sharding e nomi univoci
+
+#include "UploadStore.hpp"
+#include "UploadWriter.hpp"
+#include "utils.hpp"
+#include <fstream>
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
+
+UploadStore::UploadStore() : _writer(NULL), _counter(0) {
+    // Prefisso di istanza: due processi (o due avvii) non generano
+    // mai lo stesso nome anche con il contatore ripartito da zero
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%lx%05x",
+        static_cast<unsigned long>(time(0)), static_cast<unsigned>(getpid()) & 0xfffff);
+    _instanceId = buf;
+}
+
+void UploadStore::setWriter(UploadWriter* writer) {
+    _writer = writer;
+}
+
+std::string UploadStore::save(const LocationConfig* location,
+    const std::string& filename, std::string& content)
+{
+    std::string fullPath = _destination(location, filename);
+    if (fullPath.empty())
+        return "";
+
+    if (_writer) {
+        _writer->submit(fullPath, content);
+        return fullPath;
+    }
+    std::ofstream file(fullPath.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return "";
+    file.write(content.c_str(), content.length());
+    return fullPath;
+}
+
+std::string UploadStore::saveRange(const LocationConfig* location,
+    const std::string& filename, int srcFd, size_t offset, size_t length)
+{
+    std::string fullPath = _destination(location, filename);
+    if (fullPath.empty())
+        return "";
+
+    if (_writer) {
+        _writer->submitRange(fullPath, srcFd, offset, length);
+        return fullPath;
+    }
+    if (!UploadWriter::copyRange(fullPath, srcFd, offset, length))
+        return "";
+    return fullPath;
+}
+
+// Path completo del nuovo upload, "" se la directory non è creabile
+std::string UploadStore::_destination(const LocationConfig* location,
+    const std::string& filename)
+{
+    std::string id = _nextId();
+
+    // Radici multiple usate a turno, una per upload
+    std::string root = UPLOAD_DEFAULT_DIR;
+    size_t levels = 0;
+    if (location && !location->upload_dirs.empty()) {
+        root = location->upload_dirs[_counter % location->upload_dirs.size()];
+        levels = location->upload_shard;
+    }
+    if (root[root.size() - 1] != '/')
+        root += '/';
+
+    std::string dir = root + _shardPath(id, levels);
+    if (!ensureDirectory(dir))
+        return "";
+    return dir + id + "_" + sanitizeFilename(filename);
+}
+
+std::string UploadStore::sanitizeFilename(const std::string& filename) {
+    size_t slash = filename.find_last_of("/\\");
+    std::string name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (static_cast<unsigned char>(name[i]) < 0x20)
+            name[i] = '_';
+    }
+    if (name.empty() || name == "." || name == "..")
+        return "upload";
+    return name;
+}
+
+std::string UploadStore::_nextId() {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%s%08lx", _instanceId.c_str(), ++_counter);
+    return buf;
+}
+
+// Sottodirectory da due cifre esadecimali per livello, da un hash dell'id:
+// con 2 livelli ogni directory resta sotto 1/65536 dei file
+std::string UploadStore::_shardPath(const std::string& id, size_t levels) {
+    if (levels == 0)
+        return "";
+
+    // FNV-1a
+    unsigned long hash = 2166136261UL;
+    for (size_t i = 0; i < id.size(); ++i) {
+        hash ^= static_cast<unsigned char>(id[i]);
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+
+    std::string path;
+    char buf[4];
+    for (size_t i = 0; i < levels; ++i) {
+        std::snprintf(buf, sizeof(buf), "%02lx", (hash >> (8 * i)) & 0xff);
+        path += buf;
+        path += '/';
+    }
+    return path;
+}
@@ -0,0 +1,222 @@
+// ********** UPLOAD_WRITER **********
+// Pool di thread che scrive gli upload su disco con fdatasync opzionale
+
+#include "UploadWriter.hpp"
+#include "Logger.hpp"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+UploadWriter::UploadWriter()
+    : _stopping(false), _durability(DURABILITY_NONE), _syncBatch(16)
+{
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_cond, NULL);
+}
+
+UploadWriter::~UploadWriter() {
+    stop();
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_mutex);
+}
+
+void UploadWriter::start(size_t threads, Durability durability, size_t syncBatch) {
+    _durability = durability;
+    _syncBatch = syncBatch > 0 ? syncBatch : 1;
+    _stopping = false;
+
+    for (size_t i = 0; i < threads; ++i) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, &UploadWriter::_workerMain, this) != 0) {
+            LOG_WARN("pthread_create() fallita, upload sincroni");
+            break;
+        }
+        _threads.push_back(tid);
+    }
+}
+
+void UploadWriter::stop() {
+    pthread_mutex_lock(&_mutex);
+    _stopping = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+
+    for (size_t i = 0; i < _threads.size(); ++i)
+        pthread_join(_threads[i], NULL);
+    _threads.clear();
+}
+
+void UploadWriter::submit(const std::string& path, std::string& content) {
+    Job* job = new Job;
+    job->path = path;
+    job->content.swap(content);
+    job->srcFd = -1;
+    job->srcOffset = 0;
+    job->srcLength = 0;
+    _enqueue(job);
+}
+
+void UploadWriter::submitRange(const std::string& path, int srcFd, size_t offset, size_t length) {
+    Job* job = new Job;
+    job->path = path;
+    job->srcFd = dup(srcFd);
+    job->srcOffset = offset;
+    job->srcLength = length;
+    if (job->srcFd < 0) {
+        LOG_ERROR("dup() fallita per upload " << path);
+        delete job;
+        return;
+    }
+    _enqueue(job);
+}
+
+bool UploadWriter::copyRange(const std::string& path, int srcFd, size_t offset, size_t length) {
+    Job job;
+    job.path = path;
+    job.srcFd = srcFd;
+    job.srcOffset = offset;
+    job.srcLength = length;
+    int fd = _writeJob(job);
+    if (fd < 0)
+        return false;
+    close(fd);
+    return true;
+}
+
+void UploadWriter::_enqueue(Job* job) {
+    // Nessun thread disponibile: scrittura diretta
+    if (_threads.empty()) {
+        int fd = _writeJob(*job);
+        if (fd >= 0) {
+            if (_durability != DURABILITY_NONE)
+                fdatasync(fd);
+            close(fd);
+        }
+        if (job->srcFd >= 0)
+            close(job->srcFd);
+        delete job;
+        return;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _queue.push_back(job);
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+}
+
+void* UploadWriter::_workerMain(void* arg) {
+    static_cast<UploadWriter*>(arg)->_run();
+    return NULL;
+}
+
+void UploadWriter::_run() {
+    std::vector<int> pending;
+
+    while (true) {
+        pthread_mutex_lock(&_mutex);
+        // Coda vuota: prima di dormire chiude il batch in sospeso
+        while (_queue.empty() && !_stopping) {
+            if (!pending.empty()) {
+                pthread_mutex_unlock(&_mutex);
+                _syncPending(pending);
+                pthread_mutex_lock(&_mutex);
+                continue;
+            }
+            pthread_cond_wait(&_cond, &_mutex);
+        }
+        if (_queue.empty()) {
+            pthread_mutex_unlock(&_mutex);
+            break;
+        }
+        Job* job = _queue.front();
+        _queue.pop_front();
+        pthread_mutex_unlock(&_mutex);
+
+        int fd = _writeJob(*job);
+        if (job->srcFd >= 0)
+            close(job->srcFd);
+        delete job;
+        if (fd < 0)
+            continue;
+
+        if (_durability == DURABILITY_SYNC) {
+            fdatasync(fd);
+            close(fd);
+        } else if (_durability == DURABILITY_BATCH) {
+            pending.push_back(fd);
+            if (pending.size() >= _syncBatch)
+                _syncPending(pending);
+        } else {
+            close(fd);
+        }
+    }
+    _syncPending(pending);
+}
+
+// Scrive il file e ritorna il descrittore ancora aperto (-1 in caso di errore)
+int UploadWriter::_writeJob(const Job& job) {
+    int fd = _openTarget(job.path);
+    if (fd < 0)
+        return -1;
+
+    bool ok = true;
+    if (job.srcFd < 0) {
+        ok = _writeAll(fd, job.content.data(), job.content.size());
+    } else {
+        // Copia a blocchi dal file temporaneo del body
+        char buffer[65536];
+        size_t done = 0;
+        while (ok && done < job.srcLength) {
+            size_t chunk = job.srcLength - done;
+            if (chunk > sizeof(buffer))
+                chunk = sizeof(buffer);
+            ssize_t n = pread(job.srcFd, buffer, chunk, static_cast<off_t>(job.srcOffset + done));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            ok = _writeAll(fd, buffer, static_cast<size_t>(n));
+            done += static_cast<size_t>(n);
+        }
+    }
+
+    if (!ok) {
+        LOG_ERROR("Errore scrittura upload " << job.path << ": " << strerror(errno));
+        close(fd);
+        unlink(job.path.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+int UploadWriter::_openTarget(const std::string& path) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        LOG_ERROR("Errore apertura upload " << path << ": " << strerror(errno));
+    return fd;
+}
+
+bool UploadWriter::_writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void UploadWriter::_syncPending(std::vector<int>& pending) {
+    for (size_t i = 0; i < pending.size(); ++i) {
+        fdatasync(pending[i]);
+        close(pending[i]);
+    }
+    pending.clear();
+}
@@ -0,0 +1,131 @@
+// ********** VHOST_TABLE **********
+// Tabella hash ad indirizzamento aperto per la scelta del virtual host
+
+#include "VhostTable.hpp"
+#include <cctype>
+
+VhostTable::VhostTable() : _count(0) {
+    _slots.resize(16);
+    for (size_t i = 0; i < _slots.size(); ++i)
+        _slots[i].server = -1;
+}
+
+void VhostTable::clear() {
+    _slots.assign(16, Entry());
+    for (size_t i = 0; i < _slots.size(); ++i)
+        _slots[i].server = -1;
+    _count = 0;
+    _defaults.clear();
+}
+
+void VhostTable::addName(int listenFd, const std::string& name, size_t serverIndex) {
+    size_t len = hostLength(name);
+    if (len == 0 || _lookup(listenFd, name.c_str(), len) >= 0)
+        return;
+
+    Entry entry;
+    entry.host.reserve(len);
+    for (size_t i = 0; i < len; ++i)
+        entry.host += static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])));
+    entry.hash = _hash(listenFd, entry.host.c_str(), len);
+    entry.listenFd = listenFd;
+    entry.server = static_cast<long>(serverIndex);
+
+    // Carico massimo 1/2: le sonde restano corte
+    if ((_count + 1) * 2 > _slots.size())
+        _grow();
+    _insert(entry);
+    ++_count;
+}
+
+void VhostTable::setDefault(int listenFd, size_t serverIndex, bool force) {
+    if (listenFd < 0)
+        return;
+    if (static_cast<size_t>(listenFd) >= _defaults.size())
+        _defaults.resize(listenFd + 1, -1);
+    if (force || _defaults[listenFd] < 0)
+        _defaults[listenFd] = static_cast<long>(serverIndex);
+}
+
+long VhostTable::find(int listenFd, const std::string& hostHeader) const {
+    size_t len = hostLength(hostHeader);
+    if (len > 0) {
+        long server = _lookup(listenFd, hostHeader.c_str(), len);
+        if (server >= 0)
+            return server;
+    }
+    if (listenFd >= 0 && static_cast<size_t>(listenFd) < _defaults.size())
+        return _defaults[listenFd];
+    return -1;
+}
+
+long VhostTable::_lookup(int listenFd, const char* host, size_t len) const {
+    size_t hash = _hash(listenFd, host, len);
+    size_t mask = _slots.size() - 1;
+    for (size_t i = hash & mask; _slots[i].server >= 0; i = (i + 1) & mask) {
+        const Entry& e = _slots[i];
+        if (e.hash == hash && e.listenFd == listenFd && _equals(e.host, host, len))
+            return e.server;
+    }
+    return -1;
+}
+
+// FNV-1a su fd e host in minuscolo, senza copie
+size_t VhostTable::_hash(int listenFd, const char* host, size_t len) {
+    size_t hash = 2166136261UL;
+    for (size_t i = 0; i < sizeof(listenFd); ++i) {
+        hash ^= (static_cast<unsigned int>(listenFd) >> (8 * i)) & 0xff;
+        hash *= 16777619UL;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(host[i])));
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// Lunghezza della parte host: esclude la porta e il punto finale
+size_t VhostTable::hostLength(const std::string& hostHeader) {
+    size_t len = hostHeader.size();
+    if (!hostHeader.empty() && hostHeader[0] == '[') {
+        size_t close = hostHeader.find(']');
+        len = (close == std::string::npos) ? hostHeader.size() : close + 1;
+    } else {
+        size_t colon = hostHeader.find(':');
+        if (colon != std::string::npos)
+            len = colon;
+    }
+    if (len > 0 && hostHeader[len - 1] == '.')
+        --len;
+    return len;
+}
+
+bool VhostTable::_equals(const std::string& stored, const char* host, size_t len) {
+    if (stored.size() != len)
+        return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (stored[i] != std::tolower(static_cast<unsigned char>(host[i])))
+            return false;
+    }
+    return true;
+}
+
+void VhostTable::_insert(const Entry& entry) {
+    size_t mask = _slots.size() - 1;
+    size_t i = entry.hash & mask;
+    while (_slots[i].server >= 0)
+        i = (i + 1) & mask;
+    _slots[i] = entry;
+}
+
+void VhostTable::_grow() {
+    std::vector<Entry> old;
+    old.swap(_slots);
+    _slots.resize(old.size() * 2);
+    for (size_t i = 0; i < _slots.size(); ++i)
+        _slots[i].server = -1;
+    for (size_t i = 0; i < old.size(); ++i) {
+        if (old[i].server >= 0)
+            _insert(old[i]);
+    }
+}
@@ -1,13 +1,18 @@
 // ********** MAIN **********
 // Entry point: carica config e avvia parser
 
-#include <iostream>
 #include <string>
+#include <csignal>
 #include "ConfigParser.hpp"
 #include "ServerInstance.hpp"
 #include "Server.hpp"
+#include "Logger.hpp"
+#include "Stats.hpp"
 #include <vector>
 #include <map>
+#include <cstring>
+#include <cerrno>
+#include <sys/resource.h>
 
 int main(int argc, char **argv)
 {
@@ -16,16 +21,54 @@ int main(int argc, char **argv)
         config_path = argv[1];
 
     try {
-        std::cout << "Avvio webserv con config: " << config_path << std::endl;
+        LOG_NOTICE("Avvio webserv con config: " << config_path);
         ConfigParser parser(config_path);
         parser.parse();
 
+        // Da qui le righe passano dal flusher verso error_log
+        const GlobalConfig& global = parser.getGlobal();
+        std::string logError;
+        if (!Logger::open(global.error_log, global.error_log_level, logError))
+            throw ConfigException(logError);
+
+        // SIGINT/SIGTERM fermano il loop: i log in coda vengono scritti
+        struct sigaction sa;
+        sa.sa_handler = &Server::handleStopSignal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = 0;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        // SIGUSR1 riapre access_log ed error_log dopo una rotazione
+        sa.sa_handler = &Server::handleReopenSignal;
+        sigaction(SIGUSR1, &sa, NULL);
+
+        // SIGUSR2 scrive gli istogrammi di latenza nell'error_log
+        sa.sa_handler = &Server::handleDumpSignal;
+        sigaction(SIGUSR2, &sa, NULL);
+
+        // Contatori di stub_status, condivisi con eventuali worker
+        Stats::init();
+
+        // Connessioni fino al limite hard di fd, come worker_rlimit_nofile
+        struct rlimit files;
+        if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+            files.rlim_cur = files.rlim_max;
+            if (setrlimit(RLIMIT_NOFILE, &files) != 0)
+                LOG_WARN("setrlimit(RLIMIT_NOFILE) fallita: " << strerror(errno));
+        }
+
         const std::vector<ServerConfig>& servers = parser.getServers();
         std::vector<ServerInstance*> instances;
         Server webserver;
         
         // Aggiungi i server alla configurazione
         webserver.setServers(servers);
+        webserver.setGlobalConfig(global);
+        if (!webserver.openAccessLog(logError))
+            throw ConfigException(logError);
+        if (!webserver.openCapture(logError))
+            throw ConfigException(logError);
 
         // Traccia socket già creati per evitare duplicati
         std::map<std::pair<std::string, int>, ServerInstance*> uniqueSockets;
@@ -48,8 +91,8 @@ int main(int argc, char **argv)
                         uniqueSockets[endpoint] = instance;
                         // Rimosso print duplicato - il constructor già stampa
                     } catch (const std::exception& e) {
-                        std::cerr << "Errore binding " << host << ":" << port 
-                                  << " - " << e.what() << std::endl;
+                        LOG_ERROR("Errore binding " << host << ":" << port
+                            << " - " << e.what());
                         continue;  // Salta questa configurazione
                     }
                 } else {
@@ -57,7 +100,7 @@ int main(int argc, char **argv)
                 }
                 
                 // Aggiungi la configurazione del server all'istanza
-                webserver.addInstance(instance, srv);
+                webserver.addInstance(instance, i, srv.listen_default[j]);
             }
         }
 
@@ -69,12 +112,15 @@ int main(int argc, char **argv)
             delete instances[i];
 
     } catch (const ConfigException& e) {
-        std::cerr << "Errore di configurazione: " << e.what() << std::endl;
+        LOG_CRIT("Errore di configurazione: " << e.what());
+        Logger::close();
         return 1;
     } catch (const std::exception& e) {
-        std::cerr << "Errore: " << e.what() << std::endl;
+        LOG_CRIT("Errore: " << e.what());
+        Logger::close();
         return 1;
     }
 
+    Logger::close();
     return 0;
 }
@@ -4,6 +4,10 @@
 #include <fstream>
 #include <sstream>
 #include <dirent.h>
+#include <set>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 
 bool fileExists(const std::string& path) {
     struct stat buffer;
@@ -50,6 +54,36 @@ std::string readFile(const std::string& path) {
     return std::string(buffer.begin(), buffer.end());
 }
 
+ssize_t readFull(int fd, char* data, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = read(fd, data + total, length - total);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        total += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(total);
+}
+
+size_t longestLine(const char* data, size_t len) {
+    size_t longest = 0;
+    const char* end = data + len;
+    while (data < end) {
+        const char* eol = static_cast<const char*>(std::memchr(data, '\n', end - data));
+        size_t line = static_cast<size_t>((eol ? eol : end) - data);
+        if (line > longest)
+            longest = line;
+        if (!eol)
+            break;
+        data = eol + 1;
+    }
+    return longest;
+}
+
 std::string joinPaths(const std::string& base, const std::string& rel) {
     if (base.empty())
         return rel;
@@ -62,7 +96,9 @@ std::string joinPaths(const std::string& base, const std::string& rel) {
     else if (result[result.length() - 1] == '/' && rel[0] == '/')
         result.erase(result.length() - 1);
     result += rel;
-    return normalizePath(result);
+    // Le parti arrivano già canoniche (root normalizzata al caricamento,
+    // URI passato da canonicalizePath): niente da normalizzare qui
+    return result;
 }
 
 std::string normalizePath(const std::string& path) {
@@ -103,6 +139,80 @@ std::string normalizePath(const std::string& path) {
     return result;
 }
 
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+PathStatus canonicalizePath(const char* path, size_t len, char* out, size_t outSize, size_t& outLen) {
+    outLen = 0;
+    if (len == 0 || path[0] != '/' || outSize < 2)
+        return PATH_INVALID;
+
+    PathStatus status = PATH_OK;
+    size_t o = 0;
+    size_t segment = 1;     // inizio del segmento corrente in out
+    out[o++] = '/';
+
+    for (size_t i = 1; i <= len; ++i) {
+        char c = '/';       // la fine del path chiude l'ultimo segmento
+        if (i < len) {
+            c = path[i];
+            if (c == '%') {
+                if (i + 2 >= len)
+                    return PATH_INVALID;
+                int hi = hexValue(path[i + 1]);
+                int lo = hexValue(path[i + 2]);
+                if (hi < 0 || lo < 0)
+                    return PATH_INVALID;
+                c = static_cast<char>(hi * 16 + lo);
+                i += 2;
+            }
+            if (c == '\0')
+                return PATH_INVALID;
+        }
+
+        if (c != '/') {
+            if (o + 1 >= outSize)
+                return PATH_INVALID;
+            out[o++] = c;
+            continue;
+        }
+
+        // Fine segmento: out[segment, o) è il segmento appena letto
+        size_t segLen = o - segment;
+        bool last = (i >= len);
+        if (segLen == 0) {
+            if (!last)
+                status = PATH_REWRITTEN;        // '//'
+        } else if (segLen == 1 && out[segment] == '.') {
+            o = segment;
+            status = PATH_REWRITTEN;
+        } else if (segLen == 2 && out[segment] == '.' && out[segment + 1] == '.') {
+            if (segment == 1)
+                return PATH_ESCAPES_ROOT;
+            // Risale al '/' prima del segmento precedente
+            o = segment - 1;
+            while (out[o - 1] != '/')
+                --o;
+            segment = o;
+            status = PATH_REWRITTEN;
+        } else if (!last) {
+            if (o + 1 >= outSize)
+                return PATH_INVALID;
+            out[o++] = '/';
+            segment = o;
+        }
+    }
+    outLen = o;
+    return status;
+}
+
 std::vector<std::string> listDirectory(const std::string& path) {
     std::vector<std::string> result;
     DIR* dir = opendir(path.c_str());
@@ -118,4 +228,58 @@ std::vector<std::string> listDirectory(const std::string& path) {
     
     closedir(dir);
     return result;
-}
\ No newline at end of file
+}
+
+// Crea la directory (e i genitori) una volta sola: le successive chiamate
+// per lo stesso path non toccano il filesystem
+bool ensureDirectory(const std::string& path) {
+    static std::set<std::string> created;
+    if (path.empty() || created.count(path))
+        return true;
+
+    std::string current;
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t slash = path.find('/', pos);
+        if (slash == std::string::npos)
+            slash = path.size();
+        current = path.substr(0, slash);
+        pos = slash + 1;
+        if (current.empty() || current == "." || current == "..")
+            continue;
+        if (mkdir(current.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    created.insert(path);
+    return true;
+}
+
+// Data HTTP (RFC 7231) in GMT, indipendente dal locale
+std::string httpDate(time_t t) {
+    static const char* days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+        days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900,
+        tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return buf;
+}
+
+long elapsedUsec(const struct timeval& from, const struct timeval& to) {
+    return (to.tv_sec - from.tv_sec) * 1000000L + (to.tv_usec - from.tv_usec);
+}
+
+long usecSince(const struct timeval& from) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return elapsedUsec(from, now);
+}
+
+size_t stringHeapBytes(const std::string& s) {
+    // La capacità di una stringa vuota è quella del buffer interno (SSO)
+    static const size_t inlineCapacity = std::string().capacity();
+    return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}